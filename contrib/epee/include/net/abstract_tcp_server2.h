@@ -39,8 +39,10 @@
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
+#include <deque>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/interprocess/detail/atomic.hpp>
 #include <boost/thread/thread.hpp>
@@ -49,6 +51,8 @@
 
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 100
+#define ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE 8192
+#define ABSTRACT_SERVER_RECV_BUFFER_MAX_SIZE (256 * 1024)
 
 namespace epee
 {
@@ -91,6 +95,7 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb);
+    virtual bool do_send_buffers(const std::vector<shared_buffer>& buffers);
     virtual bool close();
     virtual bool call_run_once_service_io();
     virtual bool request_callback();
@@ -107,20 +112,24 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    /// Write all queued buffers with one gathering write, called with m_send_que_lock held.
+    void start_write(const boost::shared_ptr<connection<t_protocol_handler> >& self);
+
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
 
     /// Socket for the connection.
     boost::asio::ip::tcp::socket socket_;
 
-    /// Buffer for incoming data.
-    boost::array<char, 8192> buffer_;
+    /// Buffer for incoming data, grows while reads fill it up and shrinks back when they do not.
+    std::vector<char> buffer_;
 
     t_connection_context context;
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::list<std::string> m_send_que;
+    std::deque<std::vector<shared_buffer> > m_send_que; //one entry per message, with all the buffers it was sent in
+    size_t m_send_que_writing; //messages at the front of m_send_que passed to the write in progress
     volatile uint32_t& m_ref_sockets_count;
     i_connection_filter* &m_pfilter;
     volatile bool m_is_multithreaded;
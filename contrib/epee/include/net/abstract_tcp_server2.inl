@@ -54,8 +54,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     typename t_protocol_handler::config_type& config, volatile uint32_t& sock_count, i_connection_filter* &pfilter)
                           : strand_(io_service),
                             socket_(io_service),
+                            buffer_(ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE),
                             m_want_close_connection(0), 
                             m_was_shutdown(0), 
+                            m_send_que_writing(0),
                             m_ref_sockets_count(sock_count), 
                             m_pfilter(pfilter),
                             m_protocol_handler(this, config, context)
@@ -236,6 +238,12 @@ PRAGMA_WARNING_DISABLE_VS(4355)
           shutdown();
       }else
       {
+        //a full buffer means more data is waiting, as during block downloads, so next reads take more at once
+        if(bytes_transferred == buffer_.size() && buffer_.size() < ABSTRACT_SERVER_RECV_BUFFER_MAX_SIZE)
+          buffer_.resize(buffer_.size() * 2);
+        else if(bytes_transferred < buffer_.size() / 4 && buffer_.size() > ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE)
+          std::vector<char>(buffer_.size() / 2).swap(buffer_);
+
         socket_.async_read_some(boost::asio::buffer(buffer_),
           strand_.wrap(
             boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
@@ -287,6 +295,14 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   bool connection<t_protocol_handler>::do_send(const void* ptr, size_t cb)
+  {
+    std::vector<shared_buffer> buffers;
+    buffers.push_back(boost::make_shared<const std::string>((const char*)ptr, cb));
+    return do_send_buffers(buffers);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_buffers(const std::vector<shared_buffer>& buffers)
   {
     TRY_ENTRY();
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
@@ -296,6 +312,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     if(m_was_shutdown)
       return false;
 
+    size_t cb = 0;
+    for(const shared_buffer& buffer: buffers)
+      cb += buffer->size();
+
     LOG_PRINT("[sock " << socket_.native_handle() << "] SEND " << cb, LOG_LEVEL_4);
     context.m_last_send = time(NULL);
     context.m_send_cnt += cb;
@@ -311,33 +331,45 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return false;
     }
 
-    m_send_que.resize(m_send_que.size()+1);
-    m_send_que.back().assign((const char*)ptr, cb);
+    m_send_que.push_back(buffers);
     
-    if(m_send_que.size() > 1)
+    if(m_send_que_writing)
     {
-      //active operation should be in progress, nothing to do, just wait last operation callback
+      //active operation should be in progress, nothing to do, the buffers are written after its callback
     }else
     {
       //no active operation
-      if(m_send_que.size()!=1)
+      start_write(self);
+    }
+
+    return true;
+
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_buffers", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write(const boost::shared_ptr<connection<t_protocol_handler> >& self)
+  {
+    //all queued messages go out with one gathering write, the buffers stay referenced by the queue until it completes
+    std::vector<boost::asio::const_buffer> write_buffers;
+    size_t cb = 0;
+    for(const std::vector<shared_buffer>& message: m_send_que)
+    {
+      for(const shared_buffer& buffer: message)
       {
-        LOG_ERROR("Looks like no active operations, but send que size != 1!!");
-        return false;
+        write_buffers.push_back(boost::asio::buffer(buffer->data(), buffer->size()));
+        cb += buffer->size();
       }
-
-      boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), m_send_que.front().size()),
-        //strand_.wrap(
-        boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-        //)
-        );
-      
-      LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
     }
 
-    return true;
+    m_send_que_writing = m_send_que.size();
+    boost::asio::async_write(socket_, write_buffers,
+      //strand_.wrap(
+      boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
+      //)
+      );
 
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+    LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Async send requested " << cb << " in " << m_send_que_writing << " messages");
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
@@ -391,7 +423,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return;
     }
 
-    m_send_que.pop_front();
+    m_send_que.erase(m_send_que.begin(), m_send_que.begin() + std::min(m_send_que_writing, m_send_que.size()));
+    m_send_que_writing = 0;
     if(m_send_que.empty())
     {
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
@@ -401,10 +434,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }else
     {
       //have more data to send
-      boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), m_send_que.front().size()),
-        //strand_.wrap(
-          boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2));
-        //);
+      start_write(connection<t_protocol_handler>::shared_from_this());
     }
     CRITICAL_REGION_END();
 
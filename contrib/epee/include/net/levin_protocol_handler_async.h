@@ -73,6 +73,7 @@ public:
   int invoke_async(int command, const std::string& in_buff, boost::uuids::uuid connection_id, callback_t cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
   int notify(int command, const std::string& in_buff, boost::uuids::uuid connection_id);
+  int notify(int command, const net_utils::shared_buffer& in_buff, boost::uuids::uuid connection_id);
   bool close(boost::uuids::uuid connection_id);
   bool update_connection_context(const t_connection_context& contxt);
   bool request_callback(boost::uuids::uuid connection_id);
@@ -209,6 +210,15 @@ public:
     return handler->is_timer_started();
   }
   template<class callback_t> friend struct anvoke_handler;
+
+  //the header and the body go to the send queue together, so they are written with one call
+  bool send_message(const bucket_head2& head, const net_utils::shared_buffer& body)
+  {
+    std::vector<net_utils::shared_buffer> buffers;
+    buffers.push_back(boost::make_shared<const std::string>(reinterpret_cast<const char*>(&head), sizeof(head)));
+    buffers.push_back(body);
+    return m_pservice_endpoint->do_send_buffers(buffers);
+  }
 public:
   async_protocol_handler(net_utils::i_service_endpoint* psnd_hndlr, 
     config_type& config, 
@@ -324,105 +334,20 @@ public:
       return false;
     }
 
-    m_cache_in_buffer.append((const char*)ptr, cb);
-
-    bool is_continue = true;
-    while(is_continue)
+    //received data is consumed by offset, only the unfinished header or body is kept in m_cache_in_buffer
+    const char* data = static_cast<const char*>(ptr);
+    size_t size = cb;
+    for(;;)
     {
-      switch(m_state)
+      if(m_state == stream_state_head)
       {
-      case stream_state_body:
-        if(m_cache_in_buffer.size() < m_current_head.m_cb)
-        {
-          is_continue = false;
-          break;
-        }
-        {
-          std::string buff_to_invoke;
-          if(m_cache_in_buffer.size()  == m_current_head.m_cb)
-            buff_to_invoke.swap(m_cache_in_buffer);
-          else
-          {
-            buff_to_invoke.assign(m_cache_in_buffer, 0, (std::string::size_type)m_current_head.m_cb);
-            m_cache_in_buffer.erase(0, (std::string::size_type)m_current_head.m_cb);
-          }
-
-          bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
-
-          LOG_PRINT_CC_L4(m_connection_context, "LEVIN_PACKET_RECIEVED. [len=" << m_current_head.m_cb 
-            << ", flags" << m_current_head.m_flags 
-            << ", r?=" << m_current_head.m_have_to_return_data 
-            <<", cmd = " << m_current_head.m_command 
-            << ", v=" << m_current_head.m_protocol_version);
-
-          if(is_response)
-          {//response to some invoke 
-
-            epee::critical_region_t<decltype(m_invoke_response_handlers_lock)> invoke_response_handlers_guard(m_invoke_response_handlers_lock);
-            if(!m_invoke_response_handlers.empty())
-            {//async call scenario
-              boost::shared_ptr<invoke_response_handler_base> response_handler = m_invoke_response_handlers.front();
-              bool timer_cancelled = response_handler->cancel_timer();
-               // Don't pop handler, to avoid destroying it
-              if(timer_cancelled)
-                m_invoke_response_handlers.pop_front();
-              invoke_response_handlers_guard.unlock();
-
-              if(timer_cancelled)
-                response_handler->handle(m_current_head.m_command, buff_to_invoke, m_connection_context);
-            }
-            else
-            {
-              invoke_response_handlers_guard.unlock();
-              //use sync call scenario
-              if(!boost::interprocess::ipcdetail::atomic_read32(&m_wait_count) && !boost::interprocess::ipcdetail::atomic_read32(&m_close_called))
-              {
-                LOG_ERROR_CC(m_connection_context, "no active invoke when response came, wtf?");
-                return false;
-              }else
-              {
-                CRITICAL_REGION_BEGIN(m_local_inv_buff_lock);
-                buff_to_invoke.swap(m_local_inv_buff);
-                buff_to_invoke.clear();
-                m_invoke_result_code = m_current_head.m_return_code;
-                CRITICAL_REGION_END();
-                boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 1);
-              }
-            }
-          }else
-          {
-            if(m_current_head.m_have_to_return_data)
-            {
-              std::string return_buff;
-              m_current_head.m_return_code = m_config.m_pcommands_handler->invoke(
-                                                                  m_current_head.m_command, 
-                                                                  buff_to_invoke, 
-                                                                  return_buff, 
-                                                                  m_connection_context);
-              m_current_head.m_cb = return_buff.size();
-              m_current_head.m_have_to_return_data = false;
-              m_current_head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-              m_current_head.m_flags = LEVIN_PACKET_RESPONSE;
-              std::string send_buff((const char*)&m_current_head, sizeof(m_current_head));
-              send_buff += return_buff;
-              CRITICAL_REGION_BEGIN(m_send_lock);
-              if(!m_pservice_endpoint->do_send(send_buff.data(), send_buff.size()))
-                return false;
-              CRITICAL_REGION_END();
-              LOG_PRINT_CC_L4(m_connection_context, "LEVIN_PACKET_SENT. [len=" << m_current_head.m_cb 
-                << ", flags" << m_current_head.m_flags 
-                << ", r?=" << m_current_head.m_have_to_return_data 
-                <<", cmd = " << m_current_head.m_command 
-                << ", ver=" << m_current_head.m_protocol_version);
-            }
-            else
-              m_config.m_pcommands_handler->notify(m_current_head.m_command, buff_to_invoke, m_connection_context);
-          }
-        }
-        m_state = stream_state_head;
-        break;
-      case stream_state_head:
+        const char* head_data = data;
+        if(!m_cache_in_buffer.empty() || size < sizeof(bucket_head2))
         {
+          size_t part = std::min(sizeof(bucket_head2) - m_cache_in_buffer.size(), size);
+          m_cache_in_buffer.append(data, part);
+          data += part;
+          size -= part;
           if(m_cache_in_buffer.size() < sizeof(bucket_head2))
           {
             if(m_cache_in_buffer.size() >= sizeof(uint64_t) && *((uint64_t*)m_cache_in_buffer.data()) != LEVIN_SIGNATURE)
@@ -430,34 +355,134 @@ public:
               LOG_ERROR_CC(m_connection_context, "Signature mismatch, connection will be closed");
               return false;
             }
-            is_continue = false;
-            break;
+            return true;
           }
+          head_data = m_cache_in_buffer.data();
+        }else
+        {
+          data += sizeof(bucket_head2);
+          size -= sizeof(bucket_head2);
+        }
 
-          bucket_head2* phead = (bucket_head2*)m_cache_in_buffer.data();
-          if(LEVIN_SIGNATURE != phead->m_signature)
-          {
-            LOG_ERROR_CC(m_connection_context, "Signature mismatch, connection will be closed");
-            return false;
-          }
-          m_current_head = *phead;
+        bucket_head2 head;
+        memcpy(&head, head_data, sizeof(head));
+        m_cache_in_buffer.clear();
+        if(LEVIN_SIGNATURE != head.m_signature)
+        {
+          LOG_ERROR_CC(m_connection_context, "Signature mismatch, connection will be closed");
+          return false;
+        }
+        m_current_head = head;
 
-          m_cache_in_buffer.erase(0, sizeof(bucket_head2));
-          m_state = stream_state_body;
-          m_oponent_protocol_ver = m_current_head.m_protocol_version;
-          if(m_current_head.m_cb > m_config.m_max_packet_size)
-          {
-            LOG_ERROR_CC(m_connection_context, "Maximum packet size exceed!, m_max_packet_size = " << m_config.m_max_packet_size 
-              << ", packet header received " << m_current_head.m_cb 
-              << ", connection will be closed.");
-            return false;
-          }
+        m_state = stream_state_body;
+        m_oponent_protocol_ver = m_current_head.m_protocol_version;
+        if(m_current_head.m_cb > m_config.m_max_packet_size)
+        {
+          LOG_ERROR_CC(m_connection_context, "Maximum packet size exceed!, m_max_packet_size = " << m_config.m_max_packet_size 
+            << ", packet header received " << m_current_head.m_cb 
+            << ", connection will be closed.");
+          return false;
         }
-        break;
-      default:
-        LOG_ERROR_CC(m_connection_context, "Undefined state in levin_server_impl::connection_handler, m_state=" << m_state);
+      }
+
+      size_t missing = static_cast<size_t>(m_current_head.m_cb) - m_cache_in_buffer.size();
+      if(size < missing)
+      {
+        m_cache_in_buffer.append(data, size);
+        return true;
+      }
+
+      //a body received with one read is copied once, a body received in parts is handed over without copying
+      std::string buff_to_invoke;
+      if(m_cache_in_buffer.empty())
+      {
+        buff_to_invoke.assign(data, missing);
+      }else
+      {
+        m_cache_in_buffer.append(data, missing);
+        buff_to_invoke.swap(m_cache_in_buffer);
+      }
+      data += missing;
+      size -= missing;
+
+      m_state = stream_state_head;
+      if(!handle_message(buff_to_invoke))
         return false;
+    }
+  }
+
+  bool handle_message(std::string& buff_to_invoke)
+  {
+    bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
+
+    LOG_PRINT_CC_L4(m_connection_context, "LEVIN_PACKET_RECIEVED. [len=" << m_current_head.m_cb 
+      << ", flags" << m_current_head.m_flags 
+      << ", r?=" << m_current_head.m_have_to_return_data 
+      <<", cmd = " << m_current_head.m_command 
+      << ", v=" << m_current_head.m_protocol_version);
+
+    if(is_response)
+    {//response to some invoke 
+
+      epee::critical_region_t<decltype(m_invoke_response_handlers_lock)> invoke_response_handlers_guard(m_invoke_response_handlers_lock);
+      if(!m_invoke_response_handlers.empty())
+      {//async call scenario
+        boost::shared_ptr<invoke_response_handler_base> response_handler = m_invoke_response_handlers.front();
+        bool timer_cancelled = response_handler->cancel_timer();
+         // Don't pop handler, to avoid destroying it
+        if(timer_cancelled)
+          m_invoke_response_handlers.pop_front();
+        invoke_response_handlers_guard.unlock();
+
+        if(timer_cancelled)
+          response_handler->handle(m_current_head.m_command, buff_to_invoke, m_connection_context);
+      }
+      else
+      {
+        invoke_response_handlers_guard.unlock();
+        //use sync call scenario
+        if(!boost::interprocess::ipcdetail::atomic_read32(&m_wait_count) && !boost::interprocess::ipcdetail::atomic_read32(&m_close_called))
+        {
+          LOG_ERROR_CC(m_connection_context, "no active invoke when response came, wtf?");
+          return false;
+        }else
+        {
+          CRITICAL_REGION_BEGIN(m_local_inv_buff_lock);
+          buff_to_invoke.swap(m_local_inv_buff);
+          buff_to_invoke.clear();
+          m_invoke_result_code = m_current_head.m_return_code;
+          CRITICAL_REGION_END();
+          boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 1);
+        }
       }
+    }else
+    {
+      if(m_current_head.m_have_to_return_data)
+      {
+        std::string return_buff;
+        m_current_head.m_return_code = m_config.m_pcommands_handler->invoke(
+                                                            m_current_head.m_command, 
+                                                            buff_to_invoke, 
+                                                            return_buff, 
+                                                            m_connection_context);
+        m_current_head.m_cb = return_buff.size();
+        m_current_head.m_have_to_return_data = false;
+        m_current_head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+        m_current_head.m_flags = LEVIN_PACKET_RESPONSE;
+        std::string send_buff((const char*)&m_current_head, sizeof(m_current_head));
+        send_buff += return_buff;
+        CRITICAL_REGION_BEGIN(m_send_lock);
+        if(!m_pservice_endpoint->do_send(send_buff.data(), send_buff.size()))
+          return false;
+        CRITICAL_REGION_END();
+        LOG_PRINT_CC_L4(m_connection_context, "LEVIN_PACKET_SENT. [len=" << m_current_head.m_cb 
+          << ", flags" << m_current_head.m_flags 
+          << ", r?=" << m_current_head.m_have_to_return_data 
+          <<", cmd = " << m_current_head.m_command 
+          << ", ver=" << m_current_head.m_protocol_version);
+      }
+      else
+        m_config.m_pcommands_handler->notify(m_current_head.m_command, buff_to_invoke, m_connection_context);
     }
 
     return true;
@@ -511,14 +536,7 @@ public:
       boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 0);
       CRITICAL_REGION_BEGIN(m_send_lock);
       CRITICAL_REGION_LOCAL1(m_invoke_response_handlers_lock);
-      if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
-      {
-//        LOG_ERROR_CC(m_connection_context, "Failed to do_send");
-        err_code = LEVIN_ERROR_CONNECTION;
-        break;
-      }
-
-      if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+      if(!send_message(head, boost::make_shared<const std::string>(in_buff)))
       {
         LOG_ERROR_CC(m_connection_context, "Failed to do_send");
         err_code = LEVIN_ERROR_CONNECTION;
@@ -568,13 +586,7 @@ public:
 
     boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 0);
     CRITICAL_REGION_BEGIN(m_send_lock);
-    if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
-    {
-      LOG_ERROR_CC(m_connection_context, "Failed to do_send");
-      return LEVIN_ERROR_CONNECTION;
-    }
-
-    if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+    if(!send_message(head, boost::make_shared<const std::string>(in_buff)))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to do_send");
       return LEVIN_ERROR_CONNECTION;
@@ -613,6 +625,12 @@ public:
   }
 
   int notify(int command, const std::string& in_buff)
+  {
+    return notify(command, boost::make_shared<const std::string>(in_buff));
+  }
+
+  //the same payload buffer may be sent to many connections at once, it is never copied
+  int notify(int command, const net_utils::shared_buffer& in_buff)
   {
     misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
                           boost::bind(&async_protocol_handler::finish_outer_call, this));
@@ -628,19 +646,13 @@ public:
     bucket_head2 head = {0};
     head.m_signature = LEVIN_SIGNATURE;
     head.m_have_to_return_data = false;
-    head.m_cb = in_buff.size();
+    head.m_cb = in_buff->size();
 
     head.m_command = command;
     head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
     head.m_flags = LEVIN_PACKET_REQUEST;
     CRITICAL_REGION_BEGIN(m_send_lock);
-    if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
-    {
-//      LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
-      return -1;
-    }
-
-    if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+    if(!send_message(head, in_buff))
     {
       LOG_ERROR("Failed to do_send()");
       return -1;
@@ -742,6 +754,14 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::notify(int command, const net_utils::shared_buffer& in_buff, boost::uuids::uuid connection_id)
+{
+  async_protocol_handler<t_connection_context>* aph;
+  int r = find_and_lock_connection(connection_id, aph);
+  return LEVIN_OK == r ? aph->notify(command, in_buff) : r;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
   CRITICAL_REGION_LOCAL(m_connects_lock);
@@ -29,6 +29,9 @@
 #ifndef _NET_UTILS_BASE_H_
 #define _NET_UTILS_BASE_H_
 
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
 #include <boost/uuid/uuid.hpp>
 #include "string_tools.h"
 
@@ -107,9 +110,20 @@ namespace net_utils
 	/************************************************************************/
 	/*                                                                      */
 	/************************************************************************/
+  //immutable message buffer, queued by reference on every connection it is sent to
+  typedef boost::shared_ptr<const std::string> shared_buffer;
+
 	struct i_service_endpoint
 	{
 		virtual bool do_send(const void* ptr, size_t cb)=0;
+    //sends the buffers one after another as a single piece of the stream, without copying them
+    virtual bool do_send_buffers(const std::vector<shared_buffer>& buffers)
+    {
+      std::string buff;
+      for(const shared_buffer& b: buffers)
+        buff += *b;
+      return do_send(buff.data(), buff.size());
+    }
     virtual bool close()=0;
     virtual bool call_run_once_service_io()=0;
     virtual bool request_callback()=0;
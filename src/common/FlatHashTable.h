@@ -0,0 +1,365 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <boost/serialization/binary_object.hpp>
+#include <boost/serialization/split_member.hpp>
+
+namespace tools {
+
+// Keys come from the network and can be ground to collide, so they are mixed with a seed chosen once per process
+inline uint64_t flatHashTableSeed() {
+  static const uint64_t seed = []() {
+    std::random_device device;
+    return (static_cast<uint64_t>(device()) << 32) ^ device();
+  }();
+
+  return seed;
+}
+
+// Open addressing hash table with linear probing for keys which are hashes themselves (block and transaction ids,
+// key images). All key bytes are mixed with the per-process seed, so the slots can't be predicted by peers. Entries
+// are kept in one flat array, next to an array of one byte tags, which lets probing skip slots without touching the
+// entries. Erasing shifts the following entries back instead of leaving tombstones. Entries must be trivially
+// copyable, as the arrays are serialized as is; the slots depend on the seed, so they are recomputed on loading.
+template <typename Key, typename Entry, typename KeyOf>
+class FlatHashTable {
+public:
+  typedef Key key_type;
+  typedef Entry value_type;
+  typedef size_t size_type;
+
+  template <typename Table, typename Value>
+  class basic_iterator : public std::iterator<std::forward_iterator_tag, Value> {
+  public:
+    basic_iterator() : m_table(nullptr), m_slot(0) {
+    }
+
+    basic_iterator(Table* table, size_t slot) : m_table(table), m_slot(slot) {
+      skipEmpty();
+    }
+
+    template <typename OtherTable, typename OtherValue>
+    basic_iterator(const basic_iterator<OtherTable, OtherValue>& other) : m_table(other.m_table), m_slot(other.m_slot) {
+    }
+
+    Value& operator*() const { return m_table->m_entries[m_slot]; }
+    Value* operator->() const { return &m_table->m_entries[m_slot]; }
+
+    basic_iterator& operator++() {
+      ++m_slot;
+      skipEmpty();
+      return *this;
+    }
+
+    basic_iterator operator++(int) {
+      basic_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    template <typename OtherTable, typename OtherValue>
+    bool operator==(const basic_iterator<OtherTable, OtherValue>& other) const { return m_slot == other.m_slot; }
+    template <typename OtherTable, typename OtherValue>
+    bool operator!=(const basic_iterator<OtherTable, OtherValue>& other) const { return m_slot != other.m_slot; }
+
+  private:
+    template <typename, typename> friend class basic_iterator;
+    friend class FlatHashTable;
+
+    void skipEmpty() {
+      while (m_slot < m_table->m_tags.size() && m_table->m_tags[m_slot] == EMPTY_TAG) {
+        ++m_slot;
+      }
+    }
+
+    Table* m_table;
+    size_t m_slot;
+  };
+
+  typedef basic_iterator<FlatHashTable, Entry> iterator;
+  typedef basic_iterator<const FlatHashTable, const Entry> const_iterator;
+
+  FlatHashTable() : m_size(0) {
+    static_assert(sizeof(Key) >= sizeof(uint64_t), "FlatHashTable keys must be hashes of at least 64 bits");
+  }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  size_t capacity() const { return m_tags.size(); }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, m_tags.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, m_tags.size()); }
+
+  void clear() {
+    std::vector<uint8_t>().swap(m_tags);
+    std::vector<Entry>().swap(m_entries);
+    m_size = 0;
+  }
+
+  void reserve(size_t count) {
+    size_t capacity = MIN_CAPACITY;
+    while (capacity - capacity / 8 < count) {
+      capacity *= 2;
+    }
+
+    if (capacity > m_tags.size()) {
+      rehash(capacity);
+    }
+  }
+
+  iterator find(const Key& key) {
+    return iterator(this, findSlot(key));
+  }
+
+  const_iterator find(const Key& key) const {
+    return const_iterator(this, findSlot(key));
+  }
+
+  size_t count(const Key& key) const {
+    return findSlot(key) != m_tags.size() ? 1 : 0;
+  }
+
+  std::pair<iterator, bool> insert(const Entry& entry) {
+    const Key& key = KeyOf()(entry);
+    size_t slot = findSlot(key);
+    if (slot != m_tags.size()) {
+      return std::make_pair(iterator(this, slot), false);
+    }
+
+    if (m_size + 1 > m_tags.size() - m_tags.size() / 8) {
+      rehash(m_tags.empty() ? MIN_CAPACITY : m_tags.size() * 2);
+    }
+
+    slot = insertNew(entry);
+    return std::make_pair(iterator(this, slot), true);
+  }
+
+  size_t erase(const Key& key) {
+    size_t slot = findSlot(key);
+    if (slot == m_tags.size()) {
+      return 0;
+    }
+
+    eraseSlot(slot);
+    return 1;
+  }
+
+  void erase(const_iterator it) {
+    eraseSlot(it.m_slot);
+  }
+
+  template <class Archive> void save(Archive& ar, const unsigned int version) const {
+    uint64_t capacity = m_tags.size();
+    uint64_t size = m_size;
+    ar & capacity;
+    ar & size;
+    if (capacity != 0) {
+      ar & boost::serialization::make_binary_object(const_cast<uint8_t*>(m_tags.data()), m_tags.size());
+      ar & boost::serialization::make_binary_object(const_cast<Entry*>(m_entries.data()), m_entries.size() * sizeof(Entry));
+    }
+  }
+
+  template <class Archive> void load(Archive& ar, const unsigned int version) {
+    uint64_t capacity;
+    uint64_t size;
+    ar & capacity;
+    ar & size;
+    if (capacity != 0 && ((capacity & (capacity - 1)) != 0 || size > capacity)) {
+      throw std::runtime_error("FlatHashTable: invalid serialized table");
+    }
+
+    std::vector<uint8_t> tags(capacity, EMPTY_TAG);
+    std::vector<Entry> entries(capacity);
+    if (capacity != 0) {
+      ar & boost::serialization::make_binary_object(tags.data(), tags.size());
+      ar & boost::serialization::make_binary_object(entries.data(), entries.size() * sizeof(Entry));
+    }
+
+    size_t occupied = 0;
+    for (uint8_t tag : tags) {
+      if (tag != EMPTY_TAG) {
+        ++occupied;
+      }
+    }
+
+    if (occupied != size || size > capacity - capacity / 8) {
+      throw std::runtime_error("FlatHashTable: invalid serialized table");
+    }
+
+    clear();
+    m_tags.resize(capacity, EMPTY_TAG);
+    m_entries.resize(capacity);
+    for (size_t i = 0; i < tags.size(); ++i) {
+      if (tags[i] != EMPTY_TAG) {
+        insertNew(entries[i]);
+      }
+    }
+  }
+
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+protected:
+  const Entry& entryAt(size_t slot) const { return m_entries[slot]; }
+  size_t findSlot(const Key& key) const;
+
+private:
+  static const uint8_t EMPTY_TAG = 0;
+  static const size_t MIN_CAPACITY = 16;
+
+  static uint64_t hashOf(const Key& key) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(&key);
+    uint64_t hash = flatHashTableSeed();
+    for (size_t offset = 0; offset < sizeof(Key); offset += sizeof(uint64_t)) {
+      uint64_t word = 0;
+      memcpy(&word, data + offset, sizeof(Key) - offset < sizeof(uint64_t) ? sizeof(Key) - offset : sizeof(uint64_t));
+      hash = (hash ^ word) * 0x9e3779b97f4a7c15;
+      hash ^= hash >> 32;
+    }
+
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+    return hash ^ (hash >> 31);
+  }
+
+  // the top bits of the hash, so they are independent of the bits selecting the slot; the high bit marks occupied slots
+  static uint8_t tagOf(uint64_t hash) {
+    return static_cast<uint8_t>(hash >> 57) | 0x80;
+  }
+
+  size_t insertNew(const Entry& entry) {
+    uint64_t hash = hashOf(KeyOf()(entry));
+    size_t mask = m_tags.size() - 1;
+    size_t slot = hash & mask;
+    while (m_tags[slot] != EMPTY_TAG) {
+      slot = (slot + 1) & mask;
+    }
+
+    m_tags[slot] = tagOf(hash);
+    m_entries[slot] = entry;
+    ++m_size;
+    return slot;
+  }
+
+  void eraseSlot(size_t slot) {
+    size_t mask = m_tags.size() - 1;
+    size_t hole = slot;
+    size_t next = (hole + 1) & mask;
+    while (m_tags[next] != EMPTY_TAG) {
+      // an entry may fill the hole only if its home slot is not between the hole and the entry itself
+      size_t home = hashOf(KeyOf()(m_entries[next])) & mask;
+      if (((next - home) & mask) >= ((next - hole) & mask)) {
+        m_tags[hole] = m_tags[next];
+        m_entries[hole] = m_entries[next];
+        hole = next;
+      }
+
+      next = (next + 1) & mask;
+    }
+
+    m_tags[hole] = EMPTY_TAG;
+    --m_size;
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<uint8_t> tags(capacity, EMPTY_TAG);
+    std::vector<Entry> entries(capacity);
+    tags.swap(m_tags);
+    entries.swap(m_entries);
+    m_size = 0;
+    for (size_t i = 0; i < tags.size(); ++i) {
+      if (tags[i] != EMPTY_TAG) {
+        insertNew(entries[i]);
+      }
+    }
+  }
+
+  std::vector<uint8_t> m_tags;
+  std::vector<Entry> m_entries;
+  size_t m_size;
+};
+
+template <typename Key, typename Entry, typename KeyOf>
+const uint8_t FlatHashTable<Key, Entry, KeyOf>::EMPTY_TAG;
+
+template <typename Key, typename Entry, typename KeyOf>
+const size_t FlatHashTable<Key, Entry, KeyOf>::MIN_CAPACITY;
+
+template <typename Key, typename Entry, typename KeyOf>
+size_t FlatHashTable<Key, Entry, KeyOf>::findSlot(const Key& key) const {
+  if (m_tags.empty()) {
+    return 0;
+  }
+
+  uint64_t hash = hashOf(key);
+  uint8_t tag = tagOf(hash);
+  size_t mask = m_tags.size() - 1;
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    uint8_t slotTag = m_tags[slot];
+    if (slotTag == EMPTY_TAG) {
+      return m_tags.size();
+    }
+
+    if (slotTag == tag && memcmp(&KeyOf()(m_entries[slot]), &key, sizeof(Key)) == 0) {
+      return slot;
+    }
+  }
+}
+
+template <typename Key>
+struct FlatHashSetKeyOf {
+  const Key& operator()(const Key& key) const { return key; }
+};
+
+template <typename Key, typename Value>
+struct FlatHashMapKeyOf {
+  const Key& operator()(const std::pair<Key, Value>& entry) const { return entry.first; }
+};
+
+template <typename Key>
+class FlatHashSet : public FlatHashTable<Key, Key, FlatHashSetKeyOf<Key>> {
+};
+
+template <typename Key, typename Value>
+class FlatHashMap : public FlatHashTable<Key, std::pair<Key, Value>, FlatHashMapKeyOf<Key, Value>> {
+  typedef FlatHashTable<Key, std::pair<Key, Value>, FlatHashMapKeyOf<Key, Value>> Base;
+
+public:
+  typedef Value mapped_type;
+
+  const Value& at(const Key& key) const {
+    size_t slot = Base::findSlot(key);
+    if (slot == Base::capacity()) {
+      throw std::out_of_range("FlatHashMap::at");
+    }
+
+    return Base::entryAt(slot).second;
+  }
+};
+
+}
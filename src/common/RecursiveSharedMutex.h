@@ -0,0 +1,143 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cassert>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace tools {
+
+// Shared/exclusive lock which, like epee::critical_section, can be re-entered by the thread holding it.
+// The exclusive owner may also take the lock shared. A thread holding the lock shared must not ask for
+// exclusive access: upgrades would wait for the thread itself, so they throw std::logic_error instead.
+// Waiting writers block new readers, but not threads which already hold the lock shared, so nested shared
+// regions never deadlock.
+class RecursiveSharedMutex {
+public:
+  RecursiveSharedMutex() : m_writerDepth(0), m_waitingWriters(0) {
+  }
+
+  RecursiveSharedMutex(const RecursiveSharedMutex&) = delete;
+  RecursiveSharedMutex& operator=(const RecursiveSharedMutex&) = delete;
+
+  void lock() {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    std::thread::id self = std::this_thread::get_id();
+    if (m_writerDepth != 0 && m_writer == self) {
+      ++m_writerDepth;
+      return;
+    }
+
+    if (m_readers.count(self) != 0) {
+      throw std::logic_error("RecursiveSharedMutex: a thread holding the lock shared asked for exclusive access");
+    }
+
+    ++m_waitingWriters;
+    while (m_writerDepth != 0 || !m_readers.empty()) {
+      m_released.wait(lk);
+    }
+
+    --m_waitingWriters;
+    m_writer = self;
+    m_writerDepth = 1;
+  }
+
+  void unlock() {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    assert(m_writerDepth != 0 && m_writer == std::this_thread::get_id());
+    if (--m_writerDepth == 0) {
+      m_writer = std::thread::id();
+      m_released.notify_all();
+    }
+  }
+
+  void lock_shared() {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    std::thread::id self = std::this_thread::get_id();
+    if (m_writerDepth != 0 && m_writer == self) {
+      ++m_writerDepth;
+      return;
+    }
+
+    auto it = m_readers.find(self);
+    if (it != m_readers.end()) {
+      ++it->second;
+      return;
+    }
+
+    while (m_writerDepth != 0 || m_waitingWriters != 0) {
+      m_released.wait(lk);
+    }
+
+    m_readers.emplace(self, 1);
+  }
+
+  void unlock_shared() {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    std::thread::id self = std::this_thread::get_id();
+    if (m_writerDepth != 0 && m_writer == self) {
+      assert(m_writerDepth > 1);
+      --m_writerDepth;
+      return;
+    }
+
+    auto it = m_readers.find(self);
+    assert(it != m_readers.end());
+    if (--it->second == 0) {
+      m_readers.erase(it);
+      if (m_readers.empty()) {
+        m_released.notify_all();
+      }
+    }
+  }
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_released;
+  std::thread::id m_writer;
+  size_t m_writerDepth;
+  size_t m_waitingWriters;
+  std::map<std::thread::id, size_t> m_readers;
+};
+
+template<class t_lock>
+class shared_region_t {
+public:
+  shared_region_t(t_lock& lock) : m_lock(lock) {
+    m_lock.lock_shared();
+  }
+
+  ~shared_region_t() {
+    m_lock.unlock_shared();
+  }
+
+  shared_region_t(const shared_region_t&) = delete;
+  shared_region_t& operator=(const shared_region_t&) = delete;
+
+private:
+  t_lock& m_lock;
+};
+
+}
+
+#define SHARED_LOCK_REGION_LOCAL(x) tools::shared_region_t<decltype(x)> shared_region_var(x)
+#define SHARED_LOCK_REGION_BEGIN(x) { tools::shared_region_t<decltype(x)> shared_region_var(x)
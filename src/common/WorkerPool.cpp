@@ -0,0 +1,153 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace tools {
+
+namespace {
+
+// Indexes of a run() are taken one at a time by the calling thread and by the workers helping it.
+class ParallelRun {
+public:
+  ParallelRun(size_t count, const std::function<void(size_t)>& task) : m_count(count), m_task(task), m_next(0), m_done(0) {
+  }
+
+  void work() {
+    for (;;) {
+      size_t index = m_next++;
+      if (index >= m_count) {
+        return;
+      }
+
+      std::exception_ptr error;
+      try {
+        m_task(index);
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (error && !m_error) {
+        m_error = error;
+      }
+
+      if (++m_done == m_count) {
+        m_finished.notify_all();
+      }
+    }
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_done != m_count) {
+      m_finished.wait(lock);
+    }
+
+    if (m_error) {
+      std::rethrow_exception(m_error);
+    }
+  }
+
+private:
+  const size_t m_count;
+  // only called for the indexes taken before wait() returns, while the caller of run() keeps the task alive
+  const std::function<void(size_t)>& m_task;
+  std::atomic<size_t> m_next;
+  std::mutex m_mutex;
+  std::condition_variable m_finished;
+  size_t m_done;
+  std::exception_ptr m_error;
+};
+
+}
+
+WorkerPool::WorkerPool(size_t threadCount) : m_stopped(false) {
+  for (size_t i = 0; i < threadCount; ++i) {
+    m_threads.emplace_back(&WorkerPool::workerThread, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopped = true;
+  }
+
+  m_haveTasks.notify_all();
+  for (std::thread& thread : m_threads) {
+    thread.join();
+  }
+}
+
+WorkerPool& WorkerPool::shared() {
+  static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()));
+  return pool;
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+
+  m_haveTasks.notify_one();
+}
+
+void WorkerPool::run(size_t count, const std::function<void(size_t)>& task) {
+  if (count == 0) {
+    return;
+  }
+
+  std::shared_ptr<ParallelRun> parallelRun = std::make_shared<ParallelRun>(count, task);
+  size_t helperCount = std::min(count - 1, m_threads.size());
+  for (size_t i = 0; i < helperCount; ++i) {
+    submit([parallelRun] { parallelRun->work(); });
+  }
+
+  parallelRun->work();
+  parallelRun->wait();
+}
+
+void WorkerPool::workerThread() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (!m_stopped && m_tasks.empty()) {
+        m_haveTasks.wait(lock);
+      }
+
+      // queued tasks are still run when the pool is destroyed
+      if (m_tasks.empty()) {
+        return;
+      }
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+
+    task();
+  }
+}
+
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tools {
+
+// Long-lived threads which run the parallel parts of block and transaction checks, so that the checks do not start
+// threads of their own on every call. run() executes tasks on the calling thread too and only waits for the tasks
+// the workers already took, so it completes even when all the workers are busy and may be called from the tasks.
+class WorkerPool {
+public:
+  explicit WorkerPool(size_t threadCount);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // the pool of the process, with a worker per core
+  static WorkerPool& shared();
+
+  size_t threadCount() const {
+    return m_threads.size();
+  }
+
+  // queues the task for one of the workers, tasks must not throw
+  void submit(std::function<void()> task);
+  // runs task(0), ..., task(count - 1) and returns once all of them are done, rethrowing the first exception thrown
+  void run(size_t count, const std::function<void(size_t)>& task);
+
+private:
+  void workerThread();
+
+  std::mutex m_mutex;
+  std::condition_variable m_haveTasks;
+  std::deque<std::function<void()>> m_tasks;
+  bool m_stopped;
+  std::vector<std::thread> m_threads;
+};
+
+}
@@ -69,6 +69,8 @@ enum {
 void cn_fast_hash(const void *data, size_t length, char *hash);
 
 void cn_slow_hash_f(void *, const void *, size_t, void *);
+/* hashes count blobs, each with its own context, interleaving up to 4 of them when AES-NI is available */
+void cn_slow_hash_batch_f(void *const *contexts, const void *const *data, const size_t *lengths, size_t count, char *hashes);
 
 void hash_extra_blake(const void *data, size_t length, char *hash);
 void hash_extra_groestl(const void *data, size_t length, char *hash);
@@ -53,6 +53,13 @@ namespace crypto {
   class cn_context {
   public:
 
+    // how the scratchpad was allocated, from the fastest to the slowest
+    enum allocation_mode {
+      HUGE_PAGES,
+      TRANSPARENT_HUGE_PAGES,
+      REGULAR_PAGES
+    };
+
     cn_context();
     ~cn_context();
 #if !defined(_MSC_VER) || _MSC_VER >= 1800
@@ -60,16 +67,40 @@ namespace crypto {
     void operator=(const cn_context &) = delete;
 #endif
 
+    allocation_mode get_allocation_mode() const { return mode; }
+    // NUMA node the scratchpad is bound to, or -1 if it isn't bound
+    int get_numa_node() const { return numa_node; }
+    static const char *allocation_mode_name(allocation_mode mode);
+
   private:
 
     void *data;
+    std::size_t size;
+    allocation_mode mode;
+    int numa_node;
     friend inline void cn_slow_hash(cn_context &, const void *, std::size_t, hash &);
+    friend inline void cn_slow_hash_batch(cn_context *, std::size_t, const void *const *, const std::size_t *, hash *);
   };
 
   inline void cn_slow_hash(cn_context &context, const void *data, std::size_t length, hash &hash) {
     (*cn_slow_hash_f)(context.data, data, length, reinterpret_cast<void *>(&hash));
   }
 
+  // hashes count blobs into count hashes, using one of the count contexts for each blob; the result is the same as
+  // hashing them one by one, but up to 4 hashes are computed at once when AES-NI is available
+  inline void cn_slow_hash_batch(cn_context *contexts, std::size_t count, const void *const *data, const std::size_t *lengths, hash *hashes) {
+    const std::size_t max_ways = 4;
+    void *scratchpads[max_ways];
+    for (std::size_t i = 0; i < count; i += max_ways) {
+      std::size_t ways = count - i < max_ways ? count - i : max_ways;
+      for (std::size_t j = 0; j < ways; ++j) {
+        scratchpads[j] = contexts[i + j].data;
+      }
+
+      cn_slow_hash_batch_f(scratchpads, data + i, lengths + i, ways, reinterpret_cast<char *>(hashes + i));
+    }
+  }
+
   inline void tree_hash(const hash *hashes, std::size_t count, hash &root_hash) {
     tree_hash(reinterpret_cast<const char (*)[HASH_SIZE]>(hashes), count, reinterpret_cast<char *>(&root_hash));
   }
@@ -0,0 +1,109 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+/* CN_WAYS hashes computed together, each with its own context. The steps of the main loop of every hash depend on the
+   previous ones, so the loop runs them side by side and the processor overlaps their AES rounds, multiplications and
+   scratchpad accesses. */
+
+#define CN_WAYS_FUNCTION_(ways) cn_slow_hash_aesni_##ways##way
+#define CN_WAYS_FUNCTION(ways) CN_WAYS_FUNCTION_(ways)
+
+static void CN_WAYS_FUNCTION(CN_WAYS)(void *const *contexts, const void *const *data, const size_t *lengths, char *hashes)
+{
+  struct cn_ctx *ctx[CN_WAYS];
+  ALIGNED_DECL(uint8_t ExpandedKey[CN_WAYS][256], 16);
+  ALIGNED_DECL(uint64_t a[CN_WAYS][2], 16);
+  __m128i b_x[CN_WAYS];
+  size_t i, w;
+
+  for (w = 0; w < CN_WAYS; w++)
+  {
+    ctx[w] = (struct cn_ctx *) contexts[w];
+    hash_process(&ctx[w]->state.hs, (const uint8_t*) data[w], lengths[w]);
+    memcpy(ctx[w]->text, ctx[w]->state.init, INIT_SIZE_BYTE);
+    memcpy(ExpandedKey[w], ctx[w]->state.hs.b, AES_KEY_SIZE);
+    ExpandAESKey256(ExpandedKey[w]);
+    cn_explode_scratchpad_aesni(ctx[w], (__m128i *) ExpandedKey[w]);
+
+    for (i = 0; i < 2; i++)
+    {
+      a[w][i] = ((uint64_t *)ctx[w]->state.k)[i] ^  ((uint64_t *)ctx[w]->state.k)[i+4];
+      ctx[w]->b[i] = ((uint64_t *)ctx[w]->state.k)[i+2] ^  ((uint64_t *)ctx[w]->state.k)[i+6];
+    }
+
+    b_x[w] = _mm_load_si128((__m128i *)ctx[w]->b);
+  }
+
+  for(i = 0; likely(i < 0x80000); i++)
+  {
+    for (w = 0; w < CN_WAYS; w++)
+    {
+      uint8_t *long_state = ctx[w]->long_state;
+      __m128i c_x = _mm_load_si128((__m128i *)&long_state[a[w][0] & 0x1FFFF0]);
+      __m128i a_x = _mm_load_si128((__m128i *)a[w]);
+      ALIGNED_DECL(uint64_t c[2], 16);
+      uint64_t b[2];
+      uint64_t *nextblock;
+      uint64_t hi, lo;
+
+      c_x = _mm_aesenc_si128(c_x, a_x);
+      _mm_store_si128((__m128i *)c, c_x);
+
+      b_x[w] = _mm_xor_si128(b_x[w], c_x);
+      _mm_store_si128((__m128i *)&long_state[a[w][0] & 0x1FFFF0], b_x[w]);
+
+      nextblock = (uint64_t *)&long_state[c[0] & 0x1FFFF0];
+      b[0] = nextblock[0];
+      b[1] = nextblock[1];
+
+#if defined(__GNUC__) && defined(__x86_64__)
+      __asm__("mulq %3\n\t"
+        : "=d" (hi),
+        "=a" (lo)
+        : "%a" (c[0]),
+        "rm" (b[0])
+        : "cc" );
+#else
+      lo = mul128(c[0], b[0], &hi);
+#endif
+
+      a[w][0] += hi;
+      a[w][1] += lo;
+      nextblock[0] = a[w][0];
+      nextblock[1] = a[w][1];
+
+      a[w][0] ^= b[0];
+      a[w][1] ^= b[1];
+      b_x[w] = c_x;
+    }
+  }
+
+  for (w = 0; w < CN_WAYS; w++)
+  {
+    memcpy(ctx[w]->text, ctx[w]->state.init, INIT_SIZE_BYTE);
+    memcpy(ExpandedKey[w], &ctx[w]->state.hs.b[32], AES_KEY_SIZE);
+    ExpandAESKey256(ExpandedKey[w]);
+    cn_implode_scratchpad_aesni(ctx[w], (__m128i *) ExpandedKey[w]);
+
+    memcpy(ctx[w]->state.init, ctx[w]->text, INIT_SIZE_BYTE);
+    hash_permutation(&ctx[w]->state.hs);
+    extra_hashes[ctx[w]->state.hs.b[0] & 3](&ctx[w]->state, 200, hashes + w * HASH_SIZE);
+  }
+}
+
+#undef CN_WAYS_FUNCTION
+#undef CN_WAYS_FUNCTION_
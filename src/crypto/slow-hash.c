@@ -178,6 +178,86 @@ static void (*const extra_hashes[4])(const void *, size_t, char *) =
 #include "slow-hash.inl"
 #define AESNI
 #include "slow-hash.inl"
+#undef ctx
+
+/* Fills the scratchpad from the AES encrypted state, as the first loop of cn_slow_hash_aesni does */
+static inline void cn_explode_scratchpad_aesni(struct cn_ctx *ctx, const __m128i *expkey)
+{
+  __m128i *longoutput = (__m128i *) ctx->long_state;
+  __m128i *xmminput = (__m128i *) ctx->text;
+  size_t i, j, k;
+
+  for (i = 0; likely(i < MEMORY); i += INIT_SIZE_BYTE)
+  {
+    for (j = 0; j < 10; j++)
+    {
+      for (k = 0; k < INIT_SIZE_BLK; k++)
+      {
+        xmminput[k] = _mm_aesenc_si128(xmminput[k], expkey[j]);
+      }
+    }
+
+    for (k = 0; k < INIT_SIZE_BLK; k++)
+    {
+      _mm_store_si128(&longoutput[(i >> 4) + k], xmminput[k]);
+    }
+  }
+}
+
+/* Folds the scratchpad back into the state, as the last loop of cn_slow_hash_aesni does */
+static inline void cn_implode_scratchpad_aesni(struct cn_ctx *ctx, const __m128i *expkey)
+{
+  __m128i *longoutput = (__m128i *) ctx->long_state;
+  __m128i *xmminput = (__m128i *) ctx->text;
+  size_t i, j, k;
+
+  for (i = 0; likely(i < MEMORY); i += INIT_SIZE_BYTE)
+  {
+    for (k = 0; k < INIT_SIZE_BLK; k++)
+    {
+      xmminput[k] = _mm_xor_si128(longoutput[(i >> 4) + k], xmminput[k]);
+    }
+
+    for (j = 0; j < 10; j++)
+    {
+      for (k = 0; k < INIT_SIZE_BLK; k++)
+      {
+        xmminput[k] = _mm_aesenc_si128(xmminput[k], expkey[j]);
+      }
+    }
+  }
+}
+
+#define CN_WAYS 2
+#include "slow-hash-ways.inl"
+#undef CN_WAYS
+#define CN_WAYS 4
+#include "slow-hash-ways.inl"
+#undef CN_WAYS
+
+static int has_aesni;
+
+void cn_slow_hash_batch_f(void *const *contexts, const void *const *data, const size_t *lengths, size_t count, char *hashes)
+{
+  size_t i = 0;
+  if (has_aesni)
+  {
+    for (; count - i >= 4; i += 4)
+    {
+      cn_slow_hash_aesni_4way(contexts + i, data + i, lengths + i, hashes + i * HASH_SIZE);
+    }
+
+    for (; count - i >= 2; i += 2)
+    {
+      cn_slow_hash_aesni_2way(contexts + i, data + i, lengths + i, hashes + i * HASH_SIZE);
+    }
+  }
+
+  for (; i < count; i++)
+  {
+    (*cn_slow_hash_fp)(contexts[i], data[i], lengths[i], hashes + i * HASH_SIZE);
+  }
+}
 
 INITIALIZER(detect_aes) {
   int ecx;
@@ -189,5 +269,6 @@ INITIALIZER(detect_aes) {
   int a, b, d;
   __cpuid(1, a, b, ecx, d);
 #endif
-  cn_slow_hash_fp = (ecx & (1 << 25)) ? &cn_slow_hash_aesni : &cn_slow_hash_noaesni;
+  has_aesni = (ecx & (1 << 25)) != 0;
+  cn_slow_hash_fp = has_aesni ? &cn_slow_hash_aesni : &cn_slow_hash_noaesni;
 }
@@ -15,6 +15,8 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <cstdint>
+#include <cstring>
 #include <new>
 
 #include "hash.h"
@@ -25,6 +27,14 @@
 #include <sys/mman.h>
 #endif
 
+#if defined(__linux__)
+#include <fstream>
+#include <string>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 using std::bad_alloc;
 
 namespace crypto {
@@ -33,9 +43,17 @@ namespace crypto {
     MAP_SIZE = SLOW_HASH_CONTEXT_SIZE + ((-SLOW_HASH_CONTEXT_SIZE) & 0xfff)
   };
 
+  const char *cn_context::allocation_mode_name(allocation_mode mode) {
+    switch (mode) {
+    case HUGE_PAGES: return "huge pages";
+    case TRANSPARENT_HUGE_PAGES: return "transparent huge pages";
+    default: return "regular pages";
+    }
+  }
+
 #if defined(WIN32)
 
-  cn_context::cn_context() {
+  cn_context::cn_context() : size(MAP_SIZE), mode(REGULAR_PAGES), numa_node(-1) {
     data = VirtualAlloc(nullptr, MAP_SIZE, MEM_COMMIT, PAGE_READWRITE);
     if (data == nullptr) {
       throw bad_alloc();
@@ -48,14 +66,89 @@ namespace crypto {
     }
   }
 
+#elif defined(__linux__)
+
+  namespace {
+
+    const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    bool transparent_huge_pages_enabled() {
+      static const bool enabled = [] {
+        std::ifstream file("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string setting;
+        return std::getline(file, setting) && setting.find("[never]") == std::string::npos;
+      }();
+
+      return enabled;
+    }
+
+    // Prefers the memory of the node the calling thread runs on, the pages must not be touched yet
+    int bind_to_current_numa_node(void *address, std::size_t size) {
+#if defined(SYS_getcpu) && defined(SYS_mbind)
+      unsigned cpu;
+      unsigned node;
+      if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0 || node >= 8 * sizeof(unsigned long)) {
+        return -1;
+      }
+
+      unsigned long node_mask = 1UL << node;
+      if (syscall(SYS_mbind, address, size, MPOL_PREFERRED, &node_mask, 8 * sizeof(node_mask), 0) != 0) {
+        return -1;
+      }
+
+      return static_cast<int>(node);
 #else
+      return -1;
+#endif
+    }
+  }
 
   cn_context::cn_context() {
-#if !defined(__APPLE__)
-    data = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    // explicit huge pages cover the whole context, the tail after the 2 MB scratchpad takes a second huge page
+    size = (MAP_SIZE + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED) {
+      mode = HUGE_PAGES;
+    } else {
+      // otherwise the scratchpad is aligned to a huge page inside a regular mapping, which lets the kernel back it
+      // with a transparent huge page, and the unaligned ends of the mapping are released
+      std::size_t mapping_size = MAP_SIZE + HUGE_PAGE_SIZE;
+      char *mapping = static_cast<char *>(mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+      if (mapping == MAP_FAILED) {
+        throw bad_alloc();
+      }
+
+      char *aligned = reinterpret_cast<char *>((reinterpret_cast<std::uintptr_t>(mapping) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+      if (aligned != mapping) {
+        munmap(mapping, aligned - mapping);
+      }
+
+      if (aligned + MAP_SIZE != mapping + mapping_size) {
+        munmap(aligned + MAP_SIZE, mapping + mapping_size - (aligned + MAP_SIZE));
+      }
+
+      data = aligned;
+      size = MAP_SIZE;
+      mode = transparent_huge_pages_enabled() && madvise(data, HUGE_PAGE_SIZE, MADV_HUGEPAGE) == 0 ? TRANSPARENT_HUGE_PAGES : REGULAR_PAGES;
+    }
+
+    numa_node = bind_to_current_numa_node(data, size);
+
+    // pages are faulted in only now, so they follow the NUMA policy and the huge page advice
+    memset(data, 0, MAP_SIZE);
+    mlock(data, MAP_SIZE);
+  }
+
+  cn_context::~cn_context() {
+    if (munmap(data, size) != 0) {
+      throw bad_alloc();
+    }
+  }
+
 #else
+
+  cn_context::cn_context() : size(MAP_SIZE), mode(REGULAR_PAGES), numa_node(-1) {
     data = mmap(nullptr, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
-#endif
     if (data == MAP_FAILED) {
       throw bad_alloc();
     }
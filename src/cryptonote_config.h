@@ -62,6 +62,7 @@ const uint64_t CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS    = DIFFICULTY_TARGET
 
 const uint64_t CRYPTONOTE_MEMPOOL_TX_LIVETIME                = 60 * 60 * 24;     //seconds, one day
 const uint64_t CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME = 60 * 60 * 24 * 7; //seconds, one week
+const size_t   CRYPTONOTE_MEMPOOL_DEFAULT_MAX_SIZE           = 64 * 1024 * 1024; //bytes of transaction blobs, the lowest paying ones are evicted
 
 const uint64_t UPGRADE_HEIGHT       = 91452;
 const unsigned UPGRADE_VOTING_THRESHOLD                      = 90;               // percent
@@ -74,6 +75,7 @@ const char     CRYPTONOTE_BLOCKCHAINDATA_FILENAME[]          = "blockchain.bin";
 const char     CRYPTONOTE_BLOCKS_FILENAME[]                  = "blocks.dat";
 const char     CRYPTONOTE_BLOCKINDEXES_FILENAME[]            = "blockindexes.dat";
 const char     CRYPTONOTE_BLOCKSCACHE_FILENAME[]             = "blockscache.dat";
+const char     CRYPTONOTE_BLOCKSCACHE_JOURNAL_FILENAME[]     = "blockscache.journal";
 const char     CRYPTONOTE_POOLDATA_FILENAME[]                = "poolstate.bin";
 const char     P2P_NET_DATA_FILENAME[]                       = "p2pstate.bin";
 const char     MINER_CONFIG_FILE_NAME[]                      = "miner_conf.json";
@@ -89,7 +91,17 @@ const uint8_t  BLOCK_MINOR_VERSION_1                         =  1;
 
 const size_t   BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT        =  10000;  //by default, blocks ids count in synchronizing
 const size_t   BLOCKS_SYNCHRONIZING_DEFAULT_COUNT            =  200;    //by default, blocks count in blocks downloading
+const size_t   BLOCK_HEADERS_SYNCHRONIZING_DEFAULT_COUNT     =  1000;   //by default, block headers count in headers checking
+const size_t   BLOCKS_SYNCHRONIZING_WINDOW_SIZE              =  2000;   //blocks from the next one to import which may be downloaded from several peers at once
+const uint32_t BLOCKS_SYNCHRONIZING_REQUEST_TIMEOUT          =  60;     //seconds before blocks requested from a peer are requested from other peers
 const size_t   COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT         =  1000;
+const size_t   BLOCKS_CACHE_POOL_SIZE                        =  4096;   //deserialized blocks kept in memory by blockchain storage
+const size_t   BLOCKS_STORE_SYNC_BATCH                       =  256;    //appended blocks between flushes of block storage to disk
+const size_t   BLOCKS_REBUILD_BATCH_SIZE                     =  500;    //blocks hashed by one thread at a time while rebuilding blockchain indexes
+const size_t   BLOCKS_CACHE_CHECKPOINT_RECORDS               =  500;    //journaled block changes after which blockchain cache is saved again
+const uint64_t BLOCKS_CACHE_CHECKPOINT_MIN_PERIOD            =  600;    //minimal seconds between periodic saves of blockchain cache
+const size_t   TRANSACTION_VALIDATION_CACHE_SIZE             =  50000;  //transactions with verified ring signatures remembered for block import
+const size_t   PRECOMPUTED_LONG_HASHES_MAX_COUNT             =  20000;  //proof of work hashes of received blocks and checked headers kept until the blocks are pushed
 
 const int      P2P_DEFAULT_PORT       = 29080;
 const int      RPC_DEFAULT_PORT       = 29081;
@@ -107,6 +119,12 @@ const uint64_t P2P_DEFAULT_INVOKE_TIMEOUT                    = 60 * 2 * 1000; //
 const size_t   P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT          = 5000;          // 5 seconds
 const char     P2P_STAT_TRUSTED_PUB_KEY[]       = "4d26c4df7f4ca7037950ad026f9ab36dd05d881952662992f2e4dcfcafbe57eb";
 const size_t   P2P_DEFAULT_WHITELIST_CONNECTIONS_PERCENT     = 70;
+const size_t   P2P_RELAY_KNOWN_TRANSACTIONS_MAX_COUNT        = 5000;          // transaction ids remembered per connection as already known to the peer
+const uint32_t P2P_RELAY_TRANSACTION_REQUEST_TIMEOUT         = 30;            // seconds before a transaction announced by id is requested from another peer
+const size_t   P2P_RELAY_TRANSACTION_ANNOUNCERS_MAX_COUNT    = 8;             // peers remembered per requested transaction to be asked if the first one fails
+const size_t   P2P_RELAY_ANNOUNCED_TRANSACTIONS_MAX_COUNT    = 1000;          // unknown transaction ids requested from one announcement
+const uint32_t P2P_COMPACT_BLOCK_TRANSACTIONS_TIMEOUT        = 30;            // seconds a compact block waits for the transactions requested from its sender
+const size_t   P2P_COMPACT_BLOCK_TRANSACTIONS_MAX_REQUESTS   = 2;             // requests for missing transactions of a compact block before its chain is requested
 
 const unsigned THREAD_STACK_SIZE                             = 5 * 1024 * 1024;
 
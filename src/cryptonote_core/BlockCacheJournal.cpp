@@ -0,0 +1,147 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "BlockCacheJournal.h"
+
+#include <cstring>
+
+namespace {
+  const uint32_t JOURNAL_VERSION = 1;
+  const uint32_t MAX_BLOCK_BLOB_SIZE = 256 * 1024 * 1024;
+
+  template<typename T> void appendPod(std::string& buffer, const T& value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  template<typename T> bool readPod(std::istream& stream, std::string& buffer, T& value) {
+    if (!stream.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+      return false;
+    }
+
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    return true;
+  }
+
+  uint32_t checksum(const std::string& buffer) {
+    crypto::hash hash = crypto::cn_fast_hash(buffer.data(), buffer.size());
+    uint32_t result;
+    memcpy(&result, &hash, sizeof(result));
+    return result;
+  }
+}
+
+namespace cryptonote
+{
+  BlockCacheJournal::BlockCacheJournal() : m_recordCount(0) {
+  }
+
+  bool BlockCacheJournal::reset(const std::string& fileName, const crypto::hash& cacheTailId) {
+    close();
+    m_file.open(fileName, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    if (!m_file) {
+      return false;
+    }
+
+    std::string header;
+    appendPod(header, JOURNAL_VERSION);
+    appendPod(header, cacheTailId);
+    m_file.write(header.data(), header.size());
+    m_file.flush();
+    if (!m_file) {
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  bool BlockCacheJournal::append(const Record& record) {
+    if (!m_file.is_open()) {
+      return false;
+    }
+
+    std::string buffer;
+    appendPod(buffer, record.type);
+    appendPod(buffer, record.height);
+    appendPod(buffer, record.blockHash);
+    appendPod(buffer, static_cast<uint32_t>(record.blockBlob.size()));
+    buffer += record.blockBlob;
+    appendPod(buffer, checksum(buffer));
+
+    m_file.write(buffer.data(), buffer.size());
+    m_file.flush();
+    if (!m_file) {
+      close();
+      return false;
+    }
+
+    ++m_recordCount;
+    return true;
+  }
+
+  void BlockCacheJournal::close() {
+    if (m_file.is_open()) {
+      m_file.close();
+    }
+
+    m_file.clear();
+    m_recordCount = 0;
+  }
+
+  bool BlockCacheJournal::load(const std::string& fileName, crypto::hash& cacheTailId, std::vector<Record>& records) {
+    std::ifstream file(fileName, std::ios_base::binary | std::ios_base::in);
+    if (!file) {
+      return false;
+    }
+
+    std::string header;
+    uint32_t version;
+    if (!readPod(file, header, version) || version != JOURNAL_VERSION || !readPod(file, header, cacheTailId)) {
+      return false;
+    }
+
+    for (;;) {
+      std::string buffer;
+      Record record;
+      uint32_t blobSize;
+      if (!readPod(file, buffer, record.type) || !readPod(file, buffer, record.height) || !readPod(file, buffer, record.blockHash) ||
+        !readPod(file, buffer, blobSize) || blobSize > MAX_BLOCK_BLOB_SIZE) {
+        break;
+      }
+
+      record.blockBlob.resize(blobSize);
+      if (blobSize != 0 && !file.read(&record.blockBlob[0], blobSize)) {
+        break;
+      }
+
+      buffer += record.blockBlob;
+      uint32_t expectedChecksum = checksum(buffer);
+      uint32_t recordChecksum;
+      if (!file.read(reinterpret_cast<char*>(&recordChecksum), sizeof(recordChecksum)) || recordChecksum != expectedChecksum) {
+        break;
+      }
+
+      if (record.type != BLOCK_PUSHED && record.type != BLOCK_POPPED) {
+        break;
+      }
+
+      records.push_back(std::move(record));
+    }
+
+    return true;
+  }
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  // Append-only log of main chain changes made since the blockchain cache was last saved. Popped blocks are logged
+  // with their contents, so the indexes of a saved cache can be rolled back to the current chain after a crash.
+  class BlockCacheJournal {
+
+  public:
+
+    enum RecordType : uint8_t {
+      BLOCK_PUSHED = 1,
+      BLOCK_POPPED = 2
+    };
+
+    struct Record {
+      RecordType type;
+      uint64_t height;
+      crypto::hash blockHash;
+      std::string blockBlob;
+    };
+
+    BlockCacheJournal();
+
+    // starts an empty journal for a cache saved with the given tail block, replacing the file
+    bool reset(const std::string& fileName, const crypto::hash& cacheTailId);
+    // the record is flushed to the operating system before returning, so it survives a crash of the process
+    bool append(const Record& record);
+    void close();
+
+    bool isOpen() const { return m_file.is_open(); }
+    size_t recordCount() const { return m_recordCount; }
+
+    // reads all complete records, a torn or corrupted record and everything after it are ignored
+    static bool load(const std::string& fileName, crypto::hash& cacheTailId, std::vector<Record>& records);
+
+  private:
+
+    std::ofstream m_file;
+    size_t m_recordCount;
+  };
+}
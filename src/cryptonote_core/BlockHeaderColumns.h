@@ -0,0 +1,115 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include <boost/serialization/vector.hpp>
+
+#include "difficulty.h"
+
+namespace cryptonote
+{
+  // Per-height header fields of the main chain, stored column by column, so difficulty, timestamp and size
+  // computations do not have to load whole blocks from the block storage.
+  class BlockHeaderColumns {
+
+  public:
+
+    void push(uint64_t timestamp, difficulty_type cumulativeDifficulty, uint64_t cumulativeSize, uint64_t generatedCoins, uint8_t majorVersion) {
+      m_timestamps.push_back(timestamp);
+      m_cumulativeDifficulties.push_back(cumulativeDifficulty);
+      m_cumulativeSizes.push_back(cumulativeSize);
+      m_generatedCoins.push_back(generatedCoins);
+      m_majorVersions.push_back(majorVersion);
+    }
+
+    void pop() {
+      assert(!empty());
+      m_timestamps.pop_back();
+      m_cumulativeDifficulties.pop_back();
+      m_cumulativeSizes.pop_back();
+      m_generatedCoins.pop_back();
+      m_majorVersions.pop_back();
+    }
+
+    void clear() {
+      m_timestamps.clear();
+      m_cumulativeDifficulties.clear();
+      m_cumulativeSizes.clear();
+      m_generatedCoins.clear();
+      m_majorVersions.clear();
+    }
+
+    bool empty() const {
+      return m_timestamps.empty();
+    }
+
+    uint64_t size() const {
+      return m_timestamps.size();
+    }
+
+    uint64_t timestamp(uint64_t height) const {
+      return m_timestamps[height];
+    }
+
+    difficulty_type cumulativeDifficulty(uint64_t height) const {
+      return m_cumulativeDifficulties[height];
+    }
+
+    uint64_t cumulativeSize(uint64_t height) const {
+      return m_cumulativeSizes[height];
+    }
+
+    uint64_t generatedCoins(uint64_t height) const {
+      return m_generatedCoins[height];
+    }
+
+    uint8_t majorVersion(uint64_t height) const {
+      return m_majorVersions[height];
+    }
+
+    // binary search from startHeight on, returns size() if all timestamps are less than the given one
+    uint64_t timestampLowerBound(uint64_t startHeight, uint64_t timestamp) const {
+      if (startHeight >= size()) {
+        return size();
+      }
+
+      return std::lower_bound(m_timestamps.begin() + startHeight, m_timestamps.end(), timestamp) - m_timestamps.begin();
+    }
+
+    template <class Archive> void serialize(Archive& ar, const unsigned int version) {
+      ar & m_timestamps;
+      ar & m_cumulativeDifficulties;
+      ar & m_cumulativeSizes;
+      ar & m_generatedCoins;
+      ar & m_majorVersions;
+    }
+
+  private:
+
+    std::vector<uint64_t> m_timestamps;
+    std::vector<difficulty_type> m_cumulativeDifficulties;
+    std::vector<uint64_t> m_cumulativeSizes;
+    std::vector<uint64_t> m_generatedCoins;
+    std::vector<uint8_t> m_majorVersions;
+  };
+}
@@ -21,17 +21,17 @@
 namespace CryptoNote
 {
   crypto::hash BlockIndex::getBlockId(uint64_t height) const {
-    if (height >= m_container.size())
+    if (height >= m_ids.size())
       return boost::value_initialized<crypto::hash>();
-    return m_container[static_cast<size_t>(height)];
+    return m_ids[static_cast<size_t>(height)];
   }
 
   bool BlockIndex::getBlockIds(uint64_t startHeight, size_t maxCount, std::list<crypto::hash>& items) const {
-    if (startHeight >= m_container.size())
+    if (startHeight >= m_ids.size())
       return false;
 
-    for (size_t i = startHeight; i < (startHeight + maxCount) && i < m_container.size(); ++i) {
-      items.push_back(m_container[i]);
+    for (size_t i = startHeight; i < (startHeight + maxCount) && i < m_ids.size(); ++i) {
+      items.push_back(m_ids[i]);
     }
 
     return true;
@@ -60,7 +60,7 @@ namespace CryptoNote
     bool genesis_included = false;
 
     while (current_back_offset < sz) {
-      ids.push_back(m_container[sz - current_back_offset]);
+      ids.push_back(m_ids[sz - current_back_offset]);
       if (sz - current_back_offset == 0)
         genesis_included = true;
       if (i < 10) {
@@ -72,15 +72,15 @@ namespace CryptoNote
     }
 
     if (!genesis_included)
-      ids.push_back(m_container[0]);
+      ids.push_back(m_ids[0]);
 
     return true;
   }
 
   crypto::hash BlockIndex::getTailId() const {
-    if (m_container.empty())
+    if (m_ids.empty())
       return boost::value_initialized<crypto::hash>();
-    return m_container.back();
+    return m_ids.back();
   }
 
 
@@ -15,52 +15,63 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
-// multi index
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/random_access_index.hpp>
+#pragma once
 
-#include "crypto/hash.h"
 #include <list>
+#include <vector>
+
+#include <boost/serialization/vector.hpp>
+
+#include "common/FlatHashTable.h"
+#include "crypto/hash.h"
 
 namespace CryptoNote
 {
+  // Main chain block ids by height, with a flat hash table from id to height for O(1) lookups.
   class BlockIndex {
 
   public:
 
-    BlockIndex() : 
-      m_index(m_container.get<1>()) {}
-
     void pop() {
-      m_container.pop_back();
+      m_heights.erase(m_ids.back());
+      m_ids.pop_back();
     }
 
     // returns true if new element was inserted, false if already exists
     bool push(const crypto::hash& h) {
-      auto result = m_container.push_back(h);
-      return result.second;
+      if (!m_heights.insert(std::make_pair(h, static_cast<uint32_t>(m_ids.size()))).second) {
+        return false;
+      }
+
+      m_ids.push_back(h);
+      return true;
     }
 
     bool hasBlock(const crypto::hash& h) const {
-      return m_index.find(h) != m_index.end();
+      return m_heights.count(h) != 0;
     }
 
     bool getBlockHeight(const crypto::hash& h, uint64_t& height) const {
-      auto hi = m_index.find(h);
-      if (hi == m_index.end())
+      auto hi = m_heights.find(h);
+      if (hi == m_heights.end())
         return false;
 
-      height = std::distance(m_container.begin(), m_container.project<0>(hi));
+      height = hi->second;
       return true;
     }
 
     size_t size() const {
-      return m_container.size();
+      return m_ids.size();
     }
 
     void clear() {
-      m_container.clear();
+      m_ids.clear();
+      m_heights.clear();
+    }
+
+    void reserve(size_t count) {
+      m_ids.reserve(count);
+      m_heights.reserve(count);
     }
 
     crypto::hash getBlockId(uint64_t height) const;
@@ -70,21 +81,14 @@ namespace CryptoNote
     crypto::hash getTailId() const;
 
     template <class Archive> void serialize(Archive& ar, const unsigned int version) {
-      ar & m_container;
+      ar & m_ids;
+      ar & m_heights;
     }
 
   private:
 
-    typedef boost::multi_index_container <
-      crypto::hash,
-      boost::multi_index::indexed_by<
-        boost::multi_index::random_access<>,
-        boost::multi_index::hashed_unique<boost::multi_index::identity<crypto::hash>>
-      >
-    > ContainerT;
-
-    ContainerT m_container;
-    ContainerT::nth_index<1>::type& m_index;
+    std::vector<crypto::hash> m_ids;
+    tools::FlatHashMap<crypto::hash, uint32_t> m_heights;
 
   };
 }
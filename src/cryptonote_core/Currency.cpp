@@ -43,6 +43,7 @@ namespace cryptonote {
       m_upgradeHeight = 0;
       m_blocksFileName       = "testnet_" + m_blocksFileName;
       m_blocksCacheFileName  = "testnet_" + m_blocksCacheFileName;
+      m_blocksCacheJournalFileName = "testnet_" + m_blocksCacheJournalFileName;
       m_blockIndexesFileName = "testnet_" + m_blockIndexesFileName;
       m_txPoolFileName       = "testnet_" + m_txPoolFileName;
     }
@@ -285,50 +286,44 @@ namespace cryptonote {
     return (low + timeSpan - 1) / timeSpan;
   }
 
-  bool Currency::checkProofOfWorkV1(crypto::cn_context& context, const Block& block, difficulty_type currentDiffic,
-                                    crypto::hash& proofOfWork) const {
+  bool Currency::checkProofOfWorkV1(const Block& block, difficulty_type currentDiffic, const crypto::hash& proofOfWork) const {
     if (BLOCK_MAJOR_VERSION_1 != block.majorVersion) {
       return false;
     }
 
-    if (!get_block_longhash(context, block, proofOfWork)) {
-      return false;
-    }
-
     return check_hash(proofOfWork, currentDiffic);
   }
 
-  bool Currency::checkProofOfWorkV2(crypto::cn_context& context, const Block& block, difficulty_type currentDiffic,
-                                    crypto::hash& proofOfWork) const {
+  bool Currency::checkProofOfWorkV2(const Block& block, difficulty_type currentDiffic, const crypto::hash& proofOfWork) const {
     if (BLOCK_MAJOR_VERSION_2 != block.majorVersion) {
       return false;
     }
 
-    if (!get_block_longhash(context, block, proofOfWork)) {
+    if (!check_hash(proofOfWork, currentDiffic)) {
       return false;
     }
 
-    if (!check_hash(proofOfWork, currentDiffic)) {
+    crypto::hash auxBlockHeaderHash;
+    if (!get_aux_block_header_hash(block, auxBlockHeaderHash)) {
       return false;
     }
 
+    return checkMergeMiningProof(block.parentBlock, auxBlockHeaderHash);
+  }
+
+  bool Currency::checkMergeMiningProof(const ParentBlock& parentBlock, const crypto::hash& auxBlockHeaderHash) const {
     tx_extra_merge_mining_tag mmTag;
-    if (!get_mm_tag_from_extra(block.parentBlock.minerTx.extra, mmTag)) {
+    if (!get_mm_tag_from_extra(parentBlock.minerTx.extra, mmTag)) {
       LOG_ERROR("merge mining tag wasn't found in extra of the parent block miner transaction");
       return false;
     }
 
-    if (8 * sizeof(m_genesisBlockHash) < block.parentBlock.blockchainBranch.size()) {
-      return false;
-    }
-
-    crypto::hash auxBlockHeaderHash;
-    if (!get_aux_block_header_hash(block, auxBlockHeaderHash)) {
+    if (8 * sizeof(m_genesisBlockHash) < parentBlock.blockchainBranch.size()) {
       return false;
     }
 
     crypto::hash auxBlocksMerkleRoot;
-    crypto::tree_hash_from_branch(block.parentBlock.blockchainBranch.data(), block.parentBlock.blockchainBranch.size(),
+    crypto::tree_hash_from_branch(parentBlock.blockchainBranch.data(), parentBlock.blockchainBranch.size(),
       auxBlockHeaderHash, &m_genesisBlockHash, auxBlocksMerkleRoot);
     CHECK_AND_NO_ASSERT_MES(auxBlocksMerkleRoot == mmTag.merkle_root, false, "Aux block hash wasn't found in merkle tree");
 
@@ -336,14 +331,44 @@ namespace cryptonote {
   }
 
   bool Currency::checkProofOfWork(crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, crypto::hash& proofOfWork) const {
+    if (!get_block_longhash(context, block, proofOfWork)) {
+      return false;
+    }
+
+    return checkProofOfWork(block, currentDiffic, proofOfWork);
+  }
+
+  bool Currency::checkProofOfWork(const Block& block, difficulty_type currentDiffic, const crypto::hash& proofOfWork) const {
     switch (block.majorVersion) {
-    case BLOCK_MAJOR_VERSION_1: return checkProofOfWorkV1(context, block, currentDiffic, proofOfWork);
-    case BLOCK_MAJOR_VERSION_2: return checkProofOfWorkV2(context, block, currentDiffic, proofOfWork);
+    case BLOCK_MAJOR_VERSION_1: return checkProofOfWorkV1(block, currentDiffic, proofOfWork);
+    case BLOCK_MAJOR_VERSION_2: return checkProofOfWorkV2(block, currentDiffic, proofOfWork);
     }
 
     CHECK_AND_ASSERT_MES(false, false, "Unknown block major version: " << block.majorVersion << "." << block.minorVersion);
   }
 
+  bool Currency::checkProofOfWork(const BlockShortHeader& header, difficulty_type currentDiffic, const crypto::hash& proofOfWork) const {
+    switch (header.majorVersion) {
+    case BLOCK_MAJOR_VERSION_1:
+      return check_hash(proofOfWork, currentDiffic);
+
+    case BLOCK_MAJOR_VERSION_2: {
+      if (!check_hash(proofOfWork, currentDiffic)) {
+        return false;
+      }
+
+      crypto::hash auxBlockHeaderHash;
+      if (!get_aux_block_header_hash(header, auxBlockHeaderHash)) {
+        return false;
+      }
+
+      return checkMergeMiningProof(header.parentBlock, auxBlockHeaderHash);
+    }
+    }
+
+    CHECK_AND_ASSERT_MES(false, false, "Unknown block major version: " << header.majorVersion << "." << header.minorVersion);
+  }
+
   CurrencyBuilder::CurrencyBuilder() {
     maxBlockNumber(parameters::CRYPTONOTE_MAX_BLOCK_NUMBER);
     maxBlockBlobSize(parameters::CRYPTONOTE_MAX_BLOCK_BLOB_SIZE);
@@ -388,6 +413,7 @@ namespace cryptonote {
 
     blocksFileName(parameters::CRYPTONOTE_BLOCKS_FILENAME);
     blocksCacheFileName(parameters::CRYPTONOTE_BLOCKSCACHE_FILENAME);
+    blocksCacheJournalFileName(parameters::CRYPTONOTE_BLOCKSCACHE_JOURNAL_FILENAME);
     blockIndexesFileName(parameters::CRYPTONOTE_BLOCKINDEXES_FILENAME);
     txPoolFileName(parameters::CRYPTONOTE_POOLDATA_FILENAME);
 
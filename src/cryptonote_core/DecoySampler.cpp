@@ -0,0 +1,72 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "DecoySampler.h"
+
+#include <cassert>
+
+#include <boost/thread/tss.hpp>
+
+#include "crypto/crypto.h"
+
+namespace cryptonote
+{
+  DecoySampler::DecoySampler(size_t populationSize) : m_populationSize(populationSize), m_drawn(0) {
+  }
+
+  size_t DecoySampler::next() {
+    assert(!empty());
+    std::uniform_int_distribution<size_t> distribution(m_drawn, m_populationSize - 1);
+    size_t position = distribution(generator());
+    size_t value = valueAt(position);
+    if (position != m_drawn) {
+      m_swapped[position] = valueAt(m_drawn);
+    }
+
+    m_swapped.erase(m_drawn);
+    ++m_drawn;
+    return value;
+  }
+
+  const size_t DecoySampler::RandomGenerator::BLOCK_SIZE;
+
+  DecoySampler::RandomGenerator::result_type DecoySampler::RandomGenerator::operator()() {
+    if (m_next == BLOCK_SIZE) {
+      m_block = crypto::rand<std::array<result_type, BLOCK_SIZE>>();
+      m_next = 0;
+    }
+
+    // values are not kept once served
+    result_type value = m_block[m_next];
+    m_block[m_next++] = 0;
+    return value;
+  }
+
+  DecoySampler::RandomGenerator& DecoySampler::generator() {
+    static boost::thread_specific_ptr<RandomGenerator> threadGenerator;
+    if (threadGenerator.get() == nullptr) {
+      threadGenerator.reset(new RandomGenerator());
+    }
+
+    return *threadGenerator;
+  }
+
+  size_t DecoySampler::valueAt(size_t position) const {
+    auto it = m_swapped.find(position);
+    return it == m_swapped.end() ? position : it->second;
+  }
+}
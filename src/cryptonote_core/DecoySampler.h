@@ -0,0 +1,71 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <unordered_map>
+
+namespace cryptonote
+{
+  // Draws distinct indexes uniformly from [0, populationSize) in random order, without rejections: a Fisher-Yates
+  // shuffle where only the swapped positions are remembered, so each draw costs O(1) whatever the population size.
+  class DecoySampler {
+
+  public:
+
+    explicit DecoySampler(size_t populationSize);
+
+    // true when every index of the population was drawn
+    bool empty() const { return m_drawn == m_populationSize; }
+    size_t drawn() const { return m_drawn; }
+    size_t next();
+
+    // Serves values of the crypto random generator, fetched in blocks so its global lock is rarely taken
+    class RandomGenerator {
+    public:
+      typedef uint64_t result_type;
+
+      RandomGenerator() : m_next(BLOCK_SIZE) {
+      }
+
+      static constexpr result_type min() { return std::numeric_limits<result_type>::min(); }
+      static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+      result_type operator()();
+
+    private:
+      static const size_t BLOCK_SIZE = 64;
+
+      std::array<result_type, BLOCK_SIZE> m_block;
+      size_t m_next;
+    };
+
+    // generator of the calling thread, created when first used by the thread
+    static RandomGenerator& generator();
+
+  private:
+
+    size_t valueAt(size_t position) const;
+
+    size_t m_populationSize;
+    size_t m_drawn;
+    std::unordered_map<size_t, size_t> m_swapped;
+  };
+}
@@ -0,0 +1,634 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include "include_base_utils.h"
+#include "serialization/binary_archive.h"
+
+// Drop-in replacement for SwappedVector which keeps the same on-disk layout (items file with serialized items
+// written back to back, index file with uint64_t count followed by uint32_t item sizes), but accesses both files
+// through memory mappings. Cache misses are deserialized straight from the mapped items file, appended items are
+// written into the mapping and flushed to disk every syncBatch items. Files grow by remapping and are truncated
+// back to their exact size on close().
+//
+// get() may be called from several threads at once, as long as nothing modifies the vector meanwhile.
+// References returned by operator[] stay valid only until the item is evicted, so they are meant for
+// callers which access the vector exclusively.
+template<class T> class MappedVector {
+public:
+  typedef T value_type;
+
+  class const_iterator {
+  public:
+    typedef ptrdiff_t difference_type;
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef const T* pointer;
+    typedef const T& reference;
+    typedef T value_type;
+
+    const_iterator() {
+    }
+
+    const_iterator(MappedVector* mappedVector, std::size_t index) : m_mappedVector(mappedVector), m_index(index) {
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return m_index != other.m_index;
+    }
+
+    bool operator<(const const_iterator& other) const {
+      return m_index < other.m_index;
+    }
+
+    bool operator<=(const const_iterator& other) const {
+      return m_index <= other.m_index;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return m_index == other.m_index;
+    }
+
+    bool operator>(const const_iterator& other) const {
+      return m_index > other.m_index;
+    }
+
+    bool operator>=(const const_iterator& other) const {
+      return m_index >= other.m_index;
+    }
+
+    const_iterator& operator++() {
+      ++m_index;
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator i = *this;
+      ++m_index;
+      return i;
+    }
+
+    const_iterator& operator--() {
+      --m_index;
+      return *this;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator i = *this;
+      --m_index;
+      return i;
+    }
+
+    const_iterator& operator+=(difference_type n) {
+      m_index += n;
+      return *this;
+    }
+
+    const_iterator& operator-=(difference_type n) {
+      m_index -= n;
+      return *this;
+    }
+
+    const_iterator operator+(difference_type n) const {
+      return const_iterator(m_mappedVector, m_index + n);
+    }
+
+    friend const_iterator operator+(difference_type n, const const_iterator& i) {
+      return const_iterator(i.m_mappedVector, n + i.m_index);
+    }
+
+    difference_type operator-(const const_iterator& other) const {
+      return m_index - other.m_index;
+    }
+
+    const_iterator operator-(difference_type n) const {
+      return const_iterator(m_mappedVector, m_index - n);
+    }
+
+    const T& operator*() const {
+      return (*m_mappedVector)[m_index];
+    }
+
+    const T* operator->() const {
+      return &(*m_mappedVector)[m_index];
+    }
+
+    const T& operator[](difference_type offset) const {
+      return (*m_mappedVector)[m_index + offset];
+    }
+
+    std::size_t index() const {
+      return m_index;
+    }
+
+  private:
+    MappedVector* m_mappedVector;
+    std::size_t m_index;
+  };
+
+  MappedVector();
+  MappedVector(const MappedVector&) = delete;
+  ~MappedVector();
+  MappedVector& operator=(const MappedVector&) = delete;
+
+  bool open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize, size_t syncBatch);
+  void close();
+  void flush();
+
+  bool empty() const;
+  uint64_t size() const;
+  const_iterator begin();
+  const_iterator end();
+  const T& operator[](uint64_t index);
+  std::shared_ptr<const T> get(uint64_t index);
+  const T& front();
+  const T& back();
+  void clear();
+  void pop_back();
+  void push_back(const T& item);
+
+private:
+  class MappedFile {
+  public:
+    MappedFile() : m_capacity(0) {
+    }
+
+    bool open(const std::string& fileName);
+    void close(uint64_t size);
+    void reserve(uint64_t size);
+    void flush(uint64_t offset, uint64_t size);
+
+    uint64_t capacity() const {
+      return m_capacity;
+    }
+
+    char* data() const {
+      return static_cast<char*>(m_region.get_address());
+    }
+
+  private:
+    std::string m_fileName;
+    boost::interprocess::file_mapping m_mapping;
+    boost::interprocess::mapped_region m_region;
+    uint64_t m_capacity;
+
+    void map();
+    void unmap();
+  };
+
+  // Cache entries live in a preallocated vector and are chained into an intrusive LRU list by slot number,
+  // so cache hits do not allocate.
+  struct CacheSlot {
+    uint64_t index;
+    size_t prev;
+    size_t next;
+    std::shared_ptr<const T> item;
+  };
+
+  static const size_t NO_SLOT = std::numeric_limits<size_t>::max();
+  static const uint64_t INDEX_HEADER_SIZE = sizeof(uint64_t);
+
+  MappedFile m_itemsFile;
+  MappedFile m_indexesFile;
+  bool m_opened;
+  size_t m_poolSize;
+  size_t m_syncBatch;
+  std::vector<uint64_t> m_offsets;
+  uint64_t m_itemsFileSize;
+  uint64_t m_syncedItemsFileSize;
+  uint64_t m_syncedCount;
+  std::mutex m_cacheMutex;
+  std::vector<CacheSlot> m_cache;
+  std::unordered_map<uint64_t, size_t> m_cacheIndex;
+  size_t m_cacheHead;
+  size_t m_cacheTail;
+  uint64_t m_cacheHits;
+  uint64_t m_cacheMisses;
+
+  uint64_t indexFileSize(uint64_t count) const;
+  void writeCount(uint64_t count);
+  void resetCache();
+  void unlinkSlot(size_t slot);
+  void linkSlotAsNewest(size_t slot);
+  void prepare(uint64_t index, const std::shared_ptr<const T>& item);
+  void evict(uint64_t index);
+};
+
+template<class T> bool MappedVector<T>::MappedFile::open(const std::string& fileName) {
+  m_fileName = fileName;
+  if (!boost::filesystem::exists(m_fileName)) {
+    std::ofstream file(m_fileName, std::ios::out | std::ios::binary);
+    if (!file) {
+      return false;
+    }
+  }
+
+  m_capacity = boost::filesystem::file_size(m_fileName);
+  if (m_capacity != 0) {
+    map();
+  }
+
+  return true;
+}
+
+template<class T> void MappedVector<T>::MappedFile::close(uint64_t size) {
+  unmap();
+  if (!m_fileName.empty() && m_capacity != size) {
+    boost::filesystem::resize_file(m_fileName, size);
+  }
+
+  m_capacity = 0;
+  m_fileName.clear();
+}
+
+template<class T> void MappedVector<T>::MappedFile::reserve(uint64_t size) {
+  if (size <= m_capacity) {
+    return;
+  }
+
+  // Grow geometrically so that appends remap O(log n) times, but do not double multi-gigabyte files in one step.
+  const uint64_t minimalGrowth = 1024 * 1024;
+  const uint64_t maximalGrowth = 256 * 1024 * 1024;
+  uint64_t newCapacity = m_capacity + std::min(std::max(m_capacity, minimalGrowth), maximalGrowth);
+  newCapacity = std::max(newCapacity, size);
+
+  unmap();
+  boost::filesystem::resize_file(m_fileName, newCapacity);
+  m_capacity = newCapacity;
+  map();
+}
+
+template<class T> void MappedVector<T>::MappedFile::flush(uint64_t offset, uint64_t size) {
+  if (size != 0 && m_capacity != 0) {
+    m_region.flush(static_cast<std::size_t>(offset), static_cast<std::size_t>(size), false);
+  }
+}
+
+template<class T> void MappedVector<T>::MappedFile::map() {
+  boost::interprocess::file_mapping mapping(m_fileName.c_str(), boost::interprocess::read_write);
+  boost::interprocess::mapped_region region(mapping, boost::interprocess::read_write, 0, static_cast<std::size_t>(m_capacity));
+  m_mapping.swap(mapping);
+  m_region.swap(region);
+}
+
+template<class T> void MappedVector<T>::MappedFile::unmap() {
+  boost::interprocess::mapped_region region;
+  m_region.swap(region);
+  boost::interprocess::file_mapping mapping;
+  m_mapping.swap(mapping);
+}
+
+template<class T> MappedVector<T>::MappedVector() : m_opened(false) {
+}
+
+template<class T> MappedVector<T>::~MappedVector() {
+  close();
+}
+
+template<class T> bool MappedVector<T>::open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize, size_t syncBatch) {
+  if (poolSize == 0 || syncBatch == 0) {
+    return false;
+  }
+
+  close();
+
+  try {
+    if (!m_itemsFile.open(itemFileName) || !m_indexesFile.open(indexFileName)) {
+      return false;
+    }
+
+    std::vector<uint64_t> offsets;
+    uint64_t itemsFileSize = 0;
+    if (m_indexesFile.capacity() >= INDEX_HEADER_SIZE) {
+      uint64_t count;
+      memcpy(&count, m_indexesFile.data(), sizeof count);
+      if (m_indexesFile.capacity() < indexFileSize(count)) {
+        return false;
+      }
+
+      offsets.reserve(static_cast<size_t>(count));
+      const char* itemSizes = m_indexesFile.data() + INDEX_HEADER_SIZE;
+      for (uint64_t i = 0; i < count; ++i) {
+        uint32_t itemSize;
+        memcpy(&itemSize, itemSizes + i * sizeof itemSize, sizeof itemSize);
+        offsets.emplace_back(itemsFileSize);
+        itemsFileSize += itemSize;
+      }
+
+      if (m_itemsFile.capacity() < itemsFileSize) {
+        return false;
+      }
+    } else {
+      m_indexesFile.reserve(INDEX_HEADER_SIZE);
+      uint64_t count = 0;
+      memcpy(m_indexesFile.data(), &count, sizeof count);
+    }
+
+    m_offsets.swap(offsets);
+    m_itemsFileSize = itemsFileSize;
+  } catch (std::exception& e) {
+    LOG_ERROR("MappedVector: failed to open " << itemFileName << ": " << e.what());
+    return false;
+  }
+
+  m_opened = true;
+  m_poolSize = poolSize;
+  m_syncBatch = syncBatch;
+  m_syncedItemsFileSize = m_itemsFileSize;
+  m_syncedCount = m_offsets.size();
+  resetCache();
+  m_cacheHits = 0;
+  m_cacheMisses = 0;
+  return true;
+}
+
+template<class T> void MappedVector<T>::close() {
+  if (!m_opened) {
+    return;
+  }
+
+  flush();
+  m_itemsFile.close(m_itemsFileSize);
+  m_indexesFile.close(indexFileSize(m_offsets.size()));
+  m_opened = false;
+  resetCache();
+  if (m_cacheHits + m_cacheMisses != 0) {
+    LOG_PRINT_L1("MappedVector cache hits: " << m_cacheHits << ", misses: " << m_cacheMisses << " (" << std::fixed << std::setprecision(2) <<
+      static_cast<double>(m_cacheMisses) / (m_cacheHits + m_cacheMisses) * 100 << "%)");
+  }
+}
+
+template<class T> void MappedVector<T>::flush() {
+  if (!m_opened) {
+    return;
+  }
+
+  // Items go to disk before the index which references them, like with the stream based implementation.
+  if (m_itemsFileSize > m_syncedItemsFileSize) {
+    m_itemsFile.flush(m_syncedItemsFileSize, m_itemsFileSize - m_syncedItemsFileSize);
+  }
+
+  if (m_offsets.size() > m_syncedCount) {
+    m_indexesFile.flush(indexFileSize(m_syncedCount), (m_offsets.size() - m_syncedCount) * sizeof(uint32_t));
+  }
+
+  m_indexesFile.flush(0, INDEX_HEADER_SIZE);
+  m_syncedItemsFileSize = m_itemsFileSize;
+  m_syncedCount = m_offsets.size();
+}
+
+template<class T> bool MappedVector<T>::empty() const {
+  return m_offsets.empty();
+}
+
+template<class T> uint64_t MappedVector<T>::size() const {
+  return m_offsets.size();
+}
+
+template<class T> typename MappedVector<T>::const_iterator MappedVector<T>::begin() {
+  return const_iterator(this, 0);
+}
+
+template<class T> typename MappedVector<T>::const_iterator MappedVector<T>::end() {
+  return const_iterator(this, m_offsets.size());
+}
+
+template<class T> const T& MappedVector<T>::operator[](uint64_t index) {
+  return *get(index);
+}
+
+template<class T> std::shared_ptr<const T> MappedVector<T>::get(uint64_t index) {
+  {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    auto cacheIter = m_cacheIndex.find(index);
+    if (cacheIter != m_cacheIndex.end()) {
+      size_t slot = cacheIter->second;
+      if (slot != m_cacheTail) {
+        unlinkSlot(slot);
+        linkSlotAsNewest(slot);
+      }
+
+      ++m_cacheHits;
+      return m_cache[slot].item;
+    }
+  }
+
+  if (index >= m_offsets.size()) {
+    throw std::runtime_error("MappedVector::operator[]");
+  }
+
+  // Deserialization runs outside of the cache lock, so concurrent readers only serialize on cache bookkeeping.
+  uint64_t itemOffset = m_offsets[static_cast<size_t>(index)];
+  uint64_t itemEnd = index + 1 < m_offsets.size() ? m_offsets[static_cast<size_t>(index + 1)] : m_itemsFileSize;
+  boost::iostreams::stream<boost::iostreams::array_source> itemStream(m_itemsFile.data() + itemOffset, static_cast<std::size_t>(itemEnd - itemOffset));
+  std::shared_ptr<T> item = std::make_shared<T>();
+  binary_archive<false> archive(itemStream);
+  if (!do_serialize(archive, *item)) {
+    throw std::runtime_error("MappedVector::operator[]");
+  }
+
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+  ++m_cacheMisses;
+  auto cacheIter = m_cacheIndex.find(index);
+  if (cacheIter != m_cacheIndex.end()) {
+    return m_cache[cacheIter->second].item;
+  }
+
+  prepare(index, item);
+  return item;
+}
+
+template<class T> const T& MappedVector<T>::front() {
+  return operator[](0);
+}
+
+template<class T> const T& MappedVector<T>::back() {
+  return operator[](m_offsets.size() - 1);
+}
+
+template<class T> void MappedVector<T>::clear() {
+  if (!m_opened) {
+    throw std::runtime_error("MappedVector::clear");
+  }
+
+  writeCount(0);
+  m_offsets.clear();
+  m_itemsFileSize = 0;
+  m_syncedItemsFileSize = 0;
+  m_syncedCount = 0;
+  resetCache();
+  m_indexesFile.flush(0, INDEX_HEADER_SIZE);
+}
+
+template<class T> void MappedVector<T>::pop_back() {
+  if (!m_opened || m_offsets.empty()) {
+    throw std::runtime_error("MappedVector::pop_back");
+  }
+
+  writeCount(m_offsets.size() - 1);
+  m_itemsFileSize = m_offsets.back();
+  m_offsets.pop_back();
+  m_syncedItemsFileSize = std::min(m_syncedItemsFileSize, m_itemsFileSize);
+  m_syncedCount = std::min<uint64_t>(m_syncedCount, m_offsets.size());
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+  evict(m_offsets.size());
+}
+
+template<class T> void MappedVector<T>::push_back(const T& item) {
+  if (!m_opened) {
+    throw std::runtime_error("MappedVector::push_back");
+  }
+
+  std::ostringstream itemStream;
+  binary_archive<true> archive(itemStream);
+  if (!do_serialize(archive, *const_cast<T*>(&item))) {
+    throw std::runtime_error("MappedVector::push_back");
+  }
+
+  std::string itemBlob = itemStream.str();
+  if (itemBlob.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("MappedVector::push_back");
+  }
+
+  uint64_t newCount = m_offsets.size() + 1;
+  m_itemsFile.reserve(m_itemsFileSize + itemBlob.size());
+  m_indexesFile.reserve(indexFileSize(newCount));
+
+  memcpy(m_itemsFile.data() + m_itemsFileSize, itemBlob.data(), itemBlob.size());
+  uint32_t itemSize = static_cast<uint32_t>(itemBlob.size());
+  memcpy(m_indexesFile.data() + indexFileSize(m_offsets.size()), &itemSize, sizeof itemSize);
+  writeCount(newCount);
+
+  m_offsets.push_back(m_itemsFileSize);
+  m_itemsFileSize += itemBlob.size();
+
+  if (m_offsets.size() - m_syncedCount >= m_syncBatch) {
+    flush();
+  }
+
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+  prepare(m_offsets.size() - 1, std::make_shared<T>(item));
+}
+
+template<class T> uint64_t MappedVector<T>::indexFileSize(uint64_t count) const {
+  return INDEX_HEADER_SIZE + count * sizeof(uint32_t);
+}
+
+template<class T> void MappedVector<T>::writeCount(uint64_t count) {
+  memcpy(m_indexesFile.data(), &count, sizeof count);
+}
+
+template<class T> void MappedVector<T>::resetCache() {
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+  m_cache.clear();
+  m_cacheIndex.clear();
+  m_cacheHead = NO_SLOT;
+  m_cacheTail = NO_SLOT;
+}
+
+template<class T> void MappedVector<T>::unlinkSlot(size_t slot) {
+  CacheSlot& entry = m_cache[slot];
+  if (entry.prev != NO_SLOT) {
+    m_cache[entry.prev].next = entry.next;
+  } else {
+    m_cacheHead = entry.next;
+  }
+
+  if (entry.next != NO_SLOT) {
+    m_cache[entry.next].prev = entry.prev;
+  } else {
+    m_cacheTail = entry.prev;
+  }
+}
+
+template<class T> void MappedVector<T>::linkSlotAsNewest(size_t slot) {
+  CacheSlot& entry = m_cache[slot];
+  entry.prev = m_cacheTail;
+  entry.next = NO_SLOT;
+  if (m_cacheTail != NO_SLOT) {
+    m_cache[m_cacheTail].next = slot;
+  } else {
+    m_cacheHead = slot;
+  }
+
+  m_cacheTail = slot;
+}
+
+template<class T> void MappedVector<T>::prepare(uint64_t index, const std::shared_ptr<const T>& item) {
+  size_t slot;
+  if (m_cache.size() < m_poolSize) {
+    if (m_cache.capacity() == 0) {
+      m_cache.reserve(m_poolSize);
+    }
+
+    slot = m_cache.size();
+    m_cache.emplace_back();
+  } else {
+    slot = m_cacheHead;
+    unlinkSlot(slot);
+    m_cacheIndex.erase(m_cache[slot].index);
+  }
+
+  m_cache[slot].index = index;
+  m_cache[slot].item = item;
+  linkSlotAsNewest(slot);
+  m_cacheIndex[index] = slot;
+}
+
+template<class T> void MappedVector<T>::evict(uint64_t index) {
+  auto cacheIter = m_cacheIndex.find(index);
+  if (cacheIter == m_cacheIndex.end()) {
+    return;
+  }
+
+  // The freed slot becomes the oldest one, so it is reused by the next miss.
+  size_t slot = cacheIter->second;
+  m_cacheIndex.erase(cacheIter);
+  unlinkSlot(slot);
+  m_cache[slot].item.reset();
+  m_cache[slot].index = std::numeric_limits<uint64_t>::max();
+  CacheSlot& entry = m_cache[slot];
+  entry.prev = NO_SLOT;
+  entry.next = m_cacheHead;
+  if (m_cacheHead != NO_SLOT) {
+    m_cache[m_cacheHead].prev = slot;
+  } else {
+    m_cacheTail = slot;
+  }
+
+  m_cacheHead = slot;
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "TransactionValidationCache.h"
+
+namespace cryptonote
+{
+  TransactionValidationCache::TransactionValidationCache(size_t capacity) : m_capacity(capacity) {
+  }
+
+  bool TransactionValidationCache::contains(const crypto::hash& transactionHash, const crypto::hash& maxUsedBlockId) const {
+    Key key = { transactionHash, maxUsedBlockId };
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_keys.count(key) != 0;
+  }
+
+  void TransactionValidationCache::add(const crypto::hash& transactionHash, const crypto::hash& maxUsedBlockId) {
+    Key key = { transactionHash, maxUsedBlockId };
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_capacity == 0 || !m_keys.insert(key).second) {
+      return;
+    }
+
+    m_order.push_back(key);
+    if (m_order.size() > m_capacity) {
+      m_keys.erase(m_order.front());
+      m_order.pop_front();
+    }
+  }
+
+  void TransactionValidationCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_keys.clear();
+    m_order.clear();
+  }
+
+  size_t TransactionValidationCache::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_keys.size();
+  }
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "common/FlatHashTable.h"
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  // Bounded set of transactions whose ring signatures were verified against the outputs of the chain ending at their
+  // max used block. Outputs up to that block can't change while the block stays in the main chain, so a transaction
+  // found here needs only its key images and unlock times to be checked again. The oldest entries are evicted first.
+  class TransactionValidationCache {
+
+  public:
+
+    explicit TransactionValidationCache(size_t capacity);
+
+    bool contains(const crypto::hash& transactionHash, const crypto::hash& maxUsedBlockId) const;
+    void add(const crypto::hash& transactionHash, const crypto::hash& maxUsedBlockId);
+    void clear();
+
+    size_t size() const;
+    size_t capacity() const { return m_capacity; }
+
+  private:
+
+    // a check holds only while the newest block the transaction inputs refer to stays in the blockchain
+    struct Key {
+      crypto::hash transactionHash;
+      crypto::hash maxUsedBlockId;
+    };
+
+    const size_t m_capacity;
+    mutable std::mutex m_mutex;
+    tools::FlatHashSet<Key> m_keys;
+    std::deque<Key> m_order;
+  };
+}
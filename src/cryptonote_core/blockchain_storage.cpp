@@ -19,10 +19,17 @@
 #include "blockchain_storage.h"
 
 #include <algorithm>
+#include <array>
 #include <cstdio>
+#include <deque>
+#include <future>
+#include <memory>
+#include <thread>
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/tss.hpp>
 
 // epee
 #include "file_io_utils.h"
@@ -31,9 +38,12 @@
 #include "time_helper.h"
 
 #include "common/boost_serialization_helper.h"
+#include "common/WorkerPool.h"
 #include "cryptonote_format_utils.h"
+#include "DecoySampler.h"
 #include "cryptonote_boost_serialization.h"
 #include "rpc/core_rpc_server_commands_defs.h"
+#include "serialization/binary_utils.h"
 
 
 //namespace {
@@ -49,6 +59,19 @@
 //}
 
 namespace {
+  const size_t LONG_HASH_MAX_WAYS = 4;
+
+  // Contexts for the interleaved long hashes of the calling thread. Their scratchpads are large and locked in memory,
+  // so they are allocated once per thread, on the NUMA node the thread runs on, and kept for the life of the thread.
+  crypto::cn_context* getLongHashContexts() {
+    static boost::thread_specific_ptr<std::array<crypto::cn_context, LONG_HASH_MAX_WAYS>> threadContexts;
+    if (threadContexts.get() == nullptr) {
+      threadContexts.reset(new std::array<crypto::cn_context, LONG_HASH_MAX_WAYS>());
+    }
+
+    return threadContexts->data();
+  }
+
   std::string appendPath(const std::string& path, const std::string& fileName) {
     std::string result = path;
     if (!result.empty()) {
@@ -58,6 +81,32 @@ namespace {
     result += fileName;
     return result;
   }
+
+  // Everything the index rebuild needs from a stored block, computed by worker threads
+  struct RebuiltOutput {
+    uint64_t amount;
+    uint16_t index;
+    bool multisignature;
+    crypto::public_key key;
+  };
+
+  struct RebuiltTransaction {
+    crypto::hash hash;
+    uint64_t unlockTime;
+    std::vector<crypto::key_image> keyImages;
+    std::vector<std::pair<uint64_t, uint32_t>> multisignatureInputs;
+    std::vector<RebuiltOutput> outputs;
+  };
+
+  struct RebuiltBlock {
+    crypto::hash hash;
+    uint64_t timestamp;
+    cryptonote::difficulty_type cumulativeDifficulty;
+    uint64_t cumulativeSize;
+    uint64_t generatedCoins;
+    uint8_t majorVersion;
+    std::vector<RebuiltTransaction> transactions;
+  };
 }
 
 namespace std {
@@ -128,6 +177,13 @@ template<class Archive> void cryptonote::blockchain_storage::TransactionIndex::s
   archive & transaction;
 }
 
+template<class Archive> void cryptonote::blockchain_storage::KeyOutput::serialize(Archive& archive, unsigned int version) {
+  archive & transactionIndex;
+  archive & outputIndex;
+  archive & key;
+  archive & unlockTime;
+}
+
 template<class Archive> void cryptonote::blockchain_storage::MultisignatureOutputUsage::serialize(Archive& archive, unsigned int version) {
   archive & transactionIndex;
   archive & outputIndex;
@@ -217,7 +273,7 @@ BOOST_CLASS_VERSION(cryptonote::blockchain_storage, CURRENT_BLOCKCHAIN_STORAGE_A
 namespace cryptonote
 {
 
-#define CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER 1
+#define CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER 4
 
   class BlockCacheSerializer {
 
@@ -231,24 +287,16 @@ namespace cryptonote
       if (version < CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER)
         return;
 
-      std::string operation;
-      if (Archive::is_loading::value) {
-        operation = "- loading ";
-        crypto::hash blockHash;
-        ar & blockHash;
-
-        if (blockHash != m_lastBlockHash) {
-          return;
-        }
-
-      } else {
-        operation = "- saving ";
-        ar & m_lastBlockHash;
-      }
+      // a cache of any height is loaded, the journal or the block storage bring it up to date afterwards
+      std::string operation = Archive::is_loading::value ? "- loading " : "- saving ";
+      ar & m_lastBlockHash;
 
       LOG_PRINT_L0(operation << "block index...");
       ar & m_bs.m_blockIndex;
 
+      LOG_PRINT_L0(operation << "block headers...");
+      ar & m_bs.m_blockHeaders;
+
       LOG_PRINT_L0(operation << "transaction map...");
       ar & m_bs.m_transactionMap;
 
@@ -268,6 +316,10 @@ namespace cryptonote
       return m_loaded;
     }
 
+    const crypto::hash& lastBlockHash() const {
+      return m_lastBlockHash;
+    }
+
   private:
 
     bool m_loaded;
@@ -285,11 +337,10 @@ blockchain_storage::blockchain_storage(const Currency& currency, tx_memory_pool&
       m_current_block_cumul_sz_limit(0),
       m_is_in_checkpoint_zone(false),
       m_is_blockchain_storing(false),
+      m_lastCacheSaveTime(0),
+      m_validationCache(TRANSACTION_VALIDATION_CACHE_SIZE),
       m_upgradeDetector(currency, m_blocks, BLOCK_MAJOR_VERSION_2) {
   m_outputs.set_deleted_key(0);
-
-  crypto::key_image nullImage = AUTO_VAL_INIT(nullImage);
-  m_spent_keys.set_deleted_key(nullImage);
 }
 
 bool blockchain_storage::checkTransactionInputs(const cryptonote::Transaction& tx, BlockInfo& maxUsedBlock) {
@@ -340,17 +391,17 @@ bool blockchain_storage::haveSpentKeyImages(const cryptonote::Transaction& tx) {
 }
 
 bool blockchain_storage::have_tx(const crypto::hash &id) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   return m_transactionMap.find(id) != m_transactionMap.end();
 }
 
 bool blockchain_storage::have_tx_keyimg_as_spent(const crypto::key_image &key_im) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   return  m_spent_keys.find(key_im) != m_spent_keys.end();
 }
 
 uint64_t blockchain_storage::get_current_blockchain_height() {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   return m_blocks.size();
 }
 
@@ -362,11 +413,15 @@ bool blockchain_storage::init(const std::string& config_folder, bool load_existi
   }
 
   m_config_folder = config_folder;
+  LOG_PRINT_L1("Proof of work scratchpad allocated with " << crypto::cn_context::allocation_mode_name(m_cn_context.get_allocation_mode()) <<
+    ", NUMA node " << m_cn_context.get_numa_node());
 
-  if (!m_blocks.open(appendPath(config_folder, m_currency.blocksFileName()), appendPath(config_folder, m_currency.blockIndexesFileName()), 1024)) {
+  if (!m_blocks.open(appendPath(config_folder, m_currency.blocksFileName()), appendPath(config_folder, m_currency.blockIndexesFileName()),
+      BLOCKS_CACHE_POOL_SIZE, BLOCKS_STORE_SYNC_BATCH)) {
     return false;
   }
 
+  crypto::hash savedCacheTailId = null_hash;
   if (load_existing) {
     LOG_PRINT_L0("Loading blockchain...");
 
@@ -376,43 +431,15 @@ bool blockchain_storage::init(const std::string& config_folder, bool load_existi
         LOG_PRINT_L0("Can't load blockchain storage from file.");
       }
     } else {
-      BlockCacheSerializer loader(*this, get_block_hash(m_blocks.back().bl));
+      BlockCacheSerializer loader(*this, null_hash);
       tools::unserialize_obj_from_file(loader, appendPath(config_folder, m_currency.blocksCacheFileName()));
+      if (loader.loaded()) {
+        savedCacheTailId = loader.lastBlockHash();
+      }
 
-      if (!loader.loaded()) {
+      if (!loader.loaded() || !replayCacheJournal()) {
         LOG_PRINT_L0("No actual blockchain cache found, rebuilding internal structures...");
-        std::chrono::steady_clock::time_point timePoint = std::chrono::steady_clock::now();
-        m_blockIndex.clear();
-        m_transactionMap.clear();
-        m_spent_keys.clear();
-        m_outputs.clear();
-        m_multisignatureOutputs.clear();
-        for (uint32_t b = 0; b < m_blocks.size(); ++b) {
-          if (b % 1000 == 0) {
-            std::cout << "Height " << b << " of " << m_blocks.size() << '\r';
-          }
-          const BlockEntry& block = m_blocks[b];
-          crypto::hash blockHash = get_block_hash(block.bl);
-          m_blockIndex.push(blockHash);
-          for (uint16_t t = 0; t < block.transactions.size(); ++t) {
-            const TransactionEntry& transaction = block.transactions[t];
-            crypto::hash transactionHash = get_transaction_hash(transaction.tx);
-            TransactionIndex transactionIndex = { b, t };
-            m_transactionMap.insert(std::make_pair(transactionHash, transactionIndex));
-            for (auto& i : transaction.tx.vin) {
-              if (i.type() == typeid(TransactionInputToKey)) {
-                m_spent_keys.insert(::boost::get<TransactionInputToKey>(i).keyImage);
-              }
-            }
-
-            for (uint16_t o = 0; o < transaction.tx.vout.size(); ++o) {
-              m_outputs[transaction.tx.vout[o].amount].push_back(std::make_pair<>(transactionIndex, o));
-            }
-          }
-        }
-
-        std::chrono::duration<double> duration = std::chrono::steady_clock::now() - timePoint;
-        LOG_PRINT_L0("Rebuilding internal structures took: " << duration.count());
+        rebuildCache();
       }
     }
   } else {
@@ -437,8 +464,20 @@ bool blockchain_storage::init(const std::string& config_folder, bool load_existi
 
   update_next_comulative_size_limit();
 
-  uint64_t timestamp_diff = time(NULL) - m_blocks.back().bl.timestamp;
-  if (!m_blocks.back().bl.timestamp) {
+  // the journal must always describe changes made since the saved cache, so the cache is saved again if it is behind
+  if (savedCacheTailId == m_blockIndex.getTailId()) {
+    if (!m_cacheJournal.reset(appendPath(m_config_folder, m_currency.blocksCacheJournalFileName()), savedCacheTailId)) {
+      LOG_ERROR("Failed to open blockchain cache journal");
+    }
+
+    m_lastCacheSaveTime = time(NULL);
+  } else {
+    storeCache();
+  }
+
+  uint64_t lastBlockTimestamp = m_blockHeaders.timestamp(m_blockHeaders.size() - 1);
+  uint64_t timestamp_diff = time(NULL) - lastBlockTimestamp;
+  if (!lastBlockTimestamp) {
     timestamp_diff = time(NULL) - 1341378000;
   }
 
@@ -446,21 +485,259 @@ bool blockchain_storage::init(const std::string& config_folder, bool load_existi
   return true;
 }
 
+void blockchain_storage::rebuildCache() {
+  m_blockIndex.clear();
+  m_blockHeaders.clear();
+  m_transactionMap.clear();
+  m_spent_keys.clear();
+  m_outputs.clear();
+  m_multisignatureOutputs.clear();
+  indexBlocks(0);
+}
+
+bool blockchain_storage::replayCacheJournal() {
+  if (m_blockHeaders.size() != m_blockIndex.size()) {
+    return false;
+  }
+
+  crypto::hash journalCacheTailId;
+  std::vector<BlockCacheJournal::Record> records;
+  if (!BlockCacheJournal::load(appendPath(m_config_folder, m_currency.blocksCacheJournalFileName()), journalCacheTailId, records) ||
+    journalCacheTailId != m_blockIndex.getTailId()) {
+    records.clear();
+  }
+
+  // Blocks of the saved chain, which were popped after the cache had been saved, are rolled back using their journaled copies.
+  // Pops of blocks pushed after the save are skipped, they never got to the saved indexes.
+  size_t rolledBackCount = 0;
+  for (const BlockCacheJournal::Record& record : records) {
+    if (record.type != BlockCacheJournal::BLOCK_POPPED || record.height >= m_blockIndex.size()) {
+      continue;
+    }
+
+    if (record.height + 1 != m_blockIndex.size() || record.blockHash != m_blockIndex.getTailId()) {
+      LOG_PRINT_L0("Blockchain cache journal doesn't match blockchain cache at height " << record.height);
+      return false;
+    }
+
+    BlockEntry block;
+    if (!::serialization::parse_binary(record.blockBlob, block)) {
+      LOG_PRINT_L0("Failed to parse block " << record.blockHash << " from blockchain cache journal");
+      return false;
+    }
+
+    popTransactions(block, get_transaction_hash(block.bl.minerTx));
+    m_blockIndex.pop();
+    m_blockHeaders.pop();
+    ++rolledBackCount;
+  }
+
+  uint64_t height = m_blockIndex.size();
+  if (height > m_blocks.size() || (height != 0 && get_block_hash(m_blocks.get(height - 1)->bl) != m_blockIndex.getTailId())) {
+    LOG_PRINT_L0("Blockchain cache doesn't match stored blocks at height " << height);
+    return false;
+  }
+
+  LOG_PRINT_L0("Blockchain cache is " << m_blocks.size() - height << " blocks behind, " << rolledBackCount << " blocks rolled back from " <<
+    records.size() << " journal records");
+  if (height < m_blocks.size()) {
+    indexBlocks(static_cast<uint32_t>(height));
+  }
+
+  return true;
+}
+
+void blockchain_storage::indexBlocks(uint32_t startHeight) {
+  std::chrono::steady_clock::time_point timePoint = std::chrono::steady_clock::now();
+  assert(m_blockIndex.size() == startHeight);
+
+  // Blocks are deserialized and hashed by batches in parallel, while this thread merges finished batches into the indexes in chain order
+  uint32_t blockCount = static_cast<uint32_t>(m_blocks.size());
+  m_blockIndex.reserve(blockCount);
+  auto rebuildBatch = [this, blockCount](uint32_t firstBlock) {
+    uint32_t lastBlock = std::min(blockCount, firstBlock + static_cast<uint32_t>(BLOCKS_REBUILD_BATCH_SIZE));
+    std::vector<RebuiltBlock> batch(lastBlock - firstBlock);
+    for (uint32_t b = firstBlock; b < lastBlock; ++b) {
+      std::shared_ptr<const BlockEntry> block = m_blocks.get(b);
+      RebuiltBlock& rebuilt = batch[b - firstBlock];
+      rebuilt.hash = get_block_hash(block->bl);
+      rebuilt.timestamp = block->bl.timestamp;
+      rebuilt.cumulativeDifficulty = block->cumulative_difficulty;
+      rebuilt.cumulativeSize = block->block_cumulative_size;
+      rebuilt.generatedCoins = block->already_generated_coins;
+      rebuilt.majorVersion = block->bl.majorVersion;
+      rebuilt.transactions.resize(block->transactions.size());
+      for (size_t t = 0; t < block->transactions.size(); ++t) {
+        const Transaction& tx = block->transactions[t].tx;
+        RebuiltTransaction& transaction = rebuilt.transactions[t];
+        transaction.hash = get_transaction_hash(tx);
+        transaction.unlockTime = tx.unlockTime;
+        for (const auto& input : tx.vin) {
+          if (input.type() == typeid(TransactionInputToKey)) {
+            transaction.keyImages.push_back(::boost::get<TransactionInputToKey>(input).keyImage);
+          } else if (input.type() == typeid(TransactionInputMultisignature)) {
+            const TransactionInputMultisignature& multisignatureInput = ::boost::get<TransactionInputMultisignature>(input);
+            transaction.multisignatureInputs.push_back(std::make_pair(multisignatureInput.amount, multisignatureInput.outputIndex));
+          }
+        }
+
+        for (uint16_t o = 0; o < tx.vout.size(); ++o) {
+          RebuiltOutput output = { tx.vout[o].amount, o, tx.vout[o].target.type() == typeid(TransactionOutputMultisignature) };
+          if (tx.vout[o].target.type() == typeid(TransactionOutputToKey)) {
+            output.key = ::boost::get<TransactionOutputToKey>(tx.vout[o].target).key;
+          }
+
+          transaction.outputs.push_back(output);
+        }
+      }
+    }
+
+    return batch;
+  };
+
+  tools::WorkerPool& workerPool = tools::WorkerPool::shared();
+  size_t threadCount = workerPool.threadCount();
+  std::deque<std::future<std::vector<RebuiltBlock>>> batches;
+  // the queued batches read the blocks, so they are waited for even if merging fails
+  epee::misc_utils::auto_scope_leave_caller batchesWait = epee::misc_utils::create_scope_leave_handler([&batches]() {
+    for (std::future<std::vector<RebuiltBlock>>& batch : batches) {
+      batch.wait();
+    }
+  });
+
+  uint32_t nextBatchBlock = startHeight;
+  uint64_t transactionCount = 0;
+  std::chrono::steady_clock::time_point reportTimePoint = timePoint;
+  uint32_t reportBlock = startHeight;
+  while (m_blockIndex.size() < blockCount) {
+    while (batches.size() < 2 * threadCount && nextBatchBlock < blockCount) {
+      auto batchTask = std::make_shared<std::packaged_task<std::vector<RebuiltBlock>()>>(std::bind(rebuildBatch, nextBatchBlock));
+      batches.push_back(batchTask->get_future());
+      workerPool.submit([batchTask] { (*batchTask)(); });
+      nextBatchBlock += static_cast<uint32_t>(BLOCKS_REBUILD_BATCH_SIZE);
+    }
+
+    std::vector<RebuiltBlock> batch = batches.front().get();
+    batches.pop_front();
+    for (const RebuiltBlock& block : batch) {
+      uint32_t b = static_cast<uint32_t>(m_blockIndex.size());
+      m_blockIndex.push(block.hash);
+      m_blockHeaders.push(block.timestamp, block.cumulativeDifficulty, block.cumulativeSize, block.generatedCoins, block.majorVersion);
+      for (uint16_t t = 0; t < block.transactions.size(); ++t) {
+        const RebuiltTransaction& transaction = block.transactions[t];
+        TransactionIndex transactionIndex = { b, t };
+        m_transactionMap.insert(std::make_pair(transaction.hash, transactionIndex));
+        for (const crypto::key_image& keyImage : transaction.keyImages) {
+          m_spent_keys.insert(keyImage);
+        }
+
+        for (const auto& input : transaction.multisignatureInputs) {
+          m_multisignatureOutputs[input.first][input.second].isUsed = true;
+        }
+
+        for (const RebuiltOutput& output : transaction.outputs) {
+          if (output.multisignature) {
+            MultisignatureOutputUsage outputUsage = { transactionIndex, output.index, false };
+            m_multisignatureOutputs[output.amount].push_back(outputUsage);
+          } else {
+            KeyOutput keyOutput = { transactionIndex, output.index, output.key, transaction.unlockTime };
+            m_outputs[output.amount].push_back(keyOutput);
+          }
+        }
+      }
+
+      transactionCount += block.transactions.size();
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> reportDuration = now - reportTimePoint;
+    if (reportDuration.count() >= 1) {
+      std::cout << "Height " << m_blockIndex.size() << " of " << blockCount << ", " <<
+        static_cast<uint64_t>((m_blockIndex.size() - reportBlock) / reportDuration.count()) << " blocks/s" << '\r';
+      reportTimePoint = now;
+      reportBlock = static_cast<uint32_t>(m_blockIndex.size());
+    }
+  }
+
+  std::cout << std::endl;
+  std::chrono::duration<double> duration = std::chrono::steady_clock::now() - timePoint;
+  LOG_PRINT_L0("Rebuilding internal structures took: " << duration.count() << " s, " << blockCount - startHeight << " blocks and " <<
+    transactionCount << " transactions with " << threadCount << " threads, " << static_cast<uint64_t>((blockCount - startHeight) / duration.count()) << " blocks/s");
+}
+
 bool blockchain_storage::storeCache() {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  // Blocks can't be added while the cache is written, but queries are served as usual
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
+  bool storing = false;
+  if (!m_is_blockchain_storing.compare_exchange_strong(storing, true)) {
+    LOG_PRINT_L0("Blockchain is already being saved");
+    return true;
+  }
 
+  epee::misc_utils::auto_scope_leave_caller storingFlagReset = epee::misc_utils::create_scope_leave_handler([this]() { m_is_blockchain_storing = false; });
+  return writeCache();
+}
+
+bool blockchain_storage::writeCache() {
   LOG_PRINT_L0("Saving blockchain...");
-  BlockCacheSerializer ser(*this, get_tail_id());
-  if (!tools::serialize_obj_to_file(ser, appendPath(m_config_folder, m_currency.blocksCacheFileName()))) {
+  m_blocks.flush();
+  crypto::hash tailId = get_tail_id();
+  BlockCacheSerializer ser(*this, tailId);
+  std::string cacheFileName = appendPath(m_config_folder, m_currency.blocksCacheFileName());
+  std::string temporaryCacheFileName = cacheFileName + ".tmp";
+  if (!tools::serialize_obj_to_file(ser, temporaryCacheFileName)) {
     LOG_ERROR("Failed to save blockchain cache");
     return false;
   }
 
+  // the old cache stays valid together with its journal until it is replaced at once
+  boost::system::error_code ec;
+  boost::filesystem::rename(temporaryCacheFileName, cacheFileName, ec);
+  if (ec) {
+    LOG_ERROR("Failed to replace blockchain cache: " << ec.message());
+    return false;
+  }
+
+  if (!m_cacheJournal.reset(appendPath(m_config_folder, m_currency.blocksCacheJournalFileName()), tailId)) {
+    LOG_ERROR("Failed to open blockchain cache journal");
+  }
+
+  m_lastCacheSaveTime = time(NULL);
   return true;
 }
 
+void blockchain_storage::on_idle() {
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
+  bool storing = false;
+  if (!m_is_blockchain_storing.compare_exchange_strong(storing, true)) {
+    return;
+  }
+
+  // the journal is only reset by a cache write, so it can be inspected once no other save is running
+  epee::misc_utils::auto_scope_leave_caller storingFlagReset = epee::misc_utils::create_scope_leave_handler([this]() { m_is_blockchain_storing = false; });
+  if (m_cacheJournal.recordCount() >= BLOCKS_CACHE_CHECKPOINT_RECORDS && time(NULL) >= m_lastCacheSaveTime + static_cast<time_t>(BLOCKS_CACHE_CHECKPOINT_MIN_PERIOD)) {
+    writeCache();
+  }
+}
+
+void blockchain_storage::journalBlock(BlockCacheJournal::RecordType type, const BlockEntry& block, const crypto::hash& blockHash) {
+  if (!m_cacheJournal.isOpen()) {
+    return;
+  }
+
+  BlockCacheJournal::Record record = { type, block.height, blockHash, std::string() };
+  if (type == BlockCacheJournal::BLOCK_POPPED) {
+    ::serialization::dump_binary(const_cast<BlockEntry&>(block), record.blockBlob);
+  }
+
+  if (!m_cacheJournal.append(record)) {
+    LOG_ERROR("Failed to write blockchain cache journal, blockchain cache will be rebuilt after a crash");
+  }
+}
+
 bool blockchain_storage::deinit() {
   storeCache();
+  m_cacheJournal.close();
   return true;
 }
 
@@ -468,6 +745,7 @@ bool blockchain_storage::reset_and_set_genesis_block(const Block& b) {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   m_blocks.clear();
   m_blockIndex.clear();
+  m_blockHeaders.clear();
   m_transactionMap.clear();
 
   m_spent_keys.clear();
@@ -480,33 +758,33 @@ bool blockchain_storage::reset_and_set_genesis_block(const Block& b) {
 }
 
 crypto::hash blockchain_storage::get_tail_id(uint64_t& height) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   height = get_current_blockchain_height() - 1;
   return get_tail_id();
 }
 
 crypto::hash blockchain_storage::get_tail_id() {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   return m_blockIndex.getTailId();
 }
 
 bool blockchain_storage::get_short_chain_history(std::list<crypto::hash>& ids) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   return m_blockIndex.getShortChainHistory(ids);
 }
 
 crypto::hash blockchain_storage::get_block_id_by_height(uint64_t height) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   return m_blockIndex.getBlockId(height);
 }
 
 bool blockchain_storage::get_block_by_hash(const crypto::hash& blockHash, Block& b) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
 
   uint64_t height = 0;
 
   if (m_blockIndex.getBlockHeight(blockHash, height)) {
-    b = m_blocks[height].bl;
+    b = m_blocks.get(height)->bl;
     return true;
   }
 
@@ -520,7 +798,7 @@ bool blockchain_storage::get_block_by_hash(const crypto::hash& blockHash, Block&
 }
 
 difficulty_type blockchain_storage::get_difficulty_for_next_block() {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   std::vector<uint64_t> timestamps;
   std::vector<difficulty_type> commulative_difficulties;
   size_t offset = m_blocks.size() - std::min(m_blocks.size(), static_cast<uint64_t>(m_currency.difficultyBlocksCount()));
@@ -529,19 +807,19 @@ difficulty_type blockchain_storage::get_difficulty_for_next_block() {
   }
 
   for (; offset < m_blocks.size(); offset++) {
-    timestamps.push_back(m_blocks[offset].bl.timestamp);
-    commulative_difficulties.push_back(m_blocks[offset].cumulative_difficulty);
+    timestamps.push_back(m_blockHeaders.timestamp(offset));
+    commulative_difficulties.push_back(m_blockHeaders.cumulativeDifficulty(offset));
   }
 
   return m_currency.nextDifficulty(timestamps, commulative_difficulties);
 }
 
 uint64_t blockchain_storage::getCoinsInCirculation() {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   if (m_blocks.empty()) {
     return 0;
   } else {
-    return m_blocks.back().already_generated_coins;
+    return m_blockHeaders.generatedCoins(m_blockHeaders.size() - 1);
   }
 }
 
@@ -554,7 +832,7 @@ bool blockchain_storage::rollback_blockchain_switching(std::list<Block>& origina
   //remove failed subchain
   for (size_t i = m_blocks.size() - 1; i >= rollback_height; i--)
   {
-    popBlock(get_block_hash(m_blocks.back().bl));
+    popBlock(m_blockIndex.getTailId());
     //bool r = pop_block_from_blockchain();
     //CHECK_AND_ASSERT_MES(r, false, "PANIC!!! failed to remove block while chain switching during the rollback!");
   }
@@ -643,8 +921,8 @@ difficulty_type blockchain_storage::get_next_difficulty_for_alternative_chain(co
     if (!main_chain_start_offset)
       ++main_chain_start_offset; //skip genesis block
     for (; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset) {
-      timestamps.push_back(m_blocks[main_chain_start_offset].bl.timestamp);
-      commulative_difficulties.push_back(m_blocks[main_chain_start_offset].cumulative_difficulty);
+      timestamps.push_back(m_blockHeaders.timestamp(main_chain_start_offset));
+      commulative_difficulties.push_back(m_blockHeaders.cumulativeDifficulty(main_chain_start_offset));
     }
 
     CHECK_AND_ASSERT_MES((alt_chain.size() + timestamps.size()) <= m_currency.difficultyBlocksCount(), false,
@@ -726,18 +1004,18 @@ bool blockchain_storage::validate_miner_transaction(const Block& b, uint64_t hei
 }
 
 bool blockchain_storage::get_backward_blocks_sizes(size_t from_height, std::vector<size_t>& sz, size_t count) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   CHECK_AND_ASSERT_MES(from_height < m_blocks.size(), false, "Internal error: get_backward_blocks_sizes called with from_height=" << from_height << ", blockchain height = " << m_blocks.size());
   size_t start_offset = (from_height + 1) - std::min((from_height + 1), count);
   for (size_t i = start_offset; i != from_height + 1; i++) {
-    sz.push_back(m_blocks[i].block_cumulative_size);
+    sz.push_back(m_blockHeaders.cumulativeSize(i));
   }
 
   return true;
 }
 
 bool blockchain_storage::get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   if (!m_blocks.size()) {
     return true;
   }
@@ -753,7 +1031,7 @@ bool blockchain_storage::create_block_template(Block& b, const AccountPublicAddr
   size_t median_size;
   uint64_t already_generated_coins;
 
-  CRITICAL_REGION_BEGIN(m_blockchain_lock);
+  SHARED_LOCK_REGION_BEGIN(m_blockchain_lock);
   height = m_blocks.size();
   diffic = get_difficulty_for_next_block();
   CHECK_AND_ASSERT_MES(diffic, false, "difficulty overhead.");
@@ -778,7 +1056,7 @@ bool blockchain_storage::create_block_template(Block& b, const AccountPublicAddr
   b.timestamp = time(NULL);
 
   median_size = m_current_block_cumul_sz_limit / 2;
-  already_generated_coins = m_blocks.back().already_generated_coins;
+  already_generated_coins = m_blockHeaders.generatedCoins(height - 1);
 
   CRITICAL_REGION_END();
 
@@ -890,13 +1168,13 @@ bool blockchain_storage::complete_timestamps_vector(uint64_t start_top_height, s
   if (timestamps.size() >= m_currency.timestampCheckWindow())
     return true;
 
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   size_t need_elements = m_currency.timestampCheckWindow() - timestamps.size();
   CHECK_AND_ASSERT_MES(start_top_height < m_blocks.size(), false, "internal error: passed start_height = " << start_top_height << " not less then m_blocks.size()=" << m_blocks.size());
   size_t stop_offset = start_top_height > need_elements ? start_top_height - need_elements : 0;
   do
   {
-    timestamps.push_back(m_blocks[start_top_height].bl.timestamp);
+    timestamps.push_back(m_blockHeaders.timestamp(start_top_height));
     if (start_top_height == 0)
       break;
     --start_top_height;
@@ -964,8 +1242,7 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
     if (alt_chain.size()) {
       //make sure that it has right connection to main chain
       CHECK_AND_ASSERT_MES(m_blocks.size() > alt_chain.front()->second.height, false, "main blockchain wrong height");
-      crypto::hash h = null_hash;
-      get_block_hash(m_blocks[alt_chain.front()->second.height - 1].bl, h);
+      crypto::hash h = m_blockIndex.getBlockId(alt_chain.front()->second.height - 1);
       CHECK_AND_ASSERT_MES(h == alt_chain.front()->second.bl.prevId, false, "alternative chain have wrong connection to main chain");
       complete_timestamps_vector(alt_chain.front()->second.height - 1, timestamps);
     } else {
@@ -1012,7 +1289,7 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
       return false;
     }
 
-    bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blocks[mainPrevHeight].cumulative_difficulty;
+    bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blockHeaders.cumulativeDifficulty(mainPrevHeight);
     bei.cumulative_difficulty += current_diff;
 
 #ifdef _DEBUG
@@ -1032,10 +1309,10 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
       if (r) bvc.m_added_to_main_chain = true;
       else bvc.m_verifivation_failed = true;
       return r;
-    } else if (m_blocks.back().cumulative_difficulty < bei.cumulative_difficulty) //check if difficulty bigger then in main chain
+    } else if (m_blockHeaders.cumulativeDifficulty(m_blockHeaders.size() - 1) < bei.cumulative_difficulty) //check if difficulty bigger then in main chain
     {
       //do reorganize!
-      LOG_PRINT_GREEN("###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cum_difficulty " << m_blocks.back().cumulative_difficulty
+      LOG_PRINT_GREEN("###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cum_difficulty " << m_blockHeaders.cumulativeDifficulty(m_blockHeaders.size() - 1)
         << ENDL << " alternative blockchain size: " << alt_chain.size() << " with cum_difficulty " << bei.cumulative_difficulty, LOG_LEVEL_0);
       bool r = switch_to_alternative_blockchain(alt_chain, false);
       if (r) bvc.m_added_to_main_chain = true;
@@ -1058,14 +1335,15 @@ bool blockchain_storage::handle_alternative_block(const Block& b, const crypto::
 }
 
 bool blockchain_storage::get_blocks(uint64_t start_offset, size_t count, std::list<Block>& blocks, std::list<Transaction>& txs) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   if (start_offset >= m_blocks.size())
     return false;
   for (size_t i = start_offset; i < start_offset + count && i < m_blocks.size(); i++)
   {
-    blocks.push_back(m_blocks[i].bl);
+    std::shared_ptr<const BlockEntry> block = m_blocks.get(i);
+    blocks.push_back(block->bl);
     std::list<crypto::hash> missed_ids;
-    get_transactions(m_blocks[i].bl.txHashes, txs, missed_ids);
+    get_transactions(block->bl.txHashes, txs, missed_ids);
     CHECK_AND_ASSERT_MES(!missed_ids.size(), false, "have missed transactions in own block in main blockchain");
   }
 
@@ -1073,20 +1351,20 @@ bool blockchain_storage::get_blocks(uint64_t start_offset, size_t count, std::li
 }
 
 bool blockchain_storage::get_blocks(uint64_t start_offset, size_t count, std::list<Block>& blocks) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   if (start_offset >= m_blocks.size()) {
     return false;
   }
 
   for (size_t i = start_offset; i < start_offset + count && i < m_blocks.size(); i++) {
-    blocks.push_back(m_blocks[i].bl);
+    blocks.push_back(m_blocks.get(i)->bl);
   }
 
   return true;
 }
 
 bool blockchain_storage::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   rsp.current_blockchain_height = get_current_blockchain_height();
   std::list<Block> blocks;
   get_blocks(arg.blocks, blocks, rsp.missed_ids);
@@ -1117,8 +1395,19 @@ bool blockchain_storage::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request&
   return true;
 }
 
+bool blockchain_storage::handle_get_block_headers(const NOTIFY_REQUEST_BLOCK_HEADERS::request& arg, NOTIFY_RESPONSE_BLOCK_HEADERS::request& rsp) {
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
+  std::list<Block> blocks;
+  get_blocks(arg.blocks, blocks, rsp.missed_ids);
+  for (const auto& bl : blocks) {
+    rsp.headers.push_back(t_serializable_object_to_blob(get_block_short_header(bl)));
+  }
+
+  return true;
+}
+
 bool blockchain_storage::get_alternative_blocks(std::list<Block>& blocks) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   for (auto& alt_bl : m_alternative_chains) {
     blocks.push_back(alt_bl.second.bl);
   }
@@ -1127,47 +1416,35 @@ bool blockchain_storage::get_alternative_blocks(std::list<Block>& blocks) {
 }
 
 size_t blockchain_storage::get_alternative_blocks_count() {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   return m_alternative_chains.size();
 }
 
-bool blockchain_storage::add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  const Transaction& tx = transactionByIndex(amount_outs[i].first).tx;
-  CHECK_AND_ASSERT_MES(tx.vout.size() > amount_outs[i].second, false, "internal error: in global outs index, transaction out index="
-    << amount_outs[i].second << " more than transaction outputs = " << tx.vout.size() << ", for tx id = " << get_transaction_hash(tx));
-  CHECK_AND_ASSERT_MES(tx.vout[amount_outs[i].second].target.type() == typeid(TransactionOutputToKey), false, "unknown tx out type");
-
+bool blockchain_storage::add_out_to_get_random_outs(const std::vector<KeyOutput>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i) {
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   //check if transaction is unlocked
-  if (!is_tx_spendtime_unlocked(tx.unlockTime))
+  if (!is_tx_spendtime_unlocked(amount_outs[i].unlockTime))
     return false;
 
   COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry& oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
   oen.global_amount_index = i;
-  oen.out_key = boost::get<TransactionOutputToKey>(tx.vout[amount_outs[i].second].target).key;
+  oen.out_key = amount_outs[i].key;
   return true;
 }
 
-size_t blockchain_storage::find_end_of_allowed_index(const std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  if (amount_outs.empty()) {
-    return 0;
-  }
-
-  size_t i = amount_outs.size();
-  do {
-    --i;
-    if (amount_outs[i].first.block + m_currency.minedMoneyUnlockWindow() <= get_current_blockchain_height()) {
-      return i + 1;
-    }
-  } while (i != 0);
+size_t blockchain_storage::find_end_of_allowed_index(const std::vector<KeyOutput>& amount_outs) {
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
+  // outputs are kept in chain order, so the ones mined deep enough form a prefix
+  uint64_t height = get_current_blockchain_height();
+  auto end = std::partition_point(amount_outs.begin(), amount_outs.end(), [this, height](const KeyOutput& output) {
+    return output.transactionIndex.block + m_currency.minedMoneyUnlockWindow() <= height;
+  });
 
-  return 0;
+  return end - amount_outs.begin();
 }
 
 bool blockchain_storage::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
-  srand(static_cast<unsigned int>(time(NULL)));
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   for (uint64_t amount : req.amounts) {
     COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs = *res.outs.insert(res.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount());
     result_outs.amount = amount;
@@ -1177,23 +1454,17 @@ bool blockchain_storage::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDO
       continue;//actually this is strange situation, wallet should use some real outs when it lookup for some mix, so, at least one out for this amount should exist
     }
 
-    std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs = it->second;
+    const std::vector<KeyOutput>& amount_outs = it->second;
     //it is not good idea to use top fresh outs, because it increases possibility of transaction canceling on split
     //lets find upper bound of not fresh outs
     size_t up_index_limit = find_end_of_allowed_index(amount_outs);
     CHECK_AND_ASSERT_MES(up_index_limit <= amount_outs.size(), false, "internal error: find_end_of_allowed_index returned wrong index=" << up_index_limit << ", with amount_outs.size = " << amount_outs.size());
     if (amount_outs.size() > req.outs_count) {
-      std::set<size_t> used;
-      size_t try_count = 0;
-      for (uint64_t j = 0; j != req.outs_count && try_count < up_index_limit;) {
-        size_t i = rand() % up_index_limit;
-        if (used.count(i))
-          continue;
-        bool added = add_out_to_get_random_outs(amount_outs, result_outs, amount, i);
-        used.insert(i);
-        if (added)
+      // every allowed output is drawn at most once, outputs of still locked transactions are skipped
+      DecoySampler sampler(up_index_limit);
+      for (uint64_t j = 0; j != req.outs_count && !sampler.empty();) {
+        if (add_out_to_get_random_outs(amount_outs, result_outs, amount, sampler.next()))
           ++j;
-        ++try_count;
       }
     } else {
       for (size_t i = 0; i != up_index_limit; i++) {
@@ -1206,7 +1477,7 @@ bool blockchain_storage::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDO
 
 bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset)
 {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
 
   if (!qblock_ids.size() /*|| !req.m_total_height*/)
   {
@@ -1214,10 +1485,11 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
     return false;
   }
   //check genesis match
-  if (qblock_ids.back() != get_block_hash(m_blocks[0].bl))
+  crypto::hash genesisBlockHash = m_blockIndex.getBlockId(0);
+  if (qblock_ids.back() != genesisBlockHash)
   {
     LOG_ERROR("Client sent wrong NOTIFY_REQUEST_CHAIN: genesis block missmatch: " << ENDL << "id: "
-      << qblock_ids.back() << ", " << ENDL << "expected: " << get_block_hash(m_blocks[0].bl)
+      << qblock_ids.back() << ", " << ENDL << "expected: " << genesisBlockHash
       << "," << ENDL << " dropping connection");
     return false;
   }
@@ -1234,18 +1506,18 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
 
 uint64_t blockchain_storage::block_difficulty(size_t i)
 {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   CHECK_AND_ASSERT_MES(i < m_blocks.size(), false, "wrong block index i = " << i << " at blockchain_storage::block_difficulty()");
   if (i == 0)
-    return m_blocks[i].cumulative_difficulty;
+    return m_blockHeaders.cumulativeDifficulty(i);
 
-  return m_blocks[i].cumulative_difficulty - m_blocks[i - 1].cumulative_difficulty;
+  return m_blockHeaders.cumulativeDifficulty(i) - m_blockHeaders.cumulativeDifficulty(i - 1);
 }
 
 void blockchain_storage::print_blockchain(uint64_t start_index, uint64_t end_index)
 {
   std::stringstream ss;
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   if (start_index >= m_blocks.size())
   {
     LOG_PRINT_L0("Wrong starter index set: " << start_index << ", expected max index " << m_blocks.size() - 1);
@@ -1254,9 +1526,10 @@ void blockchain_storage::print_blockchain(uint64_t start_index, uint64_t end_ind
 
   for (size_t i = start_index; i != m_blocks.size() && i != end_index; i++)
   {
-    ss << "height " << i << ", timestamp " << m_blocks[i].bl.timestamp << ", cumul_dif " << m_blocks[i].cumulative_difficulty << ", cumul_size " << m_blocks[i].block_cumulative_size
-      << "\nid\t\t" << get_block_hash(m_blocks[i].bl)
-      << "\ndifficulty\t\t" << block_difficulty(i) << ", nonce " << m_blocks[i].bl.nonce << ", tx_count " << m_blocks[i].bl.txHashes.size() << ENDL;
+    std::shared_ptr<const BlockEntry> block = m_blocks.get(i);
+    ss << "height " << i << ", timestamp " << block->bl.timestamp << ", cumul_dif " << block->cumulative_difficulty << ", cumul_size " << block->block_cumulative_size
+      << "\nid\t\t" << get_block_hash(block->bl)
+      << "\ndifficulty\t\t" << block_difficulty(i) << ", nonce " << block->bl.nonce << ", tx_count " << block->bl.txHashes.size() << ENDL;
   }
   LOG_PRINT_L1("Current blockchain:" << ENDL << ss.str());
   LOG_PRINT_L0("Blockchain printed with log level 1");
@@ -1264,7 +1537,7 @@ void blockchain_storage::print_blockchain(uint64_t start_index, uint64_t end_ind
 
 void blockchain_storage::print_blockchain_index() {
   std::stringstream ss;
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
 
   std::list<crypto::hash> blockIds;
   m_blockIndex.getBlockIds(0, std::numeric_limits<size_t>::max(), blockIds);
@@ -1280,13 +1553,13 @@ void blockchain_storage::print_blockchain_index() {
 
 void blockchain_storage::print_blockchain_outs(const std::string& file) {
   std::stringstream ss;
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   for (const outputs_container::value_type& v : m_outputs) {
-    const std::vector<std::pair<TransactionIndex, uint16_t>>& vals = v.second;
+    const std::vector<KeyOutput>& vals = v.second;
     if (!vals.empty()) {
       ss << "amount: " << v.first << ENDL;
       for (size_t i = 0; i != vals.size(); i++) {
-        ss << "\t" << get_transaction_hash(transactionByIndex(vals[i].first).tx) << ": " << vals[i].second << ENDL;
+        ss << "\t" << get_transaction_hash(transactionByIndex(vals[i].transactionIndex)->tx) << ": " << vals[i].outputIndex << ENDL;
       }
     }
   }
@@ -1299,7 +1572,7 @@ void blockchain_storage::print_blockchain_outs(const std::string& file) {
 }
 
 bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   if (!find_blockchain_supplement(qblock_ids, resp.start_height))
     return false;
 
@@ -1310,7 +1583,7 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
 }
 
 bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<Block, std::list<Transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   if (!find_blockchain_supplement(qblock_ids, start_height)) {
     return false;
   }
@@ -1319,9 +1592,10 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
   size_t count = 0;
   for (size_t i = start_height; i != m_blocks.size() && count < max_count; i++, count++) {
     blocks.resize(blocks.size() + 1);
-    blocks.back().first = m_blocks[i].bl;
+    std::shared_ptr<const BlockEntry> block = m_blocks.get(i);
+    blocks.back().first = block->bl;
     std::list<crypto::hash> mis;
-    get_transactions(m_blocks[i].bl.txHashes, blocks.back().second, mis);
+    get_transactions(block->bl.txHashes, blocks.back().second, mis);
     CHECK_AND_ASSERT_MES(!mis.size(), false, "internal error, transaction from block not found");
   }
 
@@ -1330,7 +1604,7 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
 
 bool blockchain_storage::have_block(const crypto::hash& id)
 {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   if (m_blockIndex.hasBlock(id))
     return true;
 
@@ -1341,38 +1615,53 @@ bool blockchain_storage::have_block(const crypto::hash& id)
 }
 
 size_t blockchain_storage::get_total_transactions() {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   return m_transactionMap.size();
 }
 
 bool blockchain_storage::get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   auto it = m_transactionMap.find(tx_id);
   if (it == m_transactionMap.end()) {
     LOG_PRINT_RED_L0("warning: get_tx_outputs_gindexs failed to find transaction with id = " << tx_id);
     return false;
   }
 
-  const TransactionEntry& tx = transactionByIndex(it->second);
-  CHECK_AND_ASSERT_MES(tx.m_global_output_indexes.size(), false, "internal error: global indexes for transaction " << tx_id << " is empty");
-  indexs.resize(tx.m_global_output_indexes.size());
-  for (size_t i = 0; i < tx.m_global_output_indexes.size(); ++i) {
-    indexs[i] = tx.m_global_output_indexes[i];
+  std::shared_ptr<const TransactionEntry> tx = transactionByIndex(it->second);
+  CHECK_AND_ASSERT_MES(tx->m_global_output_indexes.size(), false, "internal error: global indexes for transaction " << tx_id << " is empty");
+  indexs.resize(tx->m_global_output_indexes.size());
+  for (size_t i = 0; i < tx->m_global_output_indexes.size(); ++i) {
+    indexs[i] = tx->m_global_output_indexes[i];
   }
 
   return true;
 }
 
 bool blockchain_storage::check_tx_inputs(const Transaction& tx, uint64_t& max_used_block_height, crypto::hash& max_used_block_id, BlockInfo* tail) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
 
   if (tail)
     tail->id = get_tail_id(tail->height);
 
-  bool res = check_tx_inputs(tx, &max_used_block_height);
+  std::vector<RingSignatureCheck> ringSignatureChecks;
+  bool res = check_tx_inputs(tx, get_transaction_prefix_hash(tx), &max_used_block_height, &ringSignatureChecks);
   if (!res) return false;
   CHECK_AND_ASSERT_MES(max_used_block_height < m_blocks.size(), false, "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_blocks.size());
-  get_block_hash(m_blocks[max_used_block_height].bl, max_used_block_id);
+  max_used_block_id = m_blockIndex.getBlockId(max_used_block_height);
+
+  // signatures verified against the same outputs before are not verified again
+  crypto::hash transactionHash = get_transaction_hash(tx);
+  if (m_is_in_checkpoint_zone || m_validationCache.contains(transactionHash, max_used_block_id)) {
+    return true;
+  }
+
+  size_t failedCheck;
+  if (!checkRingSignatures(ringSignatureChecks, failedCheck)) {
+    LOG_PRINT_L0("Failed to check ring signature for tx " << transactionHash);
+    return false;
+  }
+
+  m_validationCache.add(transactionHash, max_used_block_id);
   return true;
 }
 
@@ -1393,7 +1682,7 @@ bool blockchain_storage::check_tx_inputs(const Transaction& tx, uint64_t* pmax_u
   return check_tx_inputs(tx, tx_prefix_hash, pmax_used_block_height);
 }
 
-bool blockchain_storage::check_tx_inputs(const Transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height) {
+bool blockchain_storage::check_tx_inputs(const Transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height, std::vector<RingSignatureCheck>* deferredChecks) {
   size_t inputIndex = 0;
   if (pmax_used_block_height) {
     *pmax_used_block_height = 0;
@@ -1411,7 +1700,7 @@ bool blockchain_storage::check_tx_inputs(const Transaction& tx, const crypto::ha
         return false;
       }
 
-      if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height)) {
+      if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height, deferredChecks)) {
         LOG_PRINT_L0("Failed to check ring signature for tx " << transactionHash);
         return false;
       }
@@ -1451,35 +1740,29 @@ bool blockchain_storage::is_tx_spendtime_unlocked(uint64_t unlock_time) {
   return false;
 }
 
-bool blockchain_storage::check_tx_input(const TransactionInputToKey& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+bool blockchain_storage::check_tx_input(const TransactionInputToKey& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height, std::vector<RingSignatureCheck>* deferredChecks) {
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
 
   struct outputs_visitor
   {
-    std::vector<const crypto::public_key *>& m_results_collector;
+    std::vector<crypto::public_key>& m_results_collector;
     blockchain_storage& m_bch;
-    outputs_visitor(std::vector<const crypto::public_key *>& results_collector, blockchain_storage& bch) :m_results_collector(results_collector), m_bch(bch)
+    outputs_visitor(std::vector<crypto::public_key>& results_collector, blockchain_storage& bch) :m_results_collector(results_collector), m_bch(bch)
     {}
-    bool handle_output(const Transaction& tx, const TransactionOutput& out) {
+    bool handle_output(const KeyOutput& output) {
       //check tx unlock time
-      if (!m_bch.is_tx_spendtime_unlocked(tx.unlockTime)) {
-        LOG_PRINT_L0("One of outputs for one of inputs have wrong tx.unlockTime = " << tx.unlockTime);
+      if (!m_bch.is_tx_spendtime_unlocked(output.unlockTime)) {
+        LOG_PRINT_L0("One of outputs for one of inputs have wrong tx.unlockTime = " << output.unlockTime);
         return false;
       }
 
-      if (out.target.type() != typeid(TransactionOutputToKey))
-      {
-        LOG_PRINT_L0("Output have wrong type id, which=" << out.target.which());
-        return false;
-      }
-
-      m_results_collector.push_back(&boost::get<TransactionOutputToKey>(out.target).key);
+      m_results_collector.push_back(output.key);
       return true;
     }
   };
 
   //check ring signature
-  std::vector<const crypto::public_key *> output_keys;
+  std::vector<crypto::public_key> output_keys;
   outputs_visitor vi(output_keys, *this);
   if (!scan_outputkeys_for_indexes(txin, vi, pmax_related_block_height)) {
     LOG_PRINT_L0("Failed to get output keys for tx with amount = " << m_currency.formatAmount(txin.amount) <<
@@ -1497,7 +1780,280 @@ bool blockchain_storage::check_tx_input(const TransactionInputToKey& txin, const
     return true;
   }
 
-  return crypto::check_ring_signature(tx_prefix_hash, txin.keyImage, output_keys, sig.data());
+  if (deferredChecks) {
+    RingSignatureCheck check = { tx_prefix_hash, txin.keyImage, std::move(output_keys), sig, 0 };
+    deferredChecks->push_back(std::move(check));
+    return true;
+  }
+
+  std::vector<const crypto::public_key *> output_key_pointers;
+  output_key_pointers.reserve(output_keys.size());
+  for (const crypto::public_key& key : output_keys) {
+    output_key_pointers.push_back(&key);
+  }
+
+  return crypto::check_ring_signature(tx_prefix_hash, txin.keyImage, output_key_pointers, sig.data());
+}
+
+bool blockchain_storage::checkRingSignatures(const std::vector<RingSignatureCheck>& checks, size_t& failedCheck) {
+  // Checks are split into contiguous ranges, one per core, verified by the shared workers and the calling thread.
+  // Each range returns the index of its first invalid signature, or checks.size() if all of them are valid.
+  auto checkRange = [&checks](size_t begin, size_t end) {
+    std::vector<const crypto::public_key*> outputKeyPointers;
+    for (size_t i = begin; i < end; ++i) {
+      const RingSignatureCheck& check = checks[i];
+      outputKeyPointers.clear();
+      for (const crypto::public_key& key : check.outputKeys) {
+        outputKeyPointers.push_back(&key);
+      }
+
+      if (!crypto::check_ring_signature(check.prefixHash, check.keyImage, outputKeyPointers, check.signatures.data())) {
+        return i;
+      }
+    }
+
+    return checks.size();
+  };
+
+  size_t rangeCount = std::max<size_t>(1, std::min<size_t>(checks.size(), std::thread::hardware_concurrency()));
+  std::vector<size_t> failedChecks(rangeCount);
+  tools::WorkerPool::shared().run(rangeCount, [&](size_t range) {
+    failedChecks[range] = checkRange(checks.size() * range / rangeCount, checks.size() * (range + 1) / rangeCount);
+  });
+
+  failedCheck = *std::min_element(failedChecks.begin(), failedChecks.end());
+  return failedCheck == checks.size();
+}
+
+void blockchain_storage::precomputeLongHashes(const std::vector<Block>& blocks, uint64_t height) {
+  // blocks in the checkpoint zone are checked against the checkpoints instead
+  std::vector<blobdata> blobs;
+  std::vector<crypto::hash> blobHashes;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    if (m_checkpoints.is_in_checkpoint_zone(height + i)) {
+      continue;
+    }
+
+    blobdata blob;
+    size_t nonceOffset;
+    if (get_block_longhash_blob(blocks[i], blob, nonceOffset)) {
+      // the hashes of blocks whose headers were checked are already there
+      crypto::hash blobHash = crypto::cn_fast_hash(blob.data(), blob.size());
+      crypto::hash longHash;
+      if (!findPrecomputedLongHash(blobHash, longHash)) {
+        blobHashes.push_back(blobHash);
+        blobs.push_back(std::move(blob));
+      }
+    }
+  }
+
+  if (blobs.empty()) {
+    return;
+  }
+
+  storePrecomputedLongHashes(blobHashes, computeLongHashes(blobs));
+}
+
+bool blockchain_storage::checkBlockHeaders(const crypto::hash& prevId, const std::vector<BlockShortHeader>& headers, const std::vector<crypto::hash>& ids, DifficultyWindow& window) {
+  CHECK_AND_ASSERT_MES(headers.size() == ids.size(), false, "Block headers count doesn't match block ids count");
+  for (size_t i = 0; i < headers.size(); ++i) {
+    crypto::hash id;
+    if (!get_block_hash(headers[i], id) || id != ids[i]) {
+      LOG_PRINT_L0("Block header " << i << " doesn't match block id " << ids[i]);
+      return false;
+    }
+
+    if (headers[i].prevId != (i == 0 ? prevId : ids[i - 1])) {
+      LOG_PRINT_L0("Block header " << ids[i] << " has wrong prevId: " << headers[i].prevId);
+      return false;
+    }
+  }
+
+  if (headers.empty()) {
+    return true;
+  }
+
+  // Difficulties depend on the previous blocks, so they are computed one by one, continuing from the window of the
+  // headers checked before when they precede these ones. Proofs of work of the blocks outside the checkpoint zone are
+  // then checked on all cores without the blockchain lock. Headers checked before, as announced by other peers, have
+  // their long hashes cached.
+  DifficultyWindow next;
+  std::vector<difficulty_type> difficulties;
+  std::vector<size_t> checkedHeaders;
+  std::vector<blobdata> blobs;
+  std::vector<crypto::hash> blobHashes;
+  {
+    SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
+    size_t count = m_currency.difficultyBlocksCount();
+    difficulty_type cumulativeDifficulty;
+    if (window.lastBlockId == prevId && !window.cumulativeDifficulties.empty()) {
+      next = window;
+      cumulativeDifficulty = next.cumulativeDifficulties.back();
+    } else if (m_blockIndex.getBlockHeight(prevId, next.lastBlockHeight)) {
+      uint64_t prevHeight = next.lastBlockHeight;
+      for (uint64_t h = std::max<uint64_t>(1, prevHeight + 1 - std::min<uint64_t>(prevHeight + 1, count)); h <= prevHeight; ++h) {
+        next.timestamps.push_back(m_blockHeaders.timestamp(h));
+        next.cumulativeDifficulties.push_back(m_blockHeaders.cumulativeDifficulty(h));
+      }
+
+      next.lastBlockId = prevId;
+      cumulativeDifficulty = m_blockHeaders.cumulativeDifficulty(prevHeight);
+    } else if (m_alternative_chains.count(prevId) != 0) {
+      // a fork from an alternative chain, the proofs of work of its blocks are only checked when the blocks are added
+      window = DifficultyWindow();
+      return true;
+    } else {
+      LOG_PRINT_L0("Block headers follow unknown block " << prevId);
+      return false;
+    }
+
+    for (size_t i = 0; i < headers.size(); ++i) {
+      uint64_t height = next.lastBlockHeight + 1;
+      difficulty_type difficulty = m_currency.nextDifficulty(next.timestamps, next.cumulativeDifficulties);
+      CHECK_AND_ASSERT_MES(difficulty, false, "!!!!!!!!! difficulty overhead !!!!!!!!!");
+      cumulativeDifficulty += difficulty;
+      next.timestamps.push_back(headers[i].timestamp);
+      next.cumulativeDifficulties.push_back(cumulativeDifficulty);
+      if (next.timestamps.size() > count) {
+        next.timestamps.erase(next.timestamps.begin());
+        next.cumulativeDifficulties.erase(next.cumulativeDifficulties.begin());
+      }
+
+      next.lastBlockId = ids[i];
+      next.lastBlockHeight = height;
+      if (m_checkpoints.is_in_checkpoint_zone(height)) {
+        if (!m_checkpoints.check_block(height, ids[i])) {
+          LOG_ERROR("CHECKPOINT VALIDATION FAILED");
+          return false;
+        }
+
+        continue;
+      }
+
+      blobdata blob;
+      size_t nonceOffset;
+      if (!get_block_longhash_blob(headers[i], blob, nonceOffset)) {
+        LOG_PRINT_L0("Failed to get long hash blob of block header " << ids[i]);
+        return false;
+      }
+
+      difficulties.push_back(difficulty);
+      checkedHeaders.push_back(i);
+      blobHashes.push_back(crypto::cn_fast_hash(blob.data(), blob.size()));
+      blobs.push_back(std::move(blob));
+    }
+  }
+
+  // hashed in parts of a few blobs per core, so a chain is rejected at its first bad header without hashing the rest
+  const size_t partSize = 4 * std::max(1u, std::thread::hardware_concurrency());
+  std::vector<crypto::hash> computedBlobHashes;
+  std::vector<crypto::hash> computedHashes;
+  for (size_t partBegin = 0; partBegin < checkedHeaders.size(); partBegin += partSize) {
+    size_t partEnd = std::min(checkedHeaders.size(), partBegin + partSize);
+    std::vector<crypto::hash> longHashes(partEnd - partBegin);
+    std::vector<size_t> hashedHeaders;
+    std::vector<blobdata> partBlobs;
+    for (size_t i = partBegin; i < partEnd; ++i) {
+      if (!findPrecomputedLongHash(blobHashes[i], longHashes[i - partBegin])) {
+        hashedHeaders.push_back(i);
+        partBlobs.push_back(std::move(blobs[i]));
+      }
+    }
+
+    std::vector<crypto::hash> partHashes = computeLongHashes(partBlobs);
+    for (size_t i = 0; i < hashedHeaders.size(); ++i) {
+      longHashes[hashedHeaders[i] - partBegin] = partHashes[i];
+      computedBlobHashes.push_back(blobHashes[hashedHeaders[i]]);
+      computedHashes.push_back(partHashes[i]);
+    }
+
+    for (size_t i = partBegin; i < partEnd; ++i) {
+      const crypto::hash& longHash = longHashes[i - partBegin];
+      if (!m_currency.checkProofOfWork(headers[checkedHeaders[i]], difficulties[i], longHash)) {
+        LOG_PRINT_L0("Block header " << ids[checkedHeaders[i]] << " has too weak proof of work: " << longHash << ", expected difficulty: " << difficulties[i]);
+        return false;
+      }
+    }
+  }
+
+  storePrecomputedLongHashes(computedBlobHashes, computedHashes);
+  window = std::move(next);
+  return true;
+}
+
+std::vector<crypto::hash> blockchain_storage::computeLongHashes(const std::vector<blobdata>& blobs) {
+  // Blobs are split into contiguous ranges, one per core, hashed by the shared workers and the calling thread.
+  // Every range hashes up to 4 blobs at once with the contexts of the thread running it.
+  std::vector<crypto::hash> longHashes(blobs.size());
+  if (blobs.empty()) {
+    return longHashes;
+  }
+
+  auto hashRange = [&blobs, &longHashes](size_t begin, size_t end) {
+    crypto::cn_context* contexts = getLongHashContexts();
+    const void* data[LONG_HASH_MAX_WAYS];
+    size_t lengths[LONG_HASH_MAX_WAYS];
+    for (size_t i = begin; i < end; i += LONG_HASH_MAX_WAYS) {
+      size_t ways = std::min(LONG_HASH_MAX_WAYS, end - i);
+      for (size_t j = 0; j < ways; ++j) {
+        data[j] = blobs[i + j].data();
+        lengths[j] = blobs[i + j].size();
+      }
+
+      crypto::cn_slow_hash_batch(contexts, ways, data, lengths, &longHashes[i]);
+    }
+  };
+
+  size_t rangeCount = std::max<size_t>(1, std::min<size_t>((blobs.size() + LONG_HASH_MAX_WAYS - 1) / LONG_HASH_MAX_WAYS, std::thread::hardware_concurrency()));
+  tools::WorkerPool::shared().run(rangeCount, [&](size_t range) {
+    hashRange(blobs.size() * range / rangeCount, blobs.size() * (range + 1) / rangeCount);
+  });
+
+  return longHashes;
+}
+
+bool blockchain_storage::findPrecomputedLongHash(const crypto::hash& blobHash, crypto::hash& longHash) {
+  std::lock_guard<std::mutex> lock(m_longHashesLock);
+  auto it = m_longHashes.find(blobHash);
+  if (it == m_longHashes.end()) {
+    return false;
+  }
+
+  longHash = it->second;
+  return true;
+}
+
+void blockchain_storage::storePrecomputedLongHashes(const std::vector<crypto::hash>& blobHashes, const std::vector<crypto::hash>& longHashes) {
+  std::lock_guard<std::mutex> lock(m_longHashesLock);
+  if (m_longHashes.size() + blobHashes.size() > PRECOMPUTED_LONG_HASHES_MAX_COUNT) {
+    m_longHashes.clear();
+  }
+
+  for (size_t i = 0; i < blobHashes.size(); ++i) {
+    m_longHashes.insert(std::make_pair(blobHashes[i], longHashes[i]));
+  }
+}
+
+bool blockchain_storage::takePrecomputedLongHash(const Block& block, crypto::hash& longHash) {
+  std::lock_guard<std::mutex> lock(m_longHashesLock);
+  if (m_longHashes.empty()) {
+    return false;
+  }
+
+  blobdata blob;
+  size_t nonceOffset;
+  if (!get_block_longhash_blob(block, blob, nonceOffset)) {
+    return false;
+  }
+
+  auto it = m_longHashes.find(crypto::cn_fast_hash(blob.data(), blob.size()));
+  if (it == m_longHashes.end()) {
+    return false;
+  }
+
+  longHash = it->second;
+  m_longHashes.erase(it);
+  return true;
 }
 
 uint64_t blockchain_storage::get_adjusted_time() {
@@ -1514,7 +2070,7 @@ bool blockchain_storage::check_block_timestamp_main(const Block& b) {
   std::vector<uint64_t> timestamps;
   size_t offset = m_blocks.size() <= m_currency.timestampCheckWindow() ? 0 : m_blocks.size() - m_currency.timestampCheckWindow();
   for (; offset != m_blocks.size(); ++offset) {
-    timestamps.push_back(m_blocks[offset].bl.timestamp);
+    timestamps.push_back(m_blockHeaders.timestamp(offset));
   }
 
   return check_block_timestamp(std::move(timestamps), b);
@@ -1640,8 +2196,9 @@ bool blockchain_storage::add_new_block(const Block& bl_, block_verification_cont
   return pushBlock(bl, bvc);
 }
 
-const blockchain_storage::TransactionEntry& blockchain_storage::transactionByIndex(TransactionIndex index) {
-  return m_blocks[index.block].transactions[index.transaction];
+std::shared_ptr<const blockchain_storage::TransactionEntry> blockchain_storage::transactionByIndex(TransactionIndex index) {
+  std::shared_ptr<const BlockEntry> block = m_blocks.get(index.block);
+  return std::shared_ptr<const TransactionEntry>(block, &block->transactions[index.transaction]);
 }
 
 bool blockchain_storage::pushBlock(const Block& blockData, block_verification_context& bvc) {
@@ -1692,7 +2249,14 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
       return false;
     }
   } else {
-    if (!m_currency.checkProofOfWork(m_cn_context, blockData, currentDifficulty, proof_of_work)) {
+    bool proofOfWorkValid;
+    if (takePrecomputedLongHash(blockData, proof_of_work)) {
+      proofOfWorkValid = m_currency.checkProofOfWork(blockData, currentDifficulty, proof_of_work);
+    } else {
+      proofOfWorkValid = m_currency.checkProofOfWork(m_cn_context, blockData, currentDifficulty, proof_of_work);
+    }
+
+    if (!proofOfWorkValid) {
       LOG_PRINT_L0("Block " << blockHash << ", has too weak proof of work: " << proof_of_work << ", expected difficulty: " << currentDifficulty);
       bvc.m_verifivation_failed = true;
       return false;
@@ -1719,6 +2283,8 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
   size_t coinbase_blob_size = get_object_blobsize(blockData.minerTx);
   size_t cumulative_block_size = coinbase_blob_size;
   uint64_t fee_summary = 0;
+  std::vector<RingSignatureCheck> ringSignatureChecks;
+  std::vector<std::pair<crypto::hash, crypto::hash>> verifiedTransactions;
   for (const crypto::hash& tx_id : blockData.txHashes) {
     block.transactions.resize(block.transactions.size() + 1);
     size_t blob_size = 0;
@@ -1732,7 +2298,10 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
       return false;
     }
 
-    if (!check_tx_inputs(block.transactions.back().tx)) {
+    const Transaction& transaction = block.transactions.back().tx;
+    size_t firstCheck = ringSignatureChecks.size();
+    uint64_t maxUsedBlockHeight;
+    if (!check_tx_inputs(transaction, get_transaction_prefix_hash(transaction), &maxUsedBlockHeight, &ringSignatureChecks)) {
       LOG_PRINT_L0("Block " << blockHash << " has at least one transaction with wrong inputs: " << tx_id);
       bvc.m_verifivation_failed = true;
       tx_verification_context tvc = ::AUTO_VAL_INIT(tvc);
@@ -1745,6 +2314,18 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
       return false;
     }
 
+    // transactions verified when they entered the pool only need the key image and unlock checks made above
+    crypto::hash maxUsedBlockId = m_blockIndex.getBlockId(maxUsedBlockHeight);
+    if (m_validationCache.contains(tx_id, maxUsedBlockId)) {
+      ringSignatureChecks.resize(firstCheck);
+    } else if (!m_is_in_checkpoint_zone) {
+      verifiedTransactions.push_back(std::make_pair(tx_id, maxUsedBlockId));
+    }
+
+    for (size_t i = firstCheck; i < ringSignatureChecks.size(); ++i) {
+      ringSignatureChecks[i].transaction = block.transactions.size() - 1;
+    }
+
     ++transactionIndex.transaction;
     pushTransaction(block, tx_id, transactionIndex);
 
@@ -1752,6 +2333,21 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
     fee_summary += fee;
   }
 
+  TIME_MEASURE_START(ring_signatures_checking_time);
+  size_t failedCheck;
+  if (!checkRingSignatures(ringSignatureChecks, failedCheck)) {
+    LOG_PRINT_L0("Block " << blockHash << " has at least one transaction with invalid ring signature: " <<
+      blockData.txHashes[ringSignatureChecks[failedCheck].transaction - 1]);
+    bvc.m_verifivation_failed = true;
+    popTransactions(block, minerTransactionHash);
+    return false;
+  }
+
+  TIME_MEASURE_FINISH(ring_signatures_checking_time);
+  for (const auto& transaction : verifiedTransactions) {
+    m_validationCache.add(transaction.first, transaction.second);
+  }
+
   if (!checkCumulativeBlockSize(blockHash, cumulative_block_size, m_blocks.size())) {
     bvc.m_verifivation_failed = true;
     return false;
@@ -1759,7 +2355,7 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
 
   int64_t emissionChange = 0;
   uint64_t reward = 0;
-  uint64_t already_generated_coins = m_blocks.empty() ? 0 : m_blocks.back().already_generated_coins;
+  uint64_t already_generated_coins = m_blockHeaders.empty() ? 0 : m_blockHeaders.generatedCoins(m_blockHeaders.size() - 1);
   if (!validate_miner_transaction(blockData, m_blocks.size(), cumulative_block_size, already_generated_coins, fee_summary, reward, emissionChange)) {
     LOG_PRINT_L0("Block " << blockHash << " has invalid miner transaction");
     bvc.m_verifivation_failed = true;
@@ -1772,7 +2368,7 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
   block.cumulative_difficulty = currentDifficulty;
   block.already_generated_coins = already_generated_coins + emissionChange;
   if (m_blocks.size() > 0) {
-    block.cumulative_difficulty += m_blocks.back().cumulative_difficulty;
+    block.cumulative_difficulty += m_blockHeaders.cumulativeDifficulty(m_blockHeaders.size() - 1);
   }
 
   pushBlock(block);
@@ -1782,12 +2378,13 @@ bool blockchain_storage::pushBlock(const Block& blockData, block_verification_co
     << ENDL << "HEIGHT " << block.height << ", difficulty:\t" << currentDifficulty
     << ENDL << "block reward: " << m_currency.formatAmount(reward) << ", fee = " << m_currency.formatAmount(fee_summary)
     << ", coinbase_blob_size: " << coinbase_blob_size << ", cumulative size: " << cumulative_block_size
-    << ", " << block_processing_time << "(" << target_calculating_time << "/" << longhash_calculating_time << ")ms");
+    << ", " << block_processing_time << "(" << target_calculating_time << "/" << longhash_calculating_time << "/" << ring_signatures_checking_time << ")ms");
 
   bvc.m_added_to_main_chain = true;
 
   m_upgradeDetector.blockPushed();
   update_next_comulative_size_limit();
+  m_tx_pool.on_blockchain_inc(m_blocks.size(), blockHash);
 
   return true;
 }
@@ -1797,8 +2394,11 @@ bool blockchain_storage::pushBlock(BlockEntry& block) {
 
   m_blocks.push_back(block);
   m_blockIndex.push(blockHash);
+  m_blockHeaders.push(block.bl.timestamp, block.cumulative_difficulty, block.block_cumulative_size, block.already_generated_coins, block.bl.majorVersion);
+  journalBlock(BlockCacheJournal::BLOCK_PUSHED, block, blockHash);
 
   assert(m_blockIndex.size() == m_blocks.size());
+  assert(m_blockHeaders.size() == m_blocks.size());
 
   return true;
 }
@@ -1809,13 +2409,18 @@ void blockchain_storage::popBlock(const crypto::hash& blockHash) {
     return;
   }
 
-  popTransactions(m_blocks.back(), get_transaction_hash(m_blocks.back().bl.minerTx));
+  std::shared_ptr<const BlockEntry> block = m_blocks.get(m_blocks.size() - 1);
+  journalBlock(BlockCacheJournal::BLOCK_POPPED, *block, blockHash);
+  popTransactions(*block, get_transaction_hash(block->bl.minerTx));
   m_blocks.pop_back();
   m_blockIndex.pop();
+  m_blockHeaders.pop();
 
   assert(m_blockIndex.size() == m_blocks.size());
+  assert(m_blockHeaders.size() == m_blocks.size());
 
   m_upgradeDetector.blockPopped();
+  m_tx_pool.on_blockchain_dec(m_blocks.size(), m_blockIndex.getTailId());
 }
 
 bool blockchain_storage::pushTransaction(BlockEntry& block, const crypto::hash& transactionHash, TransactionIndex transactionIndex) {
@@ -1861,7 +2466,8 @@ bool blockchain_storage::pushTransaction(BlockEntry& block, const crypto::hash&
     if (transaction.tx.vout[output].target.type() == typeid(TransactionOutputToKey)) {
       auto& amountOutputs = m_outputs[transaction.tx.vout[output].amount];
       transaction.m_global_output_indexes[output] = amountOutputs.size();
-      amountOutputs.push_back(std::make_pair<>(transactionIndex, output));
+      KeyOutput keyOutput = { transactionIndex, output, ::boost::get<TransactionOutputToKey>(transaction.tx.vout[output].target).key, transaction.tx.unlockTime };
+      amountOutputs.push_back(keyOutput);
     } else if (transaction.tx.vout[output].target.type() == typeid(TransactionOutputMultisignature)) {
       auto& amountOutputs = m_multisignatureOutputs[transaction.tx.vout[output].amount];
       MultisignatureOutputUsage outputUsage = {transactionIndex, output, false};
@@ -1888,12 +2494,12 @@ void blockchain_storage::popTransaction(const Transaction& transaction, const cr
         continue;
       }
 
-      if (amountOutputs->second.back().first.block != transactionIndex.block || amountOutputs->second.back().first.transaction != transactionIndex.transaction) {
+      if (amountOutputs->second.back().transactionIndex.block != transactionIndex.block || amountOutputs->second.back().transactionIndex.transaction != transactionIndex.transaction) {
         LOG_ERROR("Blockchain consistency broken - invalid transaction index.");
         continue;
       }
 
-      if (amountOutputs->second.back().second != transaction.vout.size() - 1 - outputIndex) {
+      if (amountOutputs->second.back().outputIndex != transaction.vout.size() - 1 - outputIndex) {
         LOG_ERROR("Blockchain consistency broken - invalid output index.");
         continue;
       }
@@ -1990,7 +2596,8 @@ bool blockchain_storage::validateInput(const TransactionInputMultisignature& inp
     return false;
   }
 
-  const Transaction& outputTransaction = m_blocks[outputIndex.transactionIndex.block].transactions[outputIndex.transactionIndex.transaction].tx;
+  std::shared_ptr<const TransactionEntry> outputTransactionEntry = transactionByIndex(outputIndex.transactionIndex);
+  const Transaction& outputTransaction = outputTransactionEntry->tx;
   if (!is_tx_spendtime_unlocked(outputTransaction.unlockTime)) {
     LOG_PRINT_L1("Transaction << " << transactionHash << " contains multisignature input which points to a locked transaction.");
     return false;
@@ -2023,24 +2630,22 @@ bool blockchain_storage::validateInput(const TransactionInputMultisignature& inp
 }
 
 bool blockchain_storage::getLowerBound(uint64_t timestamp, uint64_t startOffset, uint64_t& height) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   
   if (startOffset >= m_blocks.size()) {
     return false;
   }
 
-  auto bound = std::lower_bound(m_blocks.begin() + startOffset, m_blocks.end(), timestamp - m_currency.blockFutureTimeLimit(),
-    [](const BlockEntry& b, uint64_t timestamp) { return b.bl.timestamp < timestamp; });
-
-  if (bound == m_blocks.end()) {
+  uint64_t bound = m_blockHeaders.timestampLowerBound(startOffset, timestamp - m_currency.blockFutureTimeLimit());
+  if (bound == m_blockHeaders.size()) {
     return false;
   }
 
-  height = std::distance(m_blocks.begin(), bound);
+  height = bound;
   return true;
 }
 
 bool blockchain_storage::getBlockIds(uint64_t startHeight, size_t maxCount, std::list<crypto::hash>& items) {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
   return m_blockIndex.getBlockIds(startHeight, maxCount, items);
 }
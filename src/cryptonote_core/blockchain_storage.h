@@ -18,25 +18,32 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>
 
 #include "Currency.h"
-#include "SwappedVector.h"
+#include "MappedVector.h"
 #include "UpgradeDetector.h"
 #include "cryptonote_format_utils.h"
 #include "tx_pool.h"
 #include "common/util.h"
+#include "common/FlatHashTable.h"
+#include "common/RecursiveSharedMutex.h"
 #include "checkpoints.h"
 
-#include "google/sparse_hash_set"
 #include "google/sparse_hash_map"
 
 #include "ITransactionValidator.h"
 #include "BlockIndex.h"
+#include "BlockHeaderColumns.h"
+#include "BlockCacheJournal.h"
+#include "TransactionValidationCache.h"
 
 namespace cryptonote {
   struct NOTIFY_RESPONSE_CHAIN_ENTRY_request;
   struct NOTIFY_REQUEST_GET_OBJECTS_request;
   struct NOTIFY_RESPONSE_GET_OBJECTS_request;
+  struct NOTIFY_REQUEST_BLOCK_HEADERS_request;
+  struct NOTIFY_RESPONSE_BLOCK_HEADERS_request;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount;
@@ -78,6 +85,13 @@ namespace cryptonote {
     uint64_t getCoinsInCirculation();
     uint8_t get_block_major_version_for_height(uint64_t height) const;
     bool add_new_block(const Block& bl_, block_verification_context& bvc);
+    // computes long hashes of consecutive blocks about to be added from the given height on, on all cores without
+    // taking the blockchain lock, so adding them only has to compare the hashes with the difficulty
+    void precomputeLongHashes(const std::vector<Block>& blocks, uint64_t height);
+    // checks that the headers link to each other, starting from the block with the given id, and hash to the given
+    // ids; if that block is in the main chain, their proofs of work are checked too, on all cores, and the long hashes
+    // are kept for the blocks to be added
+    bool checkBlockHeaders(const crypto::hash& prevId, const std::vector<BlockShortHeader>& headers, const std::vector<crypto::hash>& ids, DifficultyWindow& window);
     bool reset_and_set_genesis_block(const Block& b);
     bool create_block_template(Block& b, const AccountPublicAddress& miner_address, difficulty_type& di, uint64_t& height, const blobdata& ex_nonce);
     bool have_block(const crypto::hash& id);
@@ -87,17 +101,21 @@ namespace cryptonote {
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY_request& resp);
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<Block, std::list<Transaction>>>& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
     bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS_request& arg, NOTIFY_RESPONSE_GET_OBJECTS_request& rsp);
+    bool handle_get_block_headers(const NOTIFY_REQUEST_BLOCK_HEADERS_request& arg, NOTIFY_RESPONSE_BLOCK_HEADERS_request& rsp);
     bool get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response& res);
     bool get_backward_blocks_sizes(size_t from_height, std::vector<size_t>& sz, size_t count);
     bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs);
     bool check_tx_inputs(const Transaction& tx, uint64_t& pmax_used_block_height, crypto::hash& max_used_block_id, BlockInfo* tail = 0);
     uint64_t get_current_comulative_blocksize_limit();
     bool is_storing_blockchain(){return m_is_blockchain_storing;}
+    // saves the indexes to the blockchain cache file and starts a new journal, the daemon keeps running meanwhile
+    bool storeCache();
+    void on_idle();
     uint64_t block_difficulty(size_t i);
 
     template<class t_ids_container, class t_blocks_container, class t_missed_container>
     bool get_blocks(const t_ids_container& block_ids, t_blocks_container& blocks, t_missed_container& missed_bs) {
-      CRITICAL_REGION_LOCAL(m_blockchain_lock);
+      SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
 
       for (const auto& bl_id : block_ids) {
         uint64_t height = 0;
@@ -106,7 +124,7 @@ namespace cryptonote {
         } else {
           CHECK_AND_ASSERT_MES(height < m_blocks.size(), false, "Internal error: bl_id=" << epee::string_tools::pod_to_hex(bl_id)
             << " have index record with offset=" << height << ", bigger then m_blocks.size()=" << m_blocks.size());
-            blocks.push_back(m_blocks[height].bl);
+            blocks.push_back(m_blocks.get(height)->bl);
         }
       }
 
@@ -115,14 +133,14 @@ namespace cryptonote {
 
     template<class t_ids_container, class t_tx_container, class t_missed_container>
     void get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs, bool checkTxPool = false) {
-      CRITICAL_REGION_LOCAL(m_blockchain_lock);
+      SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
 
       for (const auto& tx_id : txs_ids) {
         auto it = m_transactionMap.find(tx_id);
         if (it == m_transactionMap.end()) {
           missed_txs.push_back(tx_id);
         } else {
-          txs.push_back(transactionByIndex(it->second).tx);
+          txs.push_back(transactionByIndex(it->second)->tx);
         }
       }
 
@@ -178,6 +196,17 @@ namespace cryptonote {
       template<class Archive> void serialize(Archive& archive, unsigned int version);
     };
 
+    // Output to key of the global output table of its amount, with what ring signature checks and random outputs
+    // selection need, so they don't have to load the owning block. The height is transactionIndex.block.
+    struct KeyOutput {
+      TransactionIndex transactionIndex;
+      uint16_t outputIndex;
+      crypto::public_key key;
+      uint64_t unlockTime;
+
+      template<class Archive> void serialize(Archive& archive, unsigned int version);
+    };
+
     struct MultisignatureOutputUsage {
       TransactionIndex transactionIndex;
       uint16_t outputIndex;
@@ -186,14 +215,25 @@ namespace cryptonote {
       template<class Archive> void serialize(Archive& archive, unsigned int version);
     };
 
-    typedef google::sparse_hash_set<crypto::key_image> key_images_container;
+    // Ring signature of one input, collected while the inputs of a block are checked and verified afterwards in parallel
+    struct RingSignatureCheck {
+      crypto::hash prefixHash;
+      crypto::key_image keyImage;
+      std::vector<crypto::public_key> outputKeys;
+      std::vector<crypto::signature> signatures;
+      size_t transaction;
+    };
+
+    typedef tools::FlatHashSet<crypto::key_image> key_images_container;
     typedef std::unordered_map<crypto::hash, BlockEntry> blocks_ext_by_hash;
-    typedef google::sparse_hash_map<uint64_t, std::vector<std::pair<TransactionIndex, uint16_t>>> outputs_container; //crypto::hash - tx hash, size_t - index of out in transaction
+    typedef google::sparse_hash_map<uint64_t, std::vector<KeyOutput>> outputs_container; //amount -> outputs by global index
     typedef std::map<uint64_t, std::vector<MultisignatureOutputUsage>> MultisignatureOutputsContainer;
 
     const Currency& m_currency;
     tx_memory_pool& m_tx_pool;
-    epee::critical_section m_blockchain_lock; // TODO: add here reader/writer lock
+    // Exclusive for everything which changes the main chain or alternative chains, shared for read-only queries.
+    // Blocks must be read through m_blocks.get() while the lock is held shared.
+    tools::RecursiveSharedMutex m_blockchain_lock;
     crypto::cn_context m_cn_context;
 
     key_images_container m_spent_keys;
@@ -205,21 +245,32 @@ namespace cryptonote {
     checkpoints m_checkpoints;
     std::atomic<bool> m_is_in_checkpoint_zone;
     std::atomic<bool> m_is_blockchain_storing;
-
-    typedef SwappedVector<BlockEntry> Blocks;
+    std::atomic<time_t> m_lastCacheSaveTime;
+    BlockCacheJournal m_cacheJournal;
+    TransactionValidationCache m_validationCache;
+    // long hashes by the fast hash of the hashed blob, so a cached hash can only be used for the same proof of work
+    std::mutex m_longHashesLock;
+    tools::FlatHashMap<crypto::hash, crypto::hash> m_longHashes;
+
+    typedef MappedVector<BlockEntry> Blocks;
     typedef std::unordered_map<crypto::hash, uint32_t> BlockMap;
-    typedef std::unordered_map<crypto::hash, TransactionIndex> TransactionMap;
+    typedef tools::FlatHashMap<crypto::hash, TransactionIndex> TransactionMap;
     typedef BasicUpgradeDetector<Blocks> UpgradeDetector;
 
     friend class BlockCacheSerializer;
 
     Blocks m_blocks;
     CryptoNote::BlockIndex m_blockIndex;
+    BlockHeaderColumns m_blockHeaders;
     TransactionMap m_transactionMap;
     MultisignatureOutputsContainer m_multisignatureOutputs;
     UpgradeDetector m_upgradeDetector;
 
-    bool storeCache();
+    void rebuildCache();
+    bool writeCache();
+    bool replayCacheJournal();
+    void indexBlocks(uint32_t startHeight);
+    void journalBlock(BlockCacheJournal::RecordType type, const BlockEntry& block, const crypto::hash& blockHash);
     template<class visitor_t> bool scan_outputkeys_for_indexes(const TransactionInputToKey& tx_in_to_key, visitor_t& vis, uint64_t* pmax_related_block_height = NULL);
     bool switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::iterator>& alt_chain, bool discard_disconnected_chain);
     bool handle_alternative_block(const Block& b, const crypto::hash& id, block_verification_context& bvc);
@@ -229,9 +280,9 @@ namespace cryptonote {
     bool validate_transaction(const Block& b, uint64_t height, const Transaction& tx);
     bool rollback_blockchain_switching(std::list<Block>& original_chain, size_t rollback_height);
     bool get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count);
-    bool add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount& result_outs, uint64_t amount, size_t i);
+    bool add_out_to_get_random_outs(const std::vector<KeyOutput>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount& result_outs, uint64_t amount, size_t i);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time);
-    size_t find_end_of_allowed_index(const std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs);
+    size_t find_end_of_allowed_index(const std::vector<KeyOutput>& amount_outs);
     bool check_block_timestamp_main(const Block& b);
     bool check_block_timestamp(std::vector<uint64_t> timestamps, const Block& b);
     uint64_t get_adjusted_time();
@@ -241,11 +292,16 @@ namespace cryptonote {
     bool checkCumulativeBlockSize(const crypto::hash& blockId, size_t cumulativeBlockSize, uint64_t height);
     bool getBlockCumulativeSize(const Block& block, size_t& cumulativeSize);
     bool update_next_comulative_size_limit();
-    bool check_tx_input(const TransactionInputToKey& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height = NULL);
-    bool check_tx_inputs(const Transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height = NULL);
+    bool check_tx_input(const TransactionInputToKey& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height = NULL, std::vector<RingSignatureCheck>* deferredChecks = NULL);
+    bool check_tx_inputs(const Transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height = NULL, std::vector<RingSignatureCheck>* deferredChecks = NULL);
+    static bool checkRingSignatures(const std::vector<RingSignatureCheck>& checks, size_t& failedCheck);
+    static std::vector<crypto::hash> computeLongHashes(const std::vector<blobdata>& blobs);
+    bool findPrecomputedLongHash(const crypto::hash& blobHash, crypto::hash& longHash);
+    void storePrecomputedLongHashes(const std::vector<crypto::hash>& blobHashes, const std::vector<crypto::hash>& longHashes);
+    bool takePrecomputedLongHash(const Block& block, crypto::hash& longHash);
     bool check_tx_inputs(const Transaction& tx, uint64_t* pmax_used_block_height = NULL);
     bool have_tx_keyimg_as_spent(const crypto::key_image &key_im);
-    const TransactionEntry& transactionByIndex(TransactionIndex index);
+    std::shared_ptr<const TransactionEntry> transactionByIndex(TransactionIndex index);
     bool pushBlock(const Block& blockData, block_verification_context& bvc);
     bool pushBlock(BlockEntry& block);
     void popBlock(const crypto::hash& blockHash);
@@ -255,6 +311,7 @@ namespace cryptonote {
     bool validateInput(const TransactionInputMultisignature& input, const crypto::hash& transactionHash, const crypto::hash& transactionPrefixHash, const std::vector<crypto::signature>& transactionSignatures);
 
     friend class LockedBlockchainStorage;
+    friend class SharedLockedBlockchainStorage;
   };
 
   class LockedBlockchainStorage: boost::noncopyable {
@@ -270,17 +327,34 @@ namespace cryptonote {
   private:
 
     blockchain_storage& m_bc;
-    epee::critical_region_t<epee::critical_section> m_lock;
+    epee::critical_region_t<tools::RecursiveSharedMutex> m_lock;
+  };
+
+  // Keeps blockchain_storage locked for reading only, so it should be used for read-only queries.
+  class SharedLockedBlockchainStorage: boost::noncopyable {
+  public:
+
+    SharedLockedBlockchainStorage(blockchain_storage& bc)
+      : m_bc(bc), m_lock(bc.m_blockchain_lock) {}
+
+    blockchain_storage* operator -> () {
+      return &m_bc;
+    }
+
+  private:
+
+    blockchain_storage& m_bc;
+    tools::shared_region_t<tools::RecursiveSharedMutex> m_lock;
   };
 
   template<class visitor_t> bool blockchain_storage::scan_outputkeys_for_indexes(const TransactionInputToKey& tx_in_to_key, visitor_t& vis, uint64_t* pmax_related_block_height) {
-    CRITICAL_REGION_LOCAL(m_blockchain_lock);
+    SHARED_LOCK_REGION_LOCAL(m_blockchain_lock);
     auto it = m_outputs.find(tx_in_to_key.amount);
     if (it == m_outputs.end() || !tx_in_to_key.keyOffsets.size())
       return false;
 
     std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_in_to_key.keyOffsets);
-    std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs_vec = it->second;
+    const std::vector<KeyOutput>& amount_outs_vec = it->second;
     size_t count = 0;
     for (uint64_t i : absolute_offsets) {
       if(i >= amount_outs_vec.size() ) {
@@ -288,20 +362,14 @@ namespace cryptonote {
         return false;
       }
 
-      //auto tx_it = m_transactionMap.find(amount_outs_vec[i].first);
-      //CHECK_AND_ASSERT_MES(tx_it != m_transactionMap.end(), false, "Wrong transaction id in output indexes: " << epee::string_tools::pod_to_hex(amount_outs_vec[i].first));
-
-      const TransactionEntry& tx = transactionByIndex(amount_outs_vec[i].first);
-      CHECK_AND_ASSERT_MES(amount_outs_vec[i].second < tx.tx.vout.size(), false,
-        "Wrong index in transaction outputs: " << amount_outs_vec[i].second << ", expected less then " << tx.tx.vout.size());
-      if (!vis.handle_output(tx.tx, tx.tx.vout[amount_outs_vec[i].second])) {
+      if (!vis.handle_output(amount_outs_vec[i])) {
         LOG_PRINT_L0("Failed to handle_output for output no = " << count << ", with absolute offset " << i);
         return false;
       }
 
       if(count++ == absolute_offsets.size()-1 && pmax_related_block_height) {
-        if (*pmax_related_block_height < amount_outs_vec[i].first.block) {
-          *pmax_related_block_height = amount_outs_vec[i].first.block;
+        if (*pmax_related_block_height < amount_outs_vec[i].transactionIndex.block) {
+          *pmax_related_block_height = amount_outs_vec[i].transactionIndex.block;
         }
       }
     }
@@ -25,6 +25,7 @@
 #include "copyable_atomic.h"
 
 #include "crypto/hash.h"
+#include "cryptonote_core/difficulty.h"
 
 namespace cryptonote
 {
@@ -41,10 +42,13 @@ namespace cryptonote
     };
 
     state m_state;
-    std::list<crypto::hash> m_needed_objects;
-    std::unordered_set<crypto::hash> m_requested_objects;
     uint64_t m_remote_blockchain_height;
     uint64_t m_last_response_height;
+    uint32_t m_protocol_version;
+    std::list<crypto::hash> m_unchecked_block_ids; //chain entry ids whose headers are checked before the blocks are downloaded
+    crypto::hash m_last_checked_block_id;          //the block the next headers follow
+    DifficultyWindow m_checked_headers_window;     //difficulty inputs of the checked headers, up to m_last_checked_block_id
+    size_t m_requested_headers_count;              //headers of the first unchecked ids being requested
     epee::copyable_atomic m_callback_request_count; //in debug purpose: problem with double callback rise
     //size_t m_score;  TODO: add score calculations
   };
@@ -376,6 +376,24 @@ namespace cryptonote {
     return ParentBlockSerializer(blockRef.parentBlock, blockRef.timestamp, blockRef.nonce, hashingSerialization, headerOnly);
   }
 
+  // Block without its transactions, which still has its id and proof of work computable: the merkle root and count
+  // of the transactions stand for them. Merge mined blocks keep their whole parent block, as the id hashes all of it.
+  struct BlockShortHeader: public BlockHeader {
+    ParentBlock parentBlock;
+    crypto::hash merkleRoot;
+    uint64_t transactionCount;
+
+    BEGIN_SERIALIZE_OBJECT()
+      FIELDS(*static_cast<BlockHeader *>(this));
+      if (majorVersion == BLOCK_MAJOR_VERSION_2) {
+        ParentBlockSerializer serializer(parentBlock, timestamp, nonce, false, false);
+        FIELD_N("parentBlock", serializer);
+      }
+      FIELD(merkleRoot);
+      VARINT_FIELD(transactionCount);
+    END_SERIALIZE()
+  };
+
   struct AccountPublicAddress {
     crypto::public_key m_spendPublicKey;
     crypto::public_key m_viewPublicKey;
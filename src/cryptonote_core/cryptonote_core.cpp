@@ -17,7 +17,9 @@
 
 #include "cryptonote_core.h"
 
+#include <atomic>
 #include <sstream>
+#include <thread>
 #include <unordered_set>
 
 #include "storages/portable_storage_template_helper.h"
@@ -26,8 +28,10 @@
 #include "misc_language.h"
 #include "warnings.h"
 
+#include "common/BlockingQueue.h"
 #include "common/command_line.h"
 #include "common/util.h"
+#include "common/WorkerPool.h"
 #include "crypto/crypto.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "cryptonote_core/cryptonote_stat_info.h"
@@ -44,12 +48,19 @@ DISABLE_VS_WARNINGS(4355)
 namespace cryptonote
 {
 
+  namespace
+  {
+    const command_line::arg_descriptor<uint64_t> arg_mempool_max_size = {"mempool-max-size", "Specify the memory pool size limit in bytes, the lowest paying transactions are evicted above it",
+      parameters::CRYPTONOTE_MEMPOOL_DEFAULT_MAX_SIZE};
+  }
+
   //-----------------------------------------------------------------------------------------------
   core::core(const Currency& currency, i_cryptonote_protocol* pprotocol):
               m_currency(currency),
               m_mempool(currency, m_blockchain_storage, m_timeProvider),
               m_blockchain_storage(currency, m_mempool),
               m_miner(new miner(currency, this)),
+              m_mempoolMaxSize(parameters::CRYPTONOTE_MEMPOOL_DEFAULT_MAX_SIZE),
               m_starter_message_showed(false)
   {
     set_cryptonote_protocol(pprotocol);
@@ -71,13 +82,15 @@ namespace cryptonote
     m_blockchain_storage.set_checkpoints(std::move(chk_pts));
   }
   //-----------------------------------------------------------------------------------
-  void core::init_options(boost::program_options::options_description& /*desc*/)
+  void core::init_options(boost::program_options::options_description& desc)
   {
+    command_line::add_arg(desc, arg_mempool_max_size);
   }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_command_line(const boost::program_options::variables_map& vm)
   {
     m_config_folder = command_line::get_arg(vm, command_line::arg_data_dir);
+    m_mempoolMaxSize = static_cast<size_t>(command_line::get_arg(vm, arg_mempool_max_size));
     return true;
   }
   //-----------------------------------------------------------------------------------------------
@@ -120,7 +133,7 @@ namespace cryptonote
   {
     bool r = handle_command_line(vm);
 
-    r = m_mempool.init(m_config_folder);
+    r = m_mempool.init(m_config_folder, m_mempoolMaxSize);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize memory pool");
 
     r = m_blockchain_storage.init(m_config_folder, load_existing);
@@ -154,8 +167,7 @@ namespace cryptonote
   bool core::handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block)
   {
     tvc = boost::value_initialized<tx_verification_context>();
-    //want to process all transactions sequentially
-    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+    // transactions are parsed and verified concurrently, only their insertion to the pool is serialized
 
     if(tx_blob.size() > m_currency.maxTxSize())
     {
@@ -208,6 +220,38 @@ namespace cryptonote
     return r;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_txs(const std::list<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvcs, bool keeped_by_block) {
+    std::vector<const blobdata*> blobs;
+    blobs.reserve(tx_blobs.size());
+    for (const blobdata& tx_blob : tx_blobs) {
+      blobs.push_back(&tx_blob);
+    }
+
+    tvcs.resize(blobs.size());
+
+    // Transactions are split into contiguous ranges, one per core, handled by the shared workers and the calling thread.
+    auto handleRange = [this, &blobs, &tvcs, keeped_by_block](size_t begin, size_t end) {
+      bool result = true;
+      for (size_t i = begin; i < end; ++i) {
+        if (!handle_incoming_tx(*blobs[i], tvcs[i], keeped_by_block)) {
+          result = false;
+        }
+      }
+
+      return result;
+    };
+
+    size_t rangeCount = std::max<size_t>(1, std::min<size_t>(blobs.size(), std::thread::hardware_concurrency()));
+    std::atomic<bool> result(true);
+    tools::WorkerPool::shared().run(rangeCount, [&](size_t range) {
+      if (!handleRange(blobs.size() * range / rangeCount, blobs.size() * (range + 1) / rangeCount)) {
+        result = false;
+      }
+    });
+
+    return result;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_stat_info(core_stat_info& st_inf)
   {
     st_inf.mining_speed = m_miner->get_speed();
@@ -314,9 +358,7 @@ namespace cryptonote
       return true;
     }
 
-    // It's not very good to lock on m_mempool here, because it's very hard to understand the order of locking
-    // tx_memory_pool::m_transactions_lock, blockchain_storage::m_blockchain_lock, and core::m_incoming_tx_lock
-    CRITICAL_REGION_LOCAL(m_mempool);
+    // the pool verifies the transaction without holding its lock and checks for duplicates again on insertion
     if (m_mempool.have_tx(tx_hash)) {
       LOG_PRINT_L2("tx " << tx_hash << " is already in transaction pool");
       return true;
@@ -407,6 +449,123 @@ namespace cryptonote
     return handle_incoming_block(b, bvc, control_miner, relay_block);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_blocks(const std::list<block_complete_entry>& blocks, const std::vector<Block>& parsedBlocks, tx_verification_context& tvc, block_verification_context& bvc) {
+    tvc = boost::value_initialized<tx_verification_context>();
+    bvc = boost::value_initialized<block_verification_context>();
+    CHECK_AND_ASSERT_MES(blocks.size() == parsedBlocks.size(), false, "Parsed blocks count doesn't match blocks count");
+
+    // The blocks come parsed by the protocol handler. The shared workers parse and check their transactions in chunks
+    // while the calling thread hashes the proofs of work of all the blocks at once, then the checked chunks are committed
+    // in order on the calling thread, which verifies ring signatures on all cores while adding each block.
+    const size_t chunkSize = 4;
+    size_t chunkCount = (blocks.size() + chunkSize - 1) / chunkSize;
+    if (chunkCount == 0) {
+      return true;
+    }
+
+    uint64_t height = m_blockchain_storage.get_current_blockchain_height();
+    std::vector<BlockImportChunk> chunks(chunkCount);
+    auto it = blocks.begin();
+    for (size_t i = 0; i < blocks.size(); ++i, ++it) {
+      ImportedBlock imported;
+      imported.entry = &*it;
+      imported.block = &parsedBlocks[i];
+      imported.status = ImportedBlock::VALID;
+      chunks[i / chunkSize].blocks.push_back(std::move(imported));
+    }
+
+    BlockingQueue<size_t> checkedChunks(chunkCount);
+    std::atomic<bool> stopped(false);
+    for (size_t index = 0; index < chunkCount; ++index) {
+      tools::WorkerPool::shared().submit([this, &chunks, &checkedChunks, &stopped, index] {
+        if (!stopped) {
+          checkImportedBlocks(chunks[index]);
+        }
+
+        checkedChunks.push(index);
+      });
+    }
+
+    m_blockchain_storage.precomputeLongHashes(parsedBlocks, height);
+
+    // chunks are checked out of order, they wait here until all the preceding ones are committed; all of them are
+    // taken from the queue, even after a failure, since the workers use them until then
+    std::vector<bool> checked(chunkCount, false);
+    size_t nextChunk = 0;
+    for (size_t checkedCount = 0; checkedCount < chunkCount; ++checkedCount) {
+      size_t index;
+      checkedChunks.pop(index);
+      checked[index] = true;
+      while (!stopped && nextChunk < chunkCount && checked[nextChunk]) {
+        if (!commitImportedBlocks(chunks[nextChunk], tvc, bvc)) {
+          stopped = true;
+        }
+
+        ++nextChunk;
+      }
+    }
+
+    return !tvc.m_verifivation_failed && !bvc.m_verifivation_failed && !bvc.m_marked_as_orphaned;
+  }
+  //-----------------------------------------------------------------------------------------------
+  void core::checkImportedBlocks(BlockImportChunk& chunk) {
+    for (ImportedBlock& imported : chunk.blocks) {
+      if (imported.entry->block.size() > m_currency.maxBlockBlobSize()) {
+        LOG_PRINT_L0("WRONG BLOCK BLOB, too big size " << imported.entry->block.size() << ", rejected");
+        imported.status = ImportedBlock::INVALID_BLOCK;
+        return;
+      }
+
+      for (const blobdata& txBlob : imported.entry->txs) {
+        ImportedTransaction transaction;
+        transaction.blobSize = txBlob.size();
+        if (txBlob.size() > m_currency.maxTxSize() || !parse_tx_from_blob(transaction.tx, transaction.hash, transaction.prefixHash, txBlob)) {
+          LOG_PRINT_L0("WRONG TRANSACTION BLOB, Failed to parse, rejected");
+          imported.status = ImportedBlock::INVALID_TRANSACTION;
+          return;
+        }
+
+        if (!check_tx_syntax(transaction.tx) || !check_tx_semantic(transaction.tx, true)) {
+          LOG_PRINT_L0("WRONG TRANSACTION BLOB, Failed to check tx " << transaction.hash << ", rejected");
+          imported.status = ImportedBlock::INVALID_TRANSACTION;
+          return;
+        }
+
+        imported.transactions.push_back(std::move(transaction));
+      }
+    }
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::commitImportedBlocks(const BlockImportChunk& chunk, tx_verification_context& tvc, block_verification_context& bvc) {
+    for (const ImportedBlock& imported : chunk.blocks) {
+      if (imported.status == ImportedBlock::INVALID_TRANSACTION) {
+        tvc.m_verifivation_failed = true;
+        return false;
+      }
+
+      if (imported.status == ImportedBlock::INVALID_BLOCK) {
+        bvc.m_verifivation_failed = true;
+        return false;
+      }
+
+      for (const ImportedTransaction& transaction : imported.transactions) {
+        tvc = boost::value_initialized<tx_verification_context>();
+        add_new_tx(transaction.tx, transaction.hash, transaction.prefixHash, transaction.blobSize, tvc, true);
+        if (tvc.m_verifivation_failed) {
+          LOG_PRINT_RED_L0("Transaction verification failed: " << transaction.hash);
+          return false;
+        }
+      }
+
+      handle_incoming_block(*imported.block, bvc, false, false);
+      if (bvc.m_verifivation_failed || bvc.m_marked_as_orphaned) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_block(const Block& b, block_verification_context& bvc, bool control_miner, bool relay_block) {
     if (control_miner) {
       pause_mining();
@@ -455,11 +614,26 @@ namespace cryptonote
     return m_mempool.get_transactions_count();
   }
   //-----------------------------------------------------------------------------------------------
+  size_t core::get_pool_transactions_size()
+  {
+    return m_mempool.get_transactions_size();
+  }
+  //-----------------------------------------------------------------------------------------------
+  tx_memory_pool::EvictionStatistics core::get_pool_eviction_statistics()
+  {
+    return m_mempool.get_eviction_statistics();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::have_block(const crypto::hash& id)
   {
     return m_blockchain_storage.have_block(id);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::have_transaction(const crypto::hash& id)
+  {
+    return m_mempool.have_tx(id) || m_blockchain_storage.have_tx(id);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::parse_tx_from_blob(Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash, const blobdata& blob)
   {
     return parse_and_validate_tx_from_blob(blob, tx, tx_hash, tx_prefix_hash);
@@ -482,9 +656,31 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote_connection_context& context)
   {
+    // transactions announced by relay are usually still in the pool, only the missing ones are looked up in the blockchain
+    if (!arg.txs.empty()) {
+      std::list<Transaction> txs;
+      std::list<crypto::hash> missedTxs;
+      m_mempool.getTransactions(arg.txs, txs, missedTxs);
+      for (const auto& tx : txs) {
+        rsp.txs.push_back(t_serializable_object_to_blob(tx));
+      }
+
+      arg.txs.swap(missedTxs);
+    }
+
     return m_blockchain_storage.handle_get_objects(arg, rsp);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::handle_get_block_headers(const NOTIFY_REQUEST_BLOCK_HEADERS::request& arg, NOTIFY_RESPONSE_BLOCK_HEADERS::request& rsp)
+  {
+    return m_blockchain_storage.handle_get_block_headers(arg, rsp);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::check_block_headers(const crypto::hash& prevId, const std::vector<BlockShortHeader>& headers, const std::vector<crypto::hash>& ids, DifficultyWindow& window)
+  {
+    return m_blockchain_storage.checkBlockHeaders(prevId, headers, ids, window);
+  }
+  //-----------------------------------------------------------------------------------------------
   crypto::hash core::get_block_id_by_height(uint64_t height)
   {
     return m_blockchain_storage.get_block_id_by_height(height);
@@ -527,6 +723,7 @@ namespace cryptonote
 
     m_miner->on_idle();
     m_mempool.on_idle();
+    m_blockchain_storage.on_idle();
     return true;
   }
   //-----------------------------------------------------------------------------------------------
@@ -34,6 +34,7 @@ PUSH_WARNINGS
 DISABLE_VS_WARNINGS(4355)
 
 namespace cryptonote {
+  struct block_complete_entry;
   struct core_stat_info;
   class miner;
 
@@ -42,9 +43,16 @@ namespace cryptonote {
      core(const Currency& currency, i_cryptonote_protocol* pprotocol);
      ~core();
      bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS_request& arg, NOTIFY_RESPONSE_GET_OBJECTS_request& rsp, cryptonote_connection_context& context);
+     bool handle_get_block_headers(const NOTIFY_REQUEST_BLOCK_HEADERS_request& arg, NOTIFY_RESPONSE_BLOCK_HEADERS_request& rsp);
+     bool check_block_headers(const crypto::hash& prevId, const std::vector<BlockShortHeader>& headers, const std::vector<crypto::hash>& ids, DifficultyWindow& window);
      bool on_idle();
      bool handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block);
+     // admits the transactions concurrently, tvcs receives the verification result of each of them in order
+     bool handle_incoming_txs(const std::list<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvcs, bool keeped_by_block);
      bool handle_incoming_block_blob(const blobdata& block_blob, block_verification_context& bvc, bool control_miner, bool relay_block);
+     // adds downloaded blocks with their transactions in order, stops at the first rejected transaction or block;
+     // parsedBlocks holds the blocks of the entries, already parsed and validated from their blobs
+     bool handle_incoming_blocks(const std::list<block_complete_entry>& blocks, const std::vector<Block>& parsedBlocks, tx_verification_context& tvc, block_verification_context& bvc);
      const Currency& currency() const { return m_currency; }
      i_cryptonote_protocol* get_protocol(){return m_pprotocol;}
 
@@ -80,9 +88,13 @@ namespace cryptonote {
 
      void get_pool_transactions(std::list<Transaction>& txs);
      size_t get_pool_transactions_count();
+     size_t get_pool_transactions_size();
+     tx_memory_pool::EvictionStatistics get_pool_eviction_statistics();
      size_t get_blockchain_total_transactions();
      //bool get_outs(uint64_t amount, std::list<crypto::public_key>& pkeys);
      bool have_block(const crypto::hash& id);
+     // the transaction is either in the blockchain or in the transaction pool
+     bool have_transaction(const crypto::hash& id);
      bool get_short_chain_history(std::list<crypto::hash>& ids);
      bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY_request& resp);
      bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<Block, std::list<Transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
@@ -108,6 +120,34 @@ namespace cryptonote {
      bool parse_tx_from_blob(Transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash, const blobdata& blob);
      bool handle_incoming_block(const Block& b, block_verification_context& bvc, bool control_miner, bool relay_block);
 
+     struct ImportedTransaction {
+       Transaction tx;
+       crypto::hash hash;
+       crypto::hash prefixHash;
+       size_t blobSize;
+     };
+
+     struct ImportedBlock {
+       enum Status {
+         VALID,
+         INVALID_TRANSACTION,
+         INVALID_BLOCK
+       };
+
+       const block_complete_entry* entry;
+       const Block* block;
+       std::vector<ImportedTransaction> transactions;
+       Status status;
+     };
+
+     struct BlockImportChunk {
+       std::vector<ImportedBlock> blocks;
+     };
+
+     // parses the transactions of the blocks and checks them without the blockchain, stops at the first rejected one
+     void checkImportedBlocks(BlockImportChunk& chunk);
+     bool commitImportedBlocks(const BlockImportChunk& chunk, tx_verification_context& tvc, block_verification_context& bvc);
+
      bool check_tx_syntax(const Transaction& tx);
      //check correct values, amounts and all lightweight checks not related with database
      bool check_tx_semantic(const Transaction& tx, bool keeped_by_block);
@@ -127,9 +167,9 @@ namespace cryptonote {
      tx_memory_pool m_mempool;
      blockchain_storage m_blockchain_storage;
      i_cryptonote_protocol* m_pprotocol;
-     epee::critical_section m_incoming_tx_lock;
      std::unique_ptr<miner> m_miner;
      std::string m_config_folder;
+     size_t m_mempoolMaxSize;
      cryptonote_protocol_stub m_protocol_stub;
      friend class tx_validate_inputs;
      std::atomic<bool> m_starter_message_showed;
@@ -32,6 +32,41 @@ using namespace epee;
 
 namespace cryptonote
 {
+  namespace
+  {
+    ParentBlockSerializer makeParentBlockSerializer(const BlockHeader& header, const ParentBlock& parentBlock, bool hashingSerialization, bool headerOnly) {
+      BlockHeader& headerRef = const_cast<BlockHeader&>(header);
+      return ParentBlockSerializer(const_cast<ParentBlock&>(parentBlock), headerRef.timestamp, headerRef.nonce, hashingSerialization, headerOnly);
+    }
+
+    bool get_header_hashing_blob(const BlockHeader& header, const crypto::hash& treeRootHash, uint64_t transactionCount, blobdata& blob) {
+      if (!t_serializable_object_to_blob(header, blob)) {
+        return false;
+      }
+      blob.append(reinterpret_cast<const char*>(&treeRootHash), sizeof(treeRootHash));
+      blob.append(tools::get_varint_data(transactionCount));
+
+      return true;
+    }
+
+    bool get_header_hash(const BlockHeader& header, const ParentBlock& parentBlock, const crypto::hash& treeRootHash, uint64_t transactionCount, crypto::hash& res) {
+      blobdata blob;
+      if (!get_header_hashing_blob(header, treeRootHash, transactionCount, blob)) {
+        return false;
+      }
+
+      if (BLOCK_MAJOR_VERSION_2 <= header.majorVersion) {
+        blobdata parent_blob;
+        auto serializer = makeParentBlockSerializer(header, parentBlock, true, false);
+        if (!t_serializable_object_to_blob(serializer, parent_blob))
+          return false;
+
+        blob.append(parent_blob);
+      }
+
+      return get_object_hash(blob, res);
+    }
+  }
   //---------------------------------------------------------------
   void get_transaction_prefix_hash(const TransactionPrefix& tx, crypto::hash& h)
   {
@@ -588,14 +623,7 @@ namespace cryptonote
   }
   //---------------------------------------------------------------
   bool get_block_hashing_blob(const Block& b, blobdata& blob) {
-    if (!t_serializable_object_to_blob(static_cast<const BlockHeader&>(b), blob)) {
-      return false;
-    }
-    crypto::hash tree_root_hash = get_tx_tree_hash(b);
-    blob.append(reinterpret_cast<const char*>(&tree_root_hash), sizeof(tree_root_hash));
-    blob.append(tools::get_varint_data(b.txHashes.size() + 1));
-
-    return true;
+    return get_header_hashing_blob(b, get_tx_tree_hash(b), b.txHashes.size() + 1, blob);
   }
   //---------------------------------------------------------------
   bool get_parent_block_hashing_blob(const Block& b, blobdata& blob) {
@@ -604,21 +632,7 @@ namespace cryptonote
   }
   //---------------------------------------------------------------
   bool get_block_hash(const Block& b, crypto::hash& res) {
-    blobdata blob;
-    if (!get_block_hashing_blob(b, blob)) {
-      return false;
-    }
-
-    if (BLOCK_MAJOR_VERSION_2 <= b.majorVersion) {
-      blobdata parent_blob;
-      auto serializer = makeParentBlockSerializer(b, true, false);
-      if (!t_serializable_object_to_blob(serializer, parent_blob))
-        return false;
-
-      blob.append(parent_blob);
-    }
-
-    return get_object_hash(blob, res);
+    return get_header_hash(b, b.parentBlock, get_tx_tree_hash(b), b.txHashes.size() + 1, res);
   }
   //---------------------------------------------------------------
   crypto::hash get_block_hash(const Block& b) {
@@ -638,19 +652,93 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool get_block_longhash(crypto::cn_context &context, const Block& b, crypto::hash& res) {
     blobdata bd;
+    size_t nonceOffset;
+    if (!get_block_longhash_blob(b, bd, nonceOffset)) {
+      return false;
+    }
+    crypto::cn_slow_hash(context, bd.data(), bd.size(), res);
+    return true;
+  }
+  //---------------------------------------------------------------
+  bool get_block_longhash_blob(const Block& b, blobdata& blob, size_t& nonceOffset) {
+    blob.clear();
     if (b.majorVersion == BLOCK_MAJOR_VERSION_1) {
-      if (!get_block_hashing_blob(b, bd)) {
+      if (!get_block_hashing_blob(b, blob)) {
         return false;
       }
     } else if (b.majorVersion == BLOCK_MAJOR_VERSION_2) {
-      if (!get_parent_block_hashing_blob(b, bd)) {
+      if (!get_parent_block_hashing_blob(b, blob)) {
         return false;
       }
     } else {
       return false;
     }
-    crypto::cn_slow_hash(context, bd.data(), bd.size(), res);
-    return true;
+
+    return get_longhash_blob_nonce_offset(blob, nonceOffset);
+  }
+  //---------------------------------------------------------------
+  bool get_longhash_blob_nonce_offset(const blobdata& blob, size_t& nonceOffset) {
+    // block and parent block headers both start with major version, minor version and timestamp varints,
+    // followed by the previous block id and the nonce
+    blobdata::const_iterator it = blob.begin();
+    blobdata::const_iterator end = blob.end();
+    for (size_t i = 0; i < 3; ++i) {
+      uint64_t value;
+      if (tools::read_varint<std::numeric_limits<uint64_t>::digits>(it, end, value) <= 0) {
+        return false;
+      }
+    }
+
+    nonceOffset = (it - blob.begin()) + sizeof(crypto::hash);
+    return nonceOffset + sizeof(uint32_t) <= blob.size();
+  }
+  //---------------------------------------------------------------
+  BlockShortHeader get_block_short_header(const Block& b) {
+    BlockShortHeader header;
+    static_cast<BlockHeader&>(header) = b;
+    header.parentBlock = b.parentBlock;
+    header.merkleRoot = get_tx_tree_hash(b);
+    header.transactionCount = b.txHashes.size() + 1;
+    return header;
+  }
+  //---------------------------------------------------------------
+  bool get_aux_block_header_hash(const BlockShortHeader& header, crypto::hash& res) {
+    blobdata blob;
+    if (!get_header_hashing_blob(header, header.merkleRoot, header.transactionCount, blob)) {
+      return false;
+    }
+
+    return get_object_hash(blob, res);
+  }
+  //---------------------------------------------------------------
+  bool get_block_hash(const BlockShortHeader& header, crypto::hash& res) {
+    return get_header_hash(header, header.parentBlock, header.merkleRoot, header.transactionCount, res);
+  }
+  //---------------------------------------------------------------
+  bool get_block_longhash_blob(const BlockShortHeader& header, blobdata& blob, size_t& nonceOffset) {
+    blob.clear();
+    if (header.majorVersion == BLOCK_MAJOR_VERSION_1) {
+      if (!get_header_hashing_blob(header, header.merkleRoot, header.transactionCount, blob)) {
+        return false;
+      }
+    } else if (header.majorVersion == BLOCK_MAJOR_VERSION_2) {
+      auto serializer = makeParentBlockSerializer(header, header.parentBlock, true, true);
+      if (!t_serializable_object_to_blob(serializer, blob)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+
+    return get_longhash_blob_nonce_offset(blob, nonceOffset);
+  }
+  //---------------------------------------------------------------
+  void set_longhash_blob_nonce(blobdata& blob, size_t nonceOffset, uint32_t nonce) {
+    assert(nonceOffset + sizeof(nonce) <= blob.size());
+    // same byte order as the binary archive uses for the nonce field
+    for (size_t i = 0; i < sizeof(nonce); ++i) {
+      blob[nonceOffset + i] = static_cast<char>(nonce >> (8 * i));
+    }
   }
   //---------------------------------------------------------------
   std::vector<uint64_t> relative_output_offsets_to_absolute(const std::vector<uint64_t>& off)
@@ -683,6 +771,16 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------
+  bool parse_and_validate_block_short_header_from_blob(const blobdata& blob, BlockShortHeader& header)
+  {
+    std::stringstream ss;
+    ss << blob;
+    binary_archive<false> ba(ss);
+    bool r = ::serialization::serialize(ba, header);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to parse block header from blob");
+    return true;
+  }
+  //---------------------------------------------------------------
   blobdata block_to_blob(const Block& b)
   {
     return t_serializable_object_to_blob(b);
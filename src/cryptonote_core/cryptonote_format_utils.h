@@ -101,7 +101,16 @@ namespace cryptonote
   bool get_block_hash(const Block& b, crypto::hash& res);
   crypto::hash get_block_hash(const Block& b);
   bool get_block_longhash(crypto::cn_context &context, const Block& b, crypto::hash& res);
+  // Blob hashed by the proof of work, serialized once so miners can patch the nonce at nonceOffset between hashes
+  bool get_block_longhash_blob(const Block& b, blobdata& blob, size_t& nonceOffset);
+  bool get_longhash_blob_nonce_offset(const blobdata& blob, size_t& nonceOffset);
+  BlockShortHeader get_block_short_header(const Block& b);
+  bool get_aux_block_header_hash(const BlockShortHeader& header, crypto::hash& res);
+  bool get_block_hash(const BlockShortHeader& header, crypto::hash& res);
+  bool get_block_longhash_blob(const BlockShortHeader& header, blobdata& blob, size_t& nonceOffset);
+  void set_longhash_blob_nonce(blobdata& blob, size_t nonceOffset, uint32_t nonce);
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, Block& b);
+  bool parse_and_validate_block_short_header_from_blob(const blobdata& blob, BlockShortHeader& header);
   bool get_inputs_money_amount(const Transaction& tx, uint64_t& money);
   uint64_t get_outs_money_amount(const Transaction& tx);
   bool check_inputs_types_supported(const Transaction& tx);
@@ -26,5 +26,14 @@ namespace cryptonote
 {
     typedef std::uint64_t difficulty_type;
 
+    // timestamps and cumulative difficulties the difficulty of the block following lastBlockId is computed from,
+    // carried over from one checked part of a chain to the next one
+    struct DifficultyWindow {
+      crypto::hash lastBlockId;
+      uint64_t lastBlockHeight;
+      std::vector<uint64_t> timestamps;
+      std::vector<difficulty_type> cumulativeDifficulties;
+    };
+
     bool check_hash(const crypto::hash &hash, difficulty_type difficulty);
 }
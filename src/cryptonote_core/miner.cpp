@@ -287,20 +287,22 @@ namespace cryptonote
       std::atomic<uint32_t> foundNonce;
       std::atomic<bool> found(false);
       uint32_t startNonce = crypto::rand<uint32_t>();
+      blobdata hashingBlob;
+      size_t nonceOffset;
+      if (!get_block_longhash_blob(bl, hashingBlob, nonceOffset)) {
+        return false;
+      }
 
       for (unsigned i = 0; i < nthreads; ++i) {
         threads[i] = std::async(std::launch::async, [&, i]() {
           crypto::cn_context localctx;
           crypto::hash h;
 
-          Block lb(bl); // copy to local block
+          blobdata localBlob(hashingBlob); // only the nonce changes between hashes
 
           for (uint32_t nonce = startNonce + i; !found; nonce += nthreads) {
-            lb.nonce = nonce;
-
-            if (!get_block_longhash(localctx, lb, h)) {
-              return;
-            }
+            set_longhash_blob_nonce(localBlob, nonceOffset, nonce);
+            crypto::cn_slow_hash(localctx, localBlob.data(), localBlob.size(), h);
 
             if (check_hash(h, diffic)) {
               foundNonce = nonce;
@@ -321,11 +323,16 @@ namespace cryptonote
 
       return found;
     } else {
+      blobdata hashingBlob;
+      size_t nonceOffset;
+      if (!get_block_longhash_blob(bl, hashingBlob, nonceOffset)) {
+        return false;
+      }
+
       for (; bl.nonce != std::numeric_limits<uint32_t>::max(); bl.nonce++) {
         crypto::hash h;
-        if (!get_block_longhash(context, bl, h)) {
-          return false;
-        }
+        set_longhash_blob_nonce(hashingBlob, nonceOffset, bl.nonce);
+        crypto::cn_slow_hash(context, hashingBlob.data(), hashingBlob.size(), h);
 
         if (check_hash(h, diffic)) {
           return true;
@@ -377,7 +384,11 @@ namespace cryptonote
     difficulty_type local_diff = 0;
     uint32_t local_template_ver = 0;
     crypto::cn_context context;
+    LOG_PRINT_L0("Scratchpad allocated with " << crypto::cn_context::allocation_mode_name(context.get_allocation_mode()) <<
+      ", NUMA node " << context.get_numa_node());
     Block b;
+    blobdata hashingBlob;
+    size_t nonceOffset = 0;
     while(!m_stop)
     {
       if(m_pausers_count)//anti split workaround
@@ -395,6 +406,13 @@ namespace cryptonote
         CRITICAL_REGION_END();
         local_template_ver = m_template_no;
         nonce = m_starter_nonce + th_local_index;
+
+        // the template is serialized once, only its nonce is patched for each hash
+        if (local_template_ver && !get_block_longhash_blob(b, hashingBlob, nonceOffset)) {
+          LOG_ERROR("Failed to get block long hash blob");
+          m_stop = true;
+          continue;
+        }
       }
 
       if(!local_template_ver)//no any set_block_template call
@@ -404,16 +422,14 @@ namespace cryptonote
         continue;
       }
 
-      b.nonce = nonce;
       crypto::hash h;
-      if (!m_stop && !get_block_longhash(context, b, h)) {
-        LOG_ERROR("Failed to get block long hash");
-        m_stop = true;
-      }
+      set_longhash_blob_nonce(hashingBlob, nonceOffset, nonce);
+      crypto::cn_slow_hash(context, hashingBlob.data(), hashingBlob.size(), h);
 
       if (!m_stop && check_hash(h, local_diff))
       {
         //we lucky!
+        b.nonce = nonce;
         ++m_config.current_extra_message_index;
         LOG_PRINT_GREEN("Found block for difficulty: " << local_diff, LOG_LEVEL_0);
         if(!m_phandler->handle_block_found(b))
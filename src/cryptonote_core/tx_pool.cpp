@@ -104,7 +104,17 @@ namespace cryptonote {
     m_validator(validator), 
     m_timeProvider(timeProvider), 
     m_txCheckInterval(60, timeProvider),
-    m_fee_index(boost::get<1>(m_transactions)) {
+    m_fee_index(boost::get<1>(m_transactions)),
+    m_expiry_index(boost::get<2>(m_transactions)),
+    m_transactionsSize(0),
+    m_maxSize(parameters::CRYPTONOTE_MEMPOOL_DEFAULT_MAX_SIZE),
+    m_evictionStatistics(),
+    m_blockTemplateMaxSize(0),
+    m_blockTemplateSize(0),
+    m_blockTemplateFee(0) {
+  }
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::~tx_memory_pool() {
   }
 
   //---------------------------------------------------------------------------------
@@ -166,6 +176,26 @@ namespace cryptonote {
 
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
+    // inputs were checked without the lock, so the same transaction or a conflicting one could be added meanwhile
+    if (m_transactions.count(id)) {
+      LOG_PRINT_L2("tx " << id << " is already in transaction pool");
+      return true;
+    }
+
+    if (!keptByBlock && haveSpentInputs(tx)) {
+      LOG_PRINT_L0("Transaction with id= " << id << " used already spent inputs");
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
+
+    // as well as a block spending the same key images; blocks are added with the pool locked, so none can come now
+    if (!keptByBlock && m_validator.haveSpentKeyImages(tx)) {
+      LOG_PRINT_L0("Transaction with id= " << id << " used inputs spent in the blockchain");
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
+
+    tx_container_t::iterator insertedTransaction;
     // add to pool
     {
       TransactionDetails txd;
@@ -180,8 +210,16 @@ namespace cryptonote {
       txd.maxUsedBlock = maxUsedBlock;
       txd.lastFailedBlock.clear();
 
+      if (!keptByBlock && !evictTransactions(&txd)) {
+        LOG_PRINT_L1("Transaction with id= " << id << " rejected, tx pool is full and the transaction fee is too small");
+        ++m_evictionStatistics.rejectedCount;
+        return false;
+      }
+
       auto txd_p = m_transactions.insert(std::move(txd));
       CHECK_AND_ASSERT_MES(txd_p.second, false, "transaction already exists at inserting in memory pool");
+      insertedTransaction = txd_p.first;
+      m_transactionsSize += blobSize;
     }
 
     tvc.m_added_to_pool = true;
@@ -194,6 +232,8 @@ namespace cryptonote {
     if (!addTransactionInputs(id, tx, keptByBlock))
       return false;
 
+    updateBlockTemplate(insertedTransaction);
+
     tvc.m_verifivation_failed = false;
     //succeed
     return true;
@@ -219,6 +259,8 @@ namespace cryptonote {
     blobSize = txd.blobSize;
     fee = txd.fee;
 
+    // the transaction is taken to a block, so the others spending the same key images can't get to the chain anymore
+    invalidateConflictingTransactions(id, txd.tx);
     removeTransaction(it);
     return true;
   }
@@ -228,6 +270,16 @@ namespace cryptonote {
     return m_transactions.size();
   }
   //---------------------------------------------------------------------------------
+  size_t tx_memory_pool::get_transactions_size() const {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    return m_transactionsSize;
+  }
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::EvictionStatistics tx_memory_pool::get_eviction_statistics() const {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    return m_evictionStatistics;
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::get_transactions(std::list<Transaction>& txs) const {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     for (const auto& tx_vt : m_transactions) {
@@ -236,10 +288,37 @@ namespace cryptonote {
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id) {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+
+    // ready transactions stay ready on a longer chain, conflicts with the new block are dropped by take_tx,
+    // while failed ones could become valid, their check is cheap as long as lastFailedBlock stays in the chain
+    for (auto it = m_checkedTransactions.begin(); it != m_checkedTransactions.end();) {
+      if (it->second) {
+        ++it;
+      } else {
+        it = m_checkedTransactions.erase(it);
+      }
+    }
+
+    m_blockTemplate.reset();
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const crypto::hash& top_block_id) {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+
+    // only transactions which used outputs of the popped blocks have to be verified again, the popped key images
+    // could make failed transactions valid
+    for (auto it = m_checkedTransactions.begin(); it != m_checkedTransactions.end();) {
+      auto txIt = m_transactions.find(it->first);
+      if (it->second && txIt != m_transactions.end() && txIt->maxUsedBlock.height < new_block_height) {
+        ++it;
+      } else {
+        it = m_checkedTransactions.erase(it);
+      }
+    }
+
+    m_blockTemplate.reset();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -272,6 +351,100 @@ namespace cryptonote {
     return true;
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::isTransactionReady(tx_container_t::iterator i) {
+    auto checked = m_checkedTransactions.find(i->id);
+    if (checked != m_checkedTransactions.end()) {
+      return checked->second;
+    }
+
+    TransactionCheckInfo checkInfo(*i);
+    bool ready = is_transaction_ready_to_go(i->tx, checkInfo);
+
+    // update item state
+    m_transactions.modify(i, [&checkInfo](TransactionCheckInfo& item) {
+      item = checkInfo;
+    });
+
+    m_checkedTransactions.insert(std::make_pair(i->id, ready));
+    return ready;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::invalidateConflictingTransactions(const crypto::hash& id, const Transaction& tx) {
+    for (const auto& in : tx.vin) {
+      if (in.type() != typeid(TransactionInputToKey)) {
+        continue;
+      }
+
+      auto it = m_spent_key_images.find(boost::get<TransactionInputToKey>(in).keyImage);
+      if (it == m_spent_key_images.end()) {
+        continue;
+      }
+
+      for (const auto& conflictingId : it->second) {
+        if (conflictingId != id) {
+          m_checkedTransactions.erase(conflictingId);
+          if (isInBlockTemplate(conflictingId)) {
+            m_blockTemplate.reset();
+          }
+        }
+      }
+    }
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::buildBlockTemplate(size_t maxTotalSize) {
+    m_blockTemplate.reset(new BlockTemplate());
+    m_blockTemplateMaxSize = maxTotalSize;
+    m_blockTemplateSize = 0;
+    m_blockTemplateFee = 0;
+
+    for (auto i = m_fee_index.begin(); i != m_fee_index.end(); ++i) {
+      addToBlockTemplate(m_transactions.project<0>(i));
+    }
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::addToBlockTemplate(tx_container_t::iterator i) {
+    const auto& txd = *i;
+    if (m_blockTemplateMaxSize < m_blockTemplateSize + txd.blobSize) {
+      return false;
+    }
+
+    if (!isTransactionReady(i) || !m_blockTemplate->addTransaction(txd.id, txd.tx)) {
+      return false;
+    }
+
+    m_blockTemplateSize += txd.blobSize;
+    m_blockTemplateFee += txd.fee;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::updateBlockTemplate(tx_container_t::iterator i) {
+    if (!m_blockTemplate) {
+      return;
+    }
+
+    // the template is built greedily in the fee order, so a transaction ranked after all selected ones is considered
+    // when nothing else can be added and can just be appended, otherwise it may displace some of them
+    const auto& selected = m_blockTemplate->getTransactions();
+    if (!selected.empty()) {
+      auto last = m_transactions.find(selected.back());
+      if (last == m_transactions.end() || !TransactionPriorityComparator()(*last, *i)) {
+        m_blockTemplate.reset();
+        return;
+      }
+    }
+
+    addToBlockTemplate(i);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::isInBlockTemplate(const crypto::hash& id) const {
+    if (!m_blockTemplate) {
+      return false;
+    }
+
+    const auto& selected = m_blockTemplate->getTransactions();
+    return std::find(selected.begin(), selected.end(), id) != selected.end();
+  }
+  //---------------------------------------------------------------------------------
   std::string tx_memory_pool::print_pool(bool short_format) const {
     std::stringstream ss;
     CRITICAL_REGION_LOCAL(m_transactions_lock);
@@ -297,43 +470,24 @@ namespace cryptonote {
                                            uint64_t already_generated_coins, size_t& total_size, uint64_t& fee) {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
-    total_size = 0;
-    fee = 0;
-
     size_t max_total_size = (125 * median_size) / 100 - m_currency.minerTxBlobReservedSize();
     max_total_size = std::min(max_total_size, maxCumulativeSize);
 
-    BlockTemplate blockTemplate;
-
-    for (auto i = m_fee_index.begin(); i != m_fee_index.end(); ++i) {
-      const auto& txd = *i;
-
-      if (max_total_size < total_size + txd.blobSize) {
-        continue;
-      }
-
-      TransactionCheckInfo checkInfo(txd);
-      bool ready = is_transaction_ready_to_go(txd.tx, checkInfo);
-
-      // update item state
-      m_fee_index.modify(i, [&checkInfo](TransactionCheckInfo& item) {
-        item = checkInfo;
-      });
-      
-      if (ready && blockTemplate.addTransaction(txd.id, txd.tx)) {
-        total_size += txd.blobSize;
-        fee += txd.fee;
-      }
+    if (!m_blockTemplate || m_blockTemplateMaxSize != max_total_size) {
+      buildBlockTemplate(max_total_size);
     }
 
-    bl.txHashes = blockTemplate.getTransactions();
+    bl.txHashes = m_blockTemplate->getTransactions();
+    total_size = m_blockTemplateSize;
+    fee = m_blockTemplateFee;
     return true;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::init(const std::string& config_folder) {
+  bool tx_memory_pool::init(const std::string& config_folder, size_t maxSize) {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
     m_config_folder = config_folder;
+    m_maxSize = maxSize;
     std::string state_file_path = config_folder + "/" + m_currency.txPoolFileName();
     boost::system::error_code ec;
     if (!boost::filesystem::exists(state_file_path, ec)) {
@@ -347,6 +501,17 @@ namespace cryptonote {
       m_spent_key_images.clear();
       m_spentOutputs.clear();
     }
+
+    m_checkedTransactions.clear();
+    m_blockTemplate.reset();
+
+    m_transactionsSize = 0;
+    for (const auto& txd : m_transactions) {
+      m_transactionsSize += txd.blobSize;
+    }
+
+    // the limit could be lowered since the pool was saved
+    evictTransactions(nullptr);
     // Ignore deserialization error
     return true;
   }
@@ -375,26 +540,75 @@ namespace cryptonote {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     
     auto now = m_timeProvider.now();
+    removeExpiredTransactions(false, now);
+    removeExpiredTransactions(true, now);
+    return true;
+  }
 
-    for (auto it = m_transactions.begin(); it != m_transactions.end();) {
-      uint64_t txAge = now - it->receiveTime;
-      bool remove = txAge > (it->keptByBlock ? m_currency.mempoolTxFromAltBlockLiveTime() : m_currency.mempoolTxLiveTime());
-
-      if (remove) {
-        LOG_PRINT_L2("Tx " << it->id << " removed from tx pool due to outdated, age: " << txAge);
-        it = removeTransaction(it);
-      } else {
-        ++it;
-      }
+  void tx_memory_pool::removeExpiredTransactions(bool keptByBlock, time_t now) {
+    uint64_t liveTime = keptByBlock ? m_currency.mempoolTxFromAltBlockLiveTime() : m_currency.mempoolTxLiveTime();
+    time_t oldestLiveTime = now - static_cast<time_t>(liveTime);
+
+    // only the expired transactions are visited, they are the oldest ones of their kind
+    auto it = m_expiry_index.lower_bound(boost::make_tuple(keptByBlock));
+    auto end = m_expiry_index.lower_bound(boost::make_tuple(keptByBlock, oldestLiveTime));
+    while (it != end) {
+      auto expired = m_transactions.project<0>(it++);
+      LOG_PRINT_L2("Tx " << expired->id << " removed from tx pool due to outdated, age: " << (now - expired->receiveTime));
+      removeTransaction(expired);
     }
-    return true;
   }
 
   tx_memory_pool::tx_container_t::iterator tx_memory_pool::removeTransaction(tx_memory_pool::tx_container_t::iterator i) {
+    // removing a transaction which was not selected doesn't change the selection of the others
+    if (isInBlockTemplate(i->id)) {
+      m_blockTemplate.reset();
+    }
+
+    m_checkedTransactions.erase(i->id);
     removeTransactionInputs(i->id, i->tx, i->keptByBlock);
+    m_transactionsSize -= i->blobSize;
     return m_transactions.erase(i);
   }
 
+  bool tx_memory_pool::evictTransactions(const TransactionDetails* incoming) {
+    const size_t maxSize = m_maxSize;
+    size_t requiredSize = m_transactionsSize + (incoming != nullptr ? incoming->blobSize : 0);
+    if (requiredSize <= maxSize) {
+      return true;
+    }
+
+    // the lowest paying transactions go first, the ones kept by blocks are needed to switch to alternative chains,
+    // the incoming transaction is rejected instead of evicting transactions which pay at least as much
+    std::vector<crypto::hash> evicted;
+    for (auto i = m_fee_index.rbegin(); i != m_fee_index.rend() && requiredSize > maxSize; ++i) {
+      if (i->keptByBlock) {
+        continue;
+      }
+
+      if (incoming != nullptr && !TransactionPriorityComparator()(*incoming, *i)) {
+        return false;
+      }
+
+      evicted.push_back(i->id);
+      requiredSize -= i->blobSize;
+    }
+
+    if (requiredSize > maxSize) {
+      return false;
+    }
+
+    for (const auto& id : evicted) {
+      auto it = m_transactions.find(id);
+      LOG_PRINT_L2("Tx " << id << " evicted from full tx pool, fee: " << m_currency.formatAmount(it->fee) << ", blobSize: " << it->blobSize);
+      ++m_evictionStatistics.evictedCount;
+      m_evictionStatistics.evictedSize += it->blobSize;
+      removeTransaction(it);
+    }
+
+    return true;
+  }
+
   bool tx_memory_pool::removeTransactionInputs(const crypto::hash& tx_id, const Transaction& tx, bool keptByBlock) {
     for (const auto& in : tx.vin) {
       if (in.type() == typeid(TransactionInputToKey)) {
@@ -18,6 +18,7 @@
 #pragma once
 #include "include_base_utils.h"
 
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -27,6 +28,7 @@
 
 // multi index
 #include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/member.hpp>
@@ -78,16 +80,26 @@ namespace cryptonote {
   using CryptoNote::BlockInfo;
   using namespace boost::multi_index;
 
+  class BlockTemplate;
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
   class tx_memory_pool: boost::noncopyable {
   public:
+    struct EvictionStatistics {
+      uint64_t evictedCount;
+      uint64_t evictedSize;
+      // transactions not admitted to the full pool, as they pay less than all of the evictable ones
+      uint64_t rejectedCount;
+    };
+
     tx_memory_pool(const cryptonote::Currency& currency, CryptoNote::ITransactionValidator& validator,
       CryptoNote::ITimeProvider& timeProvider);
+    ~tx_memory_pool();
 
     // load/store operations
-    bool init(const std::string& config_folder);
+    bool init(const std::string& config_folder, size_t maxSize);
     bool deinit();
 
     bool have_tx(const crypto::hash &id) const;
@@ -96,6 +108,7 @@ namespace cryptonote {
     //gets tx and remove it from pool
     bool take_tx(const crypto::hash &id, Transaction &tx, size_t& blobSize, uint64_t& fee);
 
+    // must be called after each change of the main chain, new_block_height is the height of the chain after the change
     bool on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id);
     bool on_blockchain_dec(uint64_t new_block_height, const crypto::hash& top_block_id);
 
@@ -106,6 +119,9 @@ namespace cryptonote {
 
     void get_transactions(std::list<Transaction>& txs) const;
     size_t get_transactions_count() const;
+    // total size of transaction blobs, limited by the size given to init, except for transactions kept by blocks
+    size_t get_transactions_size() const;
+    EvictionStatistics get_eviction_statistics() const;
     std::string print_pool(bool short_format) const;
     void on_idle();
 
@@ -123,7 +139,7 @@ namespace cryptonote {
       }
     }
 
-#define CURRENT_MEMPOOL_ARCHIVE_VER    10
+#define CURRENT_MEMPOOL_ARCHIVE_VER    11
 
     template<class archive_t>
     void serialize(archive_t & a, const unsigned int version) {
@@ -176,9 +192,14 @@ namespace cryptonote {
 
     typedef hashed_unique<BOOST_MULTI_INDEX_MEMBER(TransactionDetails, crypto::hash, id)> main_index_t;
     typedef ordered_non_unique<identity<TransactionDetails>, TransactionPriorityComparator> fee_index_t;
+    // transactions kept by blocks live longer, so each kind is ordered by receive time separately
+    typedef ordered_non_unique<composite_key<TransactionDetails,
+      BOOST_MULTI_INDEX_MEMBER(TransactionDetails, bool, keptByBlock),
+      BOOST_MULTI_INDEX_MEMBER(TransactionDetails, time_t, receiveTime)
+    > > expiry_index_t;
 
     typedef multi_index_container<TransactionDetails,
-      indexed_by<main_index_t, fee_index_t>
+      indexed_by<main_index_t, fee_index_t, expiry_index_t>
     > tx_container_t;
 
     typedef std::pair<uint64_t, uint64_t> GlobalOutput;
@@ -192,8 +213,17 @@ namespace cryptonote {
     bool removeTransactionInputs(const crypto::hash& id, const Transaction& tx, bool keptByBlock);
 
     tx_container_t::iterator removeTransaction(tx_container_t::iterator i);
+    bool evictTransactions(const TransactionDetails* incoming);
     bool removeExpiredTransactions();
+    void removeExpiredTransactions(bool keptByBlock, time_t now);
     bool is_transaction_ready_to_go(const Transaction& tx, TransactionCheckInfo& txd) const;
+    bool isTransactionReady(tx_container_t::iterator i);
+    void invalidateConflictingTransactions(const crypto::hash& id, const Transaction& tx);
+
+    void buildBlockTemplate(size_t maxTotalSize);
+    bool addToBlockTemplate(tx_container_t::iterator i);
+    void updateBlockTemplate(tx_container_t::iterator i);
+    bool isInBlockTemplate(const crypto::hash& id) const;
 
     const cryptonote::Currency& m_currency;
     OnceInTimeInterval m_txCheckInterval;
@@ -207,6 +237,19 @@ namespace cryptonote {
 
     tx_container_t m_transactions;  
     tx_container_t::nth_index<1>::type& m_fee_index;
+    tx_container_t::nth_index<2>::type& m_expiry_index;
+    size_t m_transactionsSize;
+    size_t m_maxSize;
+    EvictionStatistics m_evictionStatistics;
+
+    // results of is_transaction_ready_to_go, kept until a change of the chain or of the pool can invalidate them
+    std::unordered_map<crypto::hash, bool> m_checkedTransactions;
+    // transactions selected by the last fill_block_template call, updated as the pool changes and rebuilt only
+    // when an update could change the selection of the transactions already in it
+    std::unique_ptr<BlockTemplate> m_blockTemplate;
+    size_t m_blockTemplateMaxSize;
+    size_t m_blockTemplateSize;
+    uint64_t m_blockTemplateFee;
 
 #if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
     friend class blockchain_storage;
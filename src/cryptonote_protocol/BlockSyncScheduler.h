@@ -0,0 +1,376 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/uuid/uuid.hpp>
+
+#include "crypto/hash.h"
+#include "cryptonote_protocol_defs.h"
+
+namespace cryptonote
+{
+  // Plans the download of the blocks needed during synchronization from all the peers ahead of us. Block ids from chain
+  // entries are kept in the order the blocks are imported in, along with the peers which announced them. Each peer is
+  // given batches of the pending blocks it has near the start of the plan, requests not answered in time are given to
+  // other peers, and delivered blocks wait until all the blocks before them are delivered too. Batches are sized by
+  // the number of blocks each peer delivers per second.
+  class BlockSyncScheduler {
+
+  public:
+
+    typedef boost::uuids::uuid PeerId;
+
+    struct PeerStatistics {
+      size_t batchSize;
+      size_t requestedCount;
+      size_t announcedCount;
+      uint64_t receivedBytes;
+      uint64_t throughput; // bytes per second of the last answered request
+    };
+
+    BlockSyncScheduler(size_t maxBatchSize, size_t windowSize, time_t requestTimeout) :
+      m_maxBatchSize(maxBatchSize), m_windowSize(windowSize), m_requestTimeout(requestTimeout), m_firstSequence(0) {
+    }
+
+    // appends the ids missing from the plan and records the peer as having all of them, returns the count of new ids
+    size_t addBlocks(const PeerId& peer, const std::list<crypto::hash>& ids) {
+      PeerState& state = getPeer(peer);
+      size_t added = 0;
+      for (const crypto::hash& id : ids) {
+        Entry* entry = findEntry(id);
+        if (entry == nullptr) {
+          m_index.insert(std::make_pair(id, m_firstSequence + m_entries.size()));
+          m_entries.push_back(Entry());
+          entry = &m_entries.back();
+          entry->id = id;
+          entry->state = PENDING;
+          ++added;
+        }
+
+        if (std::find(entry->sources.begin(), entry->sources.end(), peer) == entry->sources.end()) {
+          entry->sources.push_back(peer);
+          ++state.announcedCount;
+        }
+      }
+
+      return added;
+    }
+
+    // assigns the peer a batch of pending blocks it has, unless it still has a request to answer
+    bool requestBlocks(const PeerId& peer, time_t now, std::list<crypto::hash>& ids) {
+      PeerState& state = getPeer(peer);
+      if (!state.requested.empty()) {
+        return false;
+      }
+
+      size_t end = std::min(m_entries.size(), m_windowSize);
+      for (size_t i = 0; i < end && ids.size() < state.batchSize; ++i) {
+        Entry& entry = m_entries[i];
+        if (entry.state == PENDING && std::find(entry.sources.begin(), entry.sources.end(), peer) != entry.sources.end()) {
+          entry.state = REQUESTED;
+          entry.peer = peer;
+          state.requested.insert(entry.id);
+          ids.push_back(entry.id);
+        }
+      }
+
+      if (ids.empty()) {
+        return false;
+      }
+
+      state.requestTime = now;
+      state.expired = false;
+      state.deliveredCount = 0;
+      return true;
+    }
+
+    // keeps the block with the block parsed from its blob, so that it is not parsed again on import; returns false if
+    // the block was not requested from the peer, blocks already delivered by others are ignored
+    bool deliverBlock(const PeerId& peer, const crypto::hash& id, block_complete_entry&& block, Block&& parsedBlock) {
+      PeerState& state = getPeer(peer);
+      if (state.requested.erase(id) == 0) {
+        return false;
+      }
+
+      ++state.deliveredCount;
+      Entry* entry = findEntry(id);
+      if (entry != nullptr && (entry->state == PENDING || entry->state == REQUESTED)) {
+        entry->state = DELIVERED;
+        entry->peer = peer;
+        entry->block = std::move(block);
+        entry->parsedBlock = std::move(parsedBlock);
+      }
+
+      return true;
+    }
+
+    // ends the request of the peer once its answer is delivered, blocks the peer reported missing are no longer
+    // requested from it; returns the count of requested blocks which were neither delivered nor reported missing
+    size_t completeRequest(const PeerId& peer, const std::list<crypto::hash>& missedIds, size_t receivedBytes, time_t now) {
+      PeerState& state = getPeer(peer);
+      for (const crypto::hash& id : missedIds) {
+        if (state.requested.erase(id) != 0) {
+          Entry* entry = findEntry(id);
+          if (entry != nullptr) {
+            removeSource(*entry, peer);
+            releaseEntry(*entry, peer);
+          }
+        }
+      }
+
+      size_t unanswered = state.requested.size();
+      for (const crypto::hash& id : state.requested) {
+        Entry* entry = findEntry(id);
+        if (entry != nullptr) {
+          releaseEntry(*entry, peer);
+        }
+      }
+
+      state.requested.clear();
+      time_t elapsed = std::max<time_t>(now - state.requestTime, 1);
+      state.receivedBytes += receivedBytes;
+      state.throughput = receivedBytes / elapsed;
+      if (!state.expired) {
+        // aim at answers taking half of the timeout
+        size_t batchSize = static_cast<size_t>(state.deliveredCount * m_requestTimeout / (2 * elapsed));
+        state.batchSize = std::max<size_t>(1, std::min(batchSize, m_maxBatchSize));
+      }
+
+      state.expired = false;
+      dropUnreachable();
+      return unanswered;
+    }
+
+    // blocks of requests older than the timeout are given back to be requested from other peers; the peers keep their
+    // requests until they answer, but get smaller batches afterwards. Returns the peers whose requests expired
+    std::vector<PeerId> expireRequests(time_t now) {
+      std::vector<PeerId> expired;
+      for (auto& peer : m_peers) {
+        PeerState& state = peer.second;
+        if (state.requested.empty() || state.expired || now - state.requestTime < m_requestTimeout) {
+          continue;
+        }
+
+        for (const crypto::hash& id : state.requested) {
+          Entry* entry = findEntry(id);
+          if (entry != nullptr) {
+            releaseEntry(*entry, peer.first);
+          }
+        }
+
+        state.expired = true;
+        state.batchSize = std::max<size_t>(1, state.batchSize / 2);
+        expired.push_back(peer.first);
+      }
+
+      return expired;
+    }
+
+    // moves out the delivered blocks at the start of the plan, in import order, with their parsed blocks and the peers
+    // which delivered them
+    size_t takeReadyBlocks(std::list<block_complete_entry>& blocks, std::vector<Block>& parsedBlocks, std::vector<crypto::hash>& ids, std::vector<PeerId>& suppliers) {
+      size_t count = 0;
+      for (Entry& entry : m_entries) {
+        if (entry.state != DELIVERED) {
+          break;
+        }
+
+        entry.state = IMPORTING;
+        blocks.push_back(std::move(entry.block));
+        entry.block = block_complete_entry();
+        parsedBlocks.push_back(std::move(entry.parsedBlock));
+        entry.parsedBlock = Block();
+        ids.push_back(entry.id);
+        suppliers.push_back(entry.peer);
+        ++count;
+      }
+
+      return count;
+    }
+
+    // removes the first imported blocks taken for import, the rest of them are downloaded again
+    void finishImport(size_t importedCount) {
+      for (size_t i = 0; i < importedCount && !m_entries.empty() && m_entries.front().state == IMPORTING; ++i) {
+        eraseFront();
+      }
+
+      for (Entry& entry : m_entries) {
+        if (entry.state != IMPORTING) {
+          break;
+        }
+
+        entry.state = PENDING;
+      }
+
+      dropUnreachable();
+    }
+
+    void removePeer(const PeerId& peer) {
+      for (Entry& entry : m_entries) {
+        removeSource(entry, peer);
+        releaseEntry(entry, peer);
+      }
+
+      m_peers.erase(peer);
+      dropUnreachable();
+    }
+
+    // the plan still has blocks the peer announced
+    bool hasBlocksOf(const PeerId& peer) const {
+      auto it = m_peers.find(peer);
+      return it != m_peers.end() && it->second.announcedCount != 0;
+    }
+
+    bool isRequesting(const PeerId& peer) const {
+      auto it = m_peers.find(peer);
+      return it != m_peers.end() && !it->second.requested.empty();
+    }
+
+    std::vector<PeerId> getPeers() const {
+      std::vector<PeerId> peers;
+      for (auto& peer : m_peers) {
+        peers.push_back(peer.first);
+      }
+
+      return peers;
+    }
+
+    PeerStatistics getPeerStatistics(const PeerId& peer) const {
+      PeerStatistics statistics = PeerStatistics();
+      auto it = m_peers.find(peer);
+      if (it != m_peers.end()) {
+        statistics.batchSize = it->second.batchSize;
+        statistics.requestedCount = it->second.requested.size();
+        statistics.announcedCount = it->second.announcedCount;
+        statistics.receivedBytes = it->second.receivedBytes;
+        statistics.throughput = it->second.throughput;
+      }
+
+      return statistics;
+    }
+
+    size_t size() const {
+      return m_entries.size();
+    }
+
+  private:
+
+    enum EntryState {
+      PENDING,
+      REQUESTED,
+      DELIVERED,
+      IMPORTING
+    };
+
+    struct Entry {
+      crypto::hash id;
+      EntryState state;
+      std::vector<PeerId> sources;
+      PeerId peer; // the peer the block is requested from or was delivered by
+      block_complete_entry block;
+      Block parsedBlock; // parsed from the blob when it was delivered
+    };
+
+    struct PeerState {
+      explicit PeerState(size_t batchSize) : batchSize(batchSize), announcedCount(0), requestTime(0), expired(false),
+        deliveredCount(0), receivedBytes(0), throughput(0) {
+      }
+
+      size_t batchSize;
+      size_t announcedCount;
+      std::unordered_set<crypto::hash> requested;
+      time_t requestTime;
+      bool expired;
+      size_t deliveredCount;
+      uint64_t receivedBytes;
+      uint64_t throughput;
+    };
+
+    PeerState& getPeer(const PeerId& peer) {
+      auto it = m_peers.find(peer);
+      if (it == m_peers.end()) {
+        it = m_peers.insert(std::make_pair(peer, PeerState(m_maxBatchSize))).first;
+      }
+
+      return it->second;
+    }
+
+    Entry* findEntry(const crypto::hash& id) {
+      auto it = m_index.find(id);
+      return it != m_index.end() ? &m_entries[it->second - m_firstSequence] : nullptr;
+    }
+
+    void removeSource(Entry& entry, const PeerId& peer) {
+      auto it = std::find(entry.sources.begin(), entry.sources.end(), peer);
+      if (it != entry.sources.end()) {
+        entry.sources.erase(it);
+        --m_peers.find(peer)->second.announcedCount;
+      }
+    }
+
+    void releaseEntry(Entry& entry, const PeerId& peer) {
+      if (entry.state == REQUESTED && entry.peer == peer) {
+        entry.state = PENDING;
+      }
+    }
+
+    void forgetEntry(const Entry& entry) {
+      for (const PeerId& source : entry.sources) {
+        --m_peers.find(source)->second.announcedCount;
+      }
+
+      m_index.erase(entry.id);
+    }
+
+    void eraseFront() {
+      forgetEntry(m_entries.front());
+      m_entries.pop_front();
+      ++m_firstSequence;
+    }
+
+    // a block no peer has any more cannot be downloaded, so the blocks after it cannot be imported either
+    void dropUnreachable() {
+      auto it = std::find_if(m_entries.begin(), m_entries.end(), [](const Entry& entry) {
+        return entry.sources.empty() && (entry.state == PENDING || entry.state == REQUESTED);
+      });
+
+      for (auto erased = it; erased != m_entries.end(); ++erased) {
+        forgetEntry(*erased);
+      }
+
+      m_entries.erase(it, m_entries.end());
+    }
+
+    size_t m_maxBatchSize;
+    size_t m_windowSize;
+    time_t m_requestTimeout;
+    std::deque<Entry> m_entries;
+    uint64_t m_firstSequence; // sequence number of the first entry, the index maps ids to sequence numbers
+    std::unordered_map<crypto::hash, uint64_t> m_index;
+    std::map<PeerId, PeerState> m_peers;
+  };
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <deque>
+#include <unordered_set>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  // Hashes of objects a peer is known to have, either because it sent them or because they were sent to it. Only the
+  // most recently inserted hashes are kept, the oldest ones are forgotten once the limit is reached.
+  class KnownHashes {
+
+  public:
+
+    explicit KnownHashes(size_t maxCount) : m_maxCount(maxCount) {
+    }
+
+    // returns false if the hash is already known
+    bool insert(const crypto::hash& hash) {
+      if (!m_hashes.insert(hash).second) {
+        return false;
+      }
+
+      m_order.push_back(hash);
+      if (m_order.size() > m_maxCount) {
+        m_hashes.erase(m_order.front());
+        m_order.pop_front();
+      }
+
+      return true;
+    }
+
+    bool contains(const crypto::hash& hash) const {
+      return m_hashes.count(hash) != 0;
+    }
+
+    size_t size() const {
+      return m_order.size();
+    }
+
+  private:
+
+    size_t m_maxCount;
+    std::unordered_set<crypto::hash> m_hashes;
+    std::deque<crypto::hash> m_order;
+  };
+}
@@ -27,6 +27,12 @@ namespace cryptonote
 
 #define BC_COMMANDS_POOL_BASE 2000
 
+// versions of the protocol, announced in CORE_SYNC_DATA; peers which do not announce any version are version 0
+#define BC_PROTOCOL_VERSION_TX_HASHES 1 // NOTIFY_NEW_TRANSACTION_HASHES, transactions fetched by NOTIFY_REQUEST_GET_OBJECTS
+#define BC_PROTOCOL_VERSION_BLOCK_HEADERS 2 // NOTIFY_REQUEST_BLOCK_HEADERS, headers of chain entries checked before the blocks are downloaded
+#define BC_PROTOCOL_VERSION_COMPACT_BLOCKS 3 // NOTIFY_NEW_COMPACT_BLOCK, transactions of new blocks taken from the pool or fetched by NOTIFY_REQUEST_GET_OBJECTS
+#define BC_CURRENT_PROTOCOL_VERSION BC_PROTOCOL_VERSION_COMPACT_BLOCKS
+
 
   /************************************************************************/
   /*                                                                      */
@@ -64,6 +70,28 @@ namespace cryptonote
     typedef NOTIFY_NEW_BLOCK_request request;
   };
 
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_NEW_COMPACT_BLOCK_request
+  {
+    block_complete_entry b; // only the transactions the receiver is not known to have, it takes the rest from its pool
+    uint64_t current_blockchain_height;
+    uint32_t hop;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(b)
+      KV_SERIALIZE(current_blockchain_height)
+      KV_SERIALIZE(hop)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+    typedef NOTIFY_NEW_COMPACT_BLOCK_request request;
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -82,6 +110,24 @@ namespace cryptonote
     typedef NOTIFY_NEW_TRANSACTIONS_request request;
   };
 
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_NEW_TRANSACTION_HASHES_request
+  {
+    std::list<crypto::hash> txs;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_NEW_TRANSACTION_HASHES
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 8;
+    typedef NOTIFY_NEW_TRANSACTION_HASHES_request request;
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -128,10 +174,12 @@ namespace cryptonote
   {
     uint64_t current_height;
     crypto::hash  top_id;
+    uint32_t protocol_version;
 
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(current_height)
       KV_SERIALIZE_VAL_POD_AS_BLOB(top_id)
+      KV_SERIALIZE(protocol_version)
     END_KV_SERIALIZE_MAP()
   };
 
@@ -168,4 +216,39 @@ namespace cryptonote
     typedef NOTIFY_RESPONSE_CHAIN_ENTRY_request request;
   };
 
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_BLOCK_HEADERS_request
+  {
+    std::list<crypto::hash> blocks;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(blocks)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_REQUEST_BLOCK_HEADERS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 9;
+    typedef NOTIFY_REQUEST_BLOCK_HEADERS_request request;
+  };
+
+  struct NOTIFY_RESPONSE_BLOCK_HEADERS_request
+  {
+    std::list<blobdata> headers; // serialized BlockShortHeader of each found block, in the order they were requested
+    std::list<crypto::hash> missed_ids;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(headers)
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(missed_ids)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct NOTIFY_RESPONSE_BLOCK_HEADERS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 10;
+    typedef NOTIFY_RESPONSE_BLOCK_HEADERS_request request;
+  };
+
 }
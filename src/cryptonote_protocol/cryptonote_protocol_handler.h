@@ -17,12 +17,23 @@
 
 #pragma once
 
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/make_shared.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <boost/uuid/uuid.hpp>
 
 #include "storages/levin_abstract_invoke2.h"
+#include "syncobj.h"
 #include "warnings.h"
 #include "cryptonote_protocol_defs.h"
 #include "cryptonote_protocol_handler_common.h"
+#include "BlockSyncScheduler.h"
+#include "KnownHashes.h"
 #include "cryptonote_core/connection_context.h"
 #include "cryptonote_core/cryptonote_stat_info.h"
 #include "cryptonote_core/verification_context.h"
@@ -46,11 +57,15 @@ namespace cryptonote
 
     BEGIN_INVOKE_MAP2(cryptonote_protocol_handler)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_BLOCK, &cryptonote_protocol_handler::handle_notify_new_block)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, &cryptonote_protocol_handler::handle_notify_new_compact_block)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_TRANSACTIONS, &cryptonote_protocol_handler::handle_notify_new_transactions)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_TRANSACTION_HASHES, &cryptonote_protocol_handler::handle_notify_new_transaction_hashes)
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_GET_OBJECTS, &cryptonote_protocol_handler::handle_request_get_objects)
       HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_GET_OBJECTS, &cryptonote_protocol_handler::handle_response_get_objects)
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_CHAIN, &cryptonote_protocol_handler::handle_request_chain)
       HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_CHAIN_ENTRY, &cryptonote_protocol_handler::handle_response_chain_entry)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_BLOCK_HEADERS, &cryptonote_protocol_handler::handle_request_block_headers)
+      HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_BLOCK_HEADERS, &cryptonote_protocol_handler::handle_response_block_headers)
     END_INVOKE_MAP2()
 
     bool on_idle();
@@ -69,11 +84,15 @@ namespace cryptonote
   private:
     //----------------- commands handlers ----------------------------------------------
     int handle_notify_new_block(int command, NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
     int handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_transaction_hashes(int command, NOTIFY_NEW_TRANSACTION_HASHES::request& arg, cryptonote_connection_context& context);
     int handle_request_get_objects(int command, NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context);
     int handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, cryptonote_connection_context& context);
     int handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, cryptonote_connection_context& context);
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, cryptonote_connection_context& context);
+    int handle_request_block_headers(int command, NOTIFY_REQUEST_BLOCK_HEADERS::request& arg, cryptonote_connection_context& context);
+    int handle_response_block_headers(int command, NOTIFY_RESPONSE_BLOCK_HEADERS::request& arg, cryptonote_connection_context& context);
 
 
     //----------------- i_bc_protocol_layout ---------------------------------------
@@ -81,9 +100,27 @@ namespace cryptonote
     virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context);
     //----------------------------------------------------------------------------------
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, cryptonote_connection_context& context);
-    bool request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks);
+    bool request_missing_objects(cryptonote_connection_context& context);
+    // requests the headers of the next unchecked blocks of the chain entry, they are checked before the blocks are downloaded
+    void request_block_headers(cryptonote_connection_context& context);
+    // imports the downloaded blocks which follow the chain without gaps, dropping connections which sent invalid ones
+    void import_downloaded_blocks();
+    // gives blocks of expired requests and of closed connections to other peers, and resumes waiting connections
+    void update_block_requests();
+    void drop_connection(const boost::uuids::uuid& connection_id);
     size_t get_synchronizing_connections_count();
     bool on_connection_synchronized();
+    int handle_response_transactions(NOTIFY_RESPONSE_GET_OBJECTS::request& arg, cryptonote_connection_context& context);
+    // adds a new block whose transactions are already handled, returns false if the connection is dropped
+    bool add_new_block(const blobdata& block_blob, block_verification_context& bvc, cryptonote_connection_context& context);
+    void expire_compact_blocks();
+    // verified transactions are queued and sent to peers by on_idle, the source connection is never sent them back
+    void queue_transactions_relay(const std::list<blobdata>& tx_blobs, const boost::uuids::uuid& source_connection_id);
+    void relay_queued_transactions();
+    // requests announced transactions again from their other announcers, once the request timed out, was missed or
+    // its connection closed
+    void update_transaction_requests();
+    KnownHashes& get_known_transactions(const boost::uuids::uuid& connection_id);
     t_core& m_core;
 
     nodetool::p2p_endpoint_stub<connection_context> m_p2p_stub;
@@ -91,6 +128,52 @@ namespace cryptonote
     std::atomic<uint32_t> m_syncronized_connections_count;
     std::atomic<bool> m_synchronized;
 
+    struct queued_transaction
+    {
+      crypto::hash id;
+      blobdata blob;
+      boost::uuids::uuid source_connection_id;
+    };
+
+    epee::critical_section m_relay_lock;
+    std::vector<queued_transaction> m_relay_queue;
+    // ids of transactions each connection has sent or has been sent, closed connections are dropped on relay
+    std::map<boost::uuids::uuid, KnownHashes> m_known_transactions;
+    struct requested_transaction
+    {
+      boost::uuids::uuid connection_id;
+      time_t request_time;
+      // other connections which announced the transaction, asked in turn if the request fails
+      std::list<boost::uuids::uuid> announcers;
+    };
+
+    // announced transactions requested from one peer at a time
+    std::unordered_map<crypto::hash, requested_transaction> m_requested_transactions;
+
+    struct pending_compact_block
+    {
+      NOTIFY_NEW_COMPACT_BLOCK::request arg;
+      std::vector<crypto::hash> tx_ids;
+      std::unordered_set<crypto::hash> missing_tx_ids;
+      time_t request_time;
+      size_t request_count;
+    };
+
+    // adds a compact block if all of its transactions are there and relays it with them, otherwise requests the missing
+    // ones from the sender, or the chain once they were requested too many times
+    void add_compact_block(pending_compact_block& block, cryptonote_connection_context& context);
+    // switches the connection to synchronization, which downloads the blocks missing here with their transactions
+    void request_chain(cryptonote_connection_context& context);
+
+    epee::critical_section m_compact_blocks_lock;
+    // compact blocks waiting for the transactions requested from the connections which sent them, one per connection
+    std::map<boost::uuids::uuid, pending_compact_block> m_pending_compact_blocks;
+
+    epee::critical_section m_sync_lock;
+    BlockSyncScheduler m_sync_scheduler;
+    // one thread at a time imports downloaded blocks, so they reach the core in order
+    bool m_importing_blocks;
+
     template<class t_parametr>
       bool post_notify(typename t_parametr::request& arg, cryptonote_connection_context& context)
       {
@@ -100,13 +183,13 @@ namespace cryptonote
         return m_p2p->invoke_notify_to_peer(t_parametr::ID, blob, context);
       }
 
-      template<class t_parametr>
-      bool relay_post_notify(typename t_parametr::request& arg, cryptonote_connection_context& exlude_context)
+      //the blob is moved into a buffer which send queues share without copying it
+      template<class t_request>
+      static epee::net_utils::shared_buffer store_shared_blob(t_request& arg)
       {
-        LOG_PRINT_L2("[" << epee::net_utils::print_connection_context_short(exlude_context) << "] post relay " << typeid(t_parametr).name() << " -->");
-        std::string arg_buff;
-        epee::serialization::store_t_to_binary(arg, arg_buff);
-        return m_p2p->relay_notify_to_all(t_parametr::ID, arg_buff, exlude_context);
+        std::string blob;
+        epee::serialization::store_t_to_binary(arg, blob);
+        return boost::make_shared<const std::string>(std::move(blob));
       }
   };
 }
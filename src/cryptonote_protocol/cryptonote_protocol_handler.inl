@@ -26,7 +26,9 @@ namespace cryptonote
     t_cryptonote_protocol_handler<t_core>::t_cryptonote_protocol_handler(t_core& rcore, nodetool::i_p2p_endpoint<connection_context>* p_net_layout):m_core(rcore), 
                                                                                                               m_p2p(p_net_layout),
                                                                                                               m_syncronized_connections_count(0),
-                                                                                                              m_synchronized(false)
+                                                                                                              m_synchronized(false),
+                                                                                                              m_sync_scheduler(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, BLOCKS_SYNCHRONIZING_WINDOW_SIZE, BLOCKS_SYNCHRONIZING_REQUEST_TIMEOUT),
+                                                                                                              m_importing_blocks(false)
 
   {
     if(!m_p2p)
@@ -70,6 +72,12 @@ namespace cryptonote
       LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
       post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
     }
+    else if(context.m_state == cryptonote_connection_context::state_idle)
+    {
+      //resumed by on_idle, other peers may have downloaded or given back the blocks it was waiting for
+      context.m_state = cryptonote_connection_context::state_synchronizing;
+      request_missing_objects(context);
+    }
 
     return true;
   }
@@ -110,7 +118,9 @@ namespace cryptonote
     if(context.m_state == cryptonote_connection_context::state_befor_handshake && !is_inital)
       return true;
 
-    if(context.m_state == cryptonote_connection_context::state_synchronizing)
+    context.m_protocol_version = hshd.protocol_version;
+
+    if(context.m_state == cryptonote_connection_context::state_synchronizing || context.m_state == cryptonote_connection_context::state_idle)
       return true;
 
     if(m_core.have_block(hshd.top_id))  
@@ -141,6 +151,7 @@ namespace cryptonote
   {
     m_core.get_blockchain_top(hshd.current_height, hshd.top_id);
     hshd.current_height +=1;
+    hshd.protocol_version = BC_CURRENT_PROTOCOL_VERSION;
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------  
@@ -171,27 +182,142 @@ namespace cryptonote
     }
 
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
-    m_core.handle_incoming_block_blob(arg.b.block, bvc, true, false);
-    if (bvc.m_verifivation_failed) {
-      LOG_PRINT_CCONTEXT_L1("Block verification failed, dropping connection");
+    if (add_new_block(arg.b.block, bvc, context) && bvc.m_added_to_main_chain) {
+      ++arg.hop;
+      relay_block(arg, context);
+    }
+
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context) {
+    LOG_PRINT_CCONTEXT_L2("NOTIFY_NEW_COMPACT_BLOCK (hop " << arg.hop << ", txs.size()=" << arg.b.txs.size() << ")");
+    if (context.m_state != cryptonote_connection_context::state_normal) {
+      return 1;
+    }
+
+    Block b = AUTO_VAL_INIT(b);
+    if (!parse_and_validate_block_from_blob(arg.b.block, b)) {
+      LOG_PRINT_CCONTEXT_L0("Failed to parse compact block, dropping connection");
       m_p2p->drop_connection(context);
       return 1;
     }
-    if (bvc.m_added_to_main_chain) {
-      ++arg.hop;
-      //TODO: Add here announce protocol usage
-      relay_block(arg, context);
-    } else if (bvc.m_marked_as_orphaned) {
-      context.m_state = cryptonote_connection_context::state_synchronizing;
-      NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-      m_core.get_short_chain_history(r.block_ids);
-      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size());
-      post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
+
+    if (m_core.have_block(get_block_hash(b))) {
+      return 1;
+    }
+
+    {
+      CRITICAL_REGION_LOCAL(m_relay_lock);
+      KnownHashes& known_transactions = get_known_transactions(context.m_connection_id);
+      for (const crypto::hash& tx_id : b.txHashes) {
+        known_transactions.insert(tx_id);
+      }
+    }
+
+    for (auto tx_blob_it = arg.b.txs.begin(); tx_blob_it != arg.b.txs.end(); tx_blob_it++) {
+      cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      m_core.handle_incoming_tx(*tx_blob_it, tvc, true);
+      if (tvc.m_verifivation_failed) {
+        LOG_PRINT_CCONTEXT_L0("Block verification failed: transaction verification failed, dropping connection");
+        m_p2p->drop_connection(context);
+        return 1;
+      }
     }
 
+    arg.b.txs.clear();
+    pending_compact_block block;
+    block.arg = std::move(arg);
+    block.tx_ids = std::move(b.txHashes);
+    block.request_time = 0;
+    block.request_count = 0;
+    add_compact_block(block, context);
     return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::add_new_block(const blobdata& block_blob, block_verification_context& bvc, cryptonote_connection_context& context) {
+    m_core.handle_incoming_block_blob(block_blob, bvc, true, false);
+    if (bvc.m_verifivation_failed) {
+      LOG_PRINT_CCONTEXT_L1("Block verification failed, dropping connection");
+      m_p2p->drop_connection(context);
+      return false;
+    }
+
+    if (bvc.m_marked_as_orphaned) {
+      request_chain(context);
+    }
+
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::request_chain(cryptonote_connection_context& context) {
+    context.m_state = cryptonote_connection_context::state_synchronizing;
+    NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
+    m_core.get_short_chain_history(r.block_ids);
+    LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size());
+    post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::add_compact_block(pending_compact_block& block, cryptonote_connection_context& context) {
+    // the transactions found in the pool are not kept for the block, they may have been evicted, expired or invalidated
+    // while the others were requested, so they are checked right before the block is added and requested again
+    NOTIFY_REQUEST_GET_OBJECTS::request req;
+    for (const crypto::hash& tx_id : block.tx_ids) {
+      if (!m_core.have_transaction(tx_id)) {
+        req.txs.push_back(tx_id);
+      }
+    }
+
+    if (!req.txs.empty()) {
+      if (block.request_count >= P2P_COMPACT_BLOCK_TRANSACTIONS_MAX_REQUESTS) {
+        LOG_PRINT_CCONTEXT_L1("Transactions of compact block are still missing, requesting the chain");
+        request_chain(context);
+        return;
+      }
+
+      ++block.request_count;
+      block.missing_tx_ids.clear();
+      block.missing_tx_ids.insert(req.txs.begin(), req.txs.end());
+      block.request_time = time(NULL);
+      {
+        CRITICAL_REGION_LOCAL(m_compact_blocks_lock);
+        m_pending_compact_blocks[context.m_connection_id] = std::move(block);
+      }
+
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_GET_OBJECTS: txs.size()=" << req.txs.size() << " missing transactions of compact block");
+      post_notify<NOTIFY_REQUEST_GET_OBJECTS>(req, context);
+      return;
+    }
+
+    block_verification_context bvc = boost::value_initialized<block_verification_context>();
+    if (!add_new_block(block.arg.b.block, bvc, context) || !bvc.m_added_to_main_chain) {
+      return;
+    }
+
+    // peers without compact blocks are relayed the block with all of its transactions, which are in the blockchain now
+    std::list<Transaction> txs;
+    std::list<crypto::hash> missed_txs;
+    m_core.get_transactions(block.tx_ids, txs, missed_txs);
+    if (!missed_txs.empty()) {
+      LOG_PRINT_CCONTEXT_L1("Block added, but it seems that reorganize just happened after that, do not relay this block");
+      return;
+    }
+
+    NOTIFY_NEW_BLOCK::request relayed = AUTO_VAL_INIT(relayed);
+    relayed.b.block = std::move(block.arg.b.block);
+    for (const Transaction& tx : txs) {
+      relayed.b.txs.push_back(t_serializable_object_to_blob(tx));
+    }
+
+    relayed.current_blockchain_height = block.arg.current_blockchain_height;
+    relayed.hop = block.arg.hop + 1;
+    relay_block(relayed, context);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
@@ -199,29 +325,87 @@ namespace cryptonote
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
 
-    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end();)
     {
-      cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-      m_core.handle_incoming_tx(*tx_blob_it, tvc, false);
-      if(tvc.m_verifivation_failed)
+      CRITICAL_REGION_LOCAL(m_relay_lock);
+      KnownHashes& known_transactions = get_known_transactions(context.m_connection_id);
+      for(const blobdata& tx_blob: arg.txs)
+        known_transactions.insert(get_blob_hash(tx_blob));
+    }
+
+    std::vector<cryptonote::tx_verification_context> tvcs;
+    m_core.handle_incoming_txs(arg.txs, tvcs, false);
+    auto tvc_it = tvcs.begin();
+    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end(); ++tvc_it)
+    {
+      if(tvc_it->m_verifivation_failed)
       {
         LOG_PRINT_CCONTEXT_L0("Tx verification failed, dropping connection");
         m_p2p->drop_connection(context);
         return 1;
       }
-      if(tvc.m_should_be_relayed)
+      if(tvc_it->m_should_be_relayed)
         ++tx_blob_it;
       else
         arg.txs.erase(tx_blob_it++);
     }
 
     if(arg.txs.size())
+      queue_transactions_relay(arg.txs, context.m_connection_id);
+
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transaction_hashes(int command, NOTIFY_NEW_TRANSACTION_HASHES::request& arg, cryptonote_connection_context& context)
+  {
+    LOG_PRINT_CCONTEXT_L2("NOTIFY_NEW_TRANSACTION_HASHES: txs.size()=" << arg.txs.size());
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    std::list<crypto::hash> missing_ids;
+    for(const crypto::hash& tx_id: arg.txs)
     {
-      //TODO: add announce usage here
-      relay_transactions(arg, context);
+      if(missing_ids.size() == P2P_RELAY_ANNOUNCED_TRANSACTIONS_MAX_COUNT)
+        break;
+      if(!m_core.have_transaction(tx_id))
+        missing_ids.push_back(tx_id);
     }
 
-    return true;
+    NOTIFY_REQUEST_GET_OBJECTS::request req;
+    {
+      CRITICAL_REGION_LOCAL(m_relay_lock);
+      KnownHashes& known_transactions = get_known_transactions(context.m_connection_id);
+      for(const crypto::hash& tx_id: arg.txs)
+        known_transactions.insert(tx_id);
+
+      for(const crypto::hash& tx_id: missing_ids)
+      {
+        auto requested = m_requested_transactions.find(tx_id);
+        if(requested == m_requested_transactions.end())
+        {
+          requested_transaction request;
+          request.connection_id = context.m_connection_id;
+          request.request_time = time(NULL);
+          m_requested_transactions.insert(std::make_pair(tx_id, std::move(request)));
+          req.txs.push_back(tx_id);
+          continue;
+        }
+
+        // asked later by update_transaction_requests if the request fails
+        std::list<boost::uuids::uuid>& announcers = requested->second.announcers;
+        if(requested->second.connection_id != context.m_connection_id && announcers.size() < P2P_RELAY_TRANSACTION_ANNOUNCERS_MAX_COUNT &&
+          std::find(announcers.begin(), announcers.end(), context.m_connection_id) == announcers.end())
+          announcers.push_back(context.m_connection_id);
+      }
+    }
+
+    if(req.txs.size())
+    {
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_GET_OBJECTS: txs.size()=" << req.txs.size());
+      post_notify<NOTIFY_REQUEST_GET_OBJECTS>(req, context);
+    }
+
+    return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
@@ -244,6 +428,16 @@ namespace cryptonote
   int t_cryptonote_protocol_handler<t_core>::handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
   {
     LOG_PRINT_CCONTEXT_L2("NOTIFY_RESPONSE_GET_OBJECTS");
+    bool requesting_blocks;
+    {
+      CRITICAL_REGION_LOCAL(m_sync_lock);
+      requesting_blocks = m_sync_scheduler.isRequesting(context.m_connection_id);
+    }
+
+    //transactions announced by id or missing from compact blocks
+    if(arg.blocks.empty() && (!arg.txs.empty() || !requesting_blocks))
+      return handle_response_transactions(arg, context);
+
     if(context.m_last_response_height > arg.current_blockchain_height)
     {
       LOG_ERROR_CCONTEXT("sent wrong NOTIFY_HAVE_OBJECTS: arg.m_current_blockchain_height=" << arg.current_blockchain_height 
@@ -254,10 +448,9 @@ namespace cryptonote
 
     context.m_remote_blockchain_height = arg.current_blockchain_height;
 
-    size_t count = 0;
-    BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
+    size_t received_bytes = 0;
+    BOOST_FOREACH(block_complete_entry& block_entry, arg.blocks)
     {
-      ++count;
       Block b;
       if(!parse_and_validate_block_from_blob(block_entry.block, b))
       {
@@ -266,98 +459,276 @@ namespace cryptonote
         m_p2p->drop_connection(context);
         return 1;
       }
-      //to avoid concurrency in core between connections, suspend connections which delivered block later then first one
-      if(count == 2)
-      { 
-        if(m_core.have_block(get_block_hash(b)))
-        {
-          context.m_state = cryptonote_connection_context::state_idle;
-          context.m_needed_objects.clear();
-          context.m_requested_objects.clear();
-          LOG_PRINT_CCONTEXT_L1("Connection set to idle state.");
-          return 1;
-        }
-      }
-
-      auto req_it = context.m_requested_objects.find(get_block_hash(b));
-      if(req_it == context.m_requested_objects.end())
+      if (b.txHashes.size() != block_entry.txs.size()) 
       {
         LOG_ERROR_CCONTEXT("sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << epee::string_tools::pod_to_hex(get_blob_hash(block_entry.block)) 
-          << " wasn't requested, dropping connection");
+          << ", txHashes.size()=" << b.txHashes.size() << " mismatch with block_complete_entry.m_txs.size()=" << block_entry.txs.size() << ", dropping connection");
         m_p2p->drop_connection(context);
         return 1;
       }
-      if (b.txHashes.size() != block_entry.txs.size()) 
+
+      received_bytes += block_entry.block.size();
+      for(const blobdata& tx_blob: block_entry.txs)
+        received_bytes += tx_blob.size();
+
+      crypto::hash block_id = get_block_hash(b);
+      bool requested;
       {
-        LOG_ERROR_CCONTEXT("sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << epee::string_tools::pod_to_hex(get_blob_hash(block_entry.block)) 
-          << ", txHashes.size()=" << b.txHashes.size() << " mismatch with block_complete_entry.m_txs.size()=" << block_entry.txs.size() << ", dropping connection");
+        CRITICAL_REGION_LOCAL(m_sync_lock);
+        requested = m_sync_scheduler.deliverBlock(context.m_connection_id, block_id, std::move(block_entry), std::move(b));
+      }
+      if(!requested)
+      {
+        LOG_ERROR_CCONTEXT("sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << epee::string_tools::pod_to_hex(block_id) 
+          << " wasn't requested, dropping connection");
         m_p2p->drop_connection(context);
         return 1;
       }
+    }
 
-      context.m_requested_objects.erase(req_it);
+    size_t unanswered_count;
+    BlockSyncScheduler::PeerStatistics statistics;
+    {
+      CRITICAL_REGION_LOCAL(m_sync_lock);
+      unanswered_count = m_sync_scheduler.completeRequest(context.m_connection_id, arg.missed_ids, received_bytes, time(NULL));
+      statistics = m_sync_scheduler.getPeerStatistics(context.m_connection_id);
     }
 
-    if(context.m_requested_objects.size())
+    if(unanswered_count)
     {
-      LOG_PRINT_CCONTEXT_RED("returned not all requested objects (context.m_requested_objects.size()=" 
-        << context.m_requested_objects.size() << "), dropping connection", LOG_LEVEL_0);
+      LOG_PRINT_CCONTEXT_RED("returned not all requested objects (" << unanswered_count << " blocks missing), dropping connection", LOG_LEVEL_0);
       m_p2p->drop_connection(context);
       return 1;
     }
 
+    LOG_PRINT_CCONTEXT_L2("Received " << arg.blocks.size() << " blocks at " << statistics.throughput << " bytes/s, next batch " << statistics.batchSize << " blocks");
+    import_downloaded_blocks();
+    request_missing_objects(context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::import_downloaded_blocks()
+  {
+    for(;;)
     {
+      std::list<block_complete_entry> blocks;
+      std::vector<Block> parsed_blocks;
+      std::vector<crypto::hash> block_ids;
+      std::vector<boost::uuids::uuid> suppliers;
+      {
+        CRITICAL_REGION_LOCAL(m_sync_lock);
+        //blocks delivered during an import are taken by the importing thread when it is done
+        if(m_importing_blocks || !m_sync_scheduler.takeReadyBlocks(blocks, parsed_blocks, block_ids, suppliers))
+          return;
+        m_importing_blocks = true;
+      }
+
       m_core.pause_mining();
       epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler(
         boost::bind(&t_core::update_block_template_and_resume_mining, &m_core));
 
-      for (const block_complete_entry& block_entry : arg.blocks) {
-        //process transactions
-        TIME_MEASURE_START(transactions_process_time);
-        for (auto& tx_blob : block_entry.txs) {
-          tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-          m_core.handle_incoming_tx(tx_blob, tvc, true);
-          if (tvc.m_verifivation_failed) {
-            LOG_ERROR_CCONTEXT("transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = " 
-              << epee::string_tools::pod_to_hex(get_blob_hash(tx_blob)) << ", dropping connection");
-            m_p2p->drop_connection(context);
-            return 1;
-          }
-        }
-        TIME_MEASURE_FINISH(transactions_process_time);
+      TIME_MEASURE_START(blocks_process_time);
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      block_verification_context bvc = boost::value_initialized<block_verification_context>();
+      m_core.handle_incoming_blocks(blocks, parsed_blocks, tvc, bvc);
 
-        //process block
-        TIME_MEASURE_START(block_process_time);
-        block_verification_context bvc = boost::value_initialized<block_verification_context>();
-        m_core.handle_incoming_block_blob(block_entry.block, bvc, false, false);
+      //the import stops at the first block which fails, the blocks after it are downloaded again
+      size_t imported_count = 0;
+      while(imported_count < block_ids.size() && m_core.have_block(block_ids[imported_count]))
+        ++imported_count;
 
-        if (bvc.m_verifivation_failed) {
-          LOG_PRINT_CCONTEXT_L1("Block verification failed, dropping connection");
-          m_p2p->drop_connection(context);
-          return 1;
+      {
+        CRITICAL_REGION_LOCAL(m_sync_lock);
+        m_sync_scheduler.finishImport(imported_count);
+        m_importing_blocks = false;
+      }
+
+      if(imported_count < block_ids.size())
+      {
+        std::string supplier = epee::string_tools::get_str_from_guid_a(suppliers[imported_count]);
+        if (tvc.m_verifivation_failed) {
+          LOG_ERROR("transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, dropping connection " << supplier);
+          drop_connection(suppliers[imported_count]);
+        } else if (bvc.m_verifivation_failed) {
+          LOG_PRINT_L1("Block verification failed, dropping connection " << supplier);
+          drop_connection(suppliers[imported_count]);
         } else if (bvc.m_marked_as_orphaned) {
-          LOG_PRINT_CCONTEXT_L0("Block received at sync phase was marked as orphaned, dropping connection");
-          m_p2p->drop_connection(context);
-          return 1;
+          LOG_PRINT_L0("Block received at sync phase was marked as orphaned, dropping connection " << supplier);
+          drop_connection(suppliers[imported_count]);
+        }
+      }
+
+      TIME_MEASURE_FINISH(blocks_process_time);
+      LOG_PRINT_L2("Blocks process time: " << blocks_process_time << " ms for " << imported_count << " blocks");
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_response_transactions(NOTIFY_RESPONSE_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
+  {
+    //transactions of the compact block of the connection are kept by the pool like those of any other block
+    std::list<blobdata> block_txs;
+    pending_compact_block compact_block;
+    bool compact_block_complete = false;
+    bool compact_block_missed = false;
+    {
+      CRITICAL_REGION_LOCAL(m_compact_blocks_lock);
+      auto pending = m_pending_compact_blocks.find(context.m_connection_id);
+      if(pending != m_pending_compact_blocks.end())
+      {
+        for(auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end();)
+        {
+          if(pending->second.missing_tx_ids.erase(get_blob_hash(*tx_blob_it)))
+            block_txs.splice(block_txs.end(), arg.txs, tx_blob_it++);
+          else
+            ++tx_blob_it;
         }
 
-        TIME_MEASURE_FINISH(block_process_time);
-        LOG_PRINT_CCONTEXT_L2("Block process time: " << block_process_time + transactions_process_time <<
-          " (" << transactions_process_time << " / " << block_process_time << ") ms");
+        bool missed = std::any_of(arg.missed_ids.begin(), arg.missed_ids.end(), [&](const crypto::hash& tx_id) {
+          return pending->second.missing_tx_ids.count(tx_id) != 0;
+        });
+
+        if(missed)
+        {
+          LOG_PRINT_CCONTEXT_L1("Transactions of compact block are missing, requesting the chain");
+          compact_block_missed = true;
+          m_pending_compact_blocks.erase(pending);
+        }else if(pending->second.missing_tx_ids.empty())
+        {
+          compact_block = std::move(pending->second);
+          compact_block_complete = true;
+          m_pending_compact_blocks.erase(pending);
+        }
+      }
+    }
+
+    {
+      CRITICAL_REGION_LOCAL(m_relay_lock);
+      KnownHashes& known_transactions = get_known_transactions(context.m_connection_id);
+      for(const blobdata& tx_blob: arg.txs)
+      {
+        crypto::hash tx_id = get_blob_hash(tx_blob);
+        known_transactions.insert(tx_id);
+        m_requested_transactions.erase(tx_id);
+      }
+
+      // the transactions the peer no longer has are requested from other announcers by the next on_idle
+      for(const crypto::hash& tx_id: arg.missed_ids)
+      {
+        auto requested = m_requested_transactions.find(tx_id);
+        if(requested != m_requested_transactions.end() && requested->second.connection_id == context.m_connection_id)
+          requested->second.request_time = 0;
+      }
+    }
+
+    std::vector<cryptonote::tx_verification_context> tvcs;
+    m_core.handle_incoming_txs(arg.txs, tvcs, false);
+    auto tvc_it = tvcs.begin();
+    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end(); ++tvc_it)
+    {
+      if(tvc_it->m_verifivation_failed)
+      {
+        LOG_PRINT_CCONTEXT_L0("Requested tx verification failed, dropping connection");
+        m_p2p->drop_connection(context);
+        return 1;
+      }
+      if(tvc_it->m_should_be_relayed)
+        ++tx_blob_it;
+      else
+        arg.txs.erase(tx_blob_it++);
+    }
+
+    if(arg.txs.size())
+      queue_transactions_relay(arg.txs, context.m_connection_id);
+
+    for(const blobdata& tx_blob: block_txs)
+    {
+      cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      m_core.handle_incoming_tx(tx_blob, tvc, true);
+      if(tvc.m_verifivation_failed)
+      {
+        LOG_PRINT_CCONTEXT_L0("Block verification failed: transaction verification failed, dropping connection");
+        m_p2p->drop_connection(context);
+        return 1;
       }
     }
 
-    request_missing_objects(context, true);
+    if(compact_block_complete)
+      add_compact_block(compact_block, context);
+    else if(compact_block_missed)
+      request_chain(context);
+
     return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   bool t_cryptonote_protocol_handler<t_core>::on_idle()
   {
+    relay_queued_transactions();
+    update_transaction_requests();
+    expire_compact_blocks();
+    update_block_requests();
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::expire_compact_blocks()
+  {
+    //the blocks are left to synchronization, which also drops those of closed connections
+    CRITICAL_REGION_LOCAL(m_compact_blocks_lock);
+    time_t now = time(NULL);
+    for(auto it = m_pending_compact_blocks.begin(); it != m_pending_compact_blocks.end();)
+    {
+      if(now - it->second.request_time >= P2P_COMPACT_BLOCK_TRANSACTIONS_TIMEOUT)
+        it = m_pending_compact_blocks.erase(it);
+      else
+        ++it;
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::update_block_requests()
+  {
+    std::vector<boost::uuids::uuid> expired;
+    std::set<boost::uuids::uuid> closed;
+    {
+      CRITICAL_REGION_LOCAL(m_sync_lock);
+      expired = m_sync_scheduler.expireRequests(time(NULL));
+      for(const boost::uuids::uuid& connection_id: m_sync_scheduler.getPeers())
+        closed.insert(connection_id);
+    }
+
+    for(const boost::uuids::uuid& connection_id: expired)
+      LOG_PRINT_L1("Blocks requested from connection " << epee::string_tools::get_str_from_guid_a(connection_id) << " timed out, requesting them from other peers");
+
+    m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id)->bool{
+      closed.erase(context.m_connection_id);
+      if(context.m_state == cryptonote_connection_context::state_idle)
+      {
+        ++context.m_callback_request_count;
+        m_p2p->request_callback(context);
+      }
+      return true;
+    });
+
+    if(closed.size())
+    {
+      CRITICAL_REGION_LOCAL(m_sync_lock);
+      for(const boost::uuids::uuid& connection_id: closed)
+        m_sync_scheduler.removePeer(connection_id);
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::drop_connection(const boost::uuids::uuid& connection_id)
+  {
+    m_p2p->drop_connection(epee::net_utils::connection_context_base(connection_id, 0, 0, false));
+    CRITICAL_REGION_LOCAL(m_sync_lock);
+    m_sync_scheduler.removePeer(connection_id);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, cryptonote_connection_context& context)
   {
     LOG_PRINT_CCONTEXT_L2("NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << arg.block_ids.size());
@@ -373,27 +744,30 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
-  bool t_cryptonote_protocol_handler<t_core>::request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks)
+  bool t_cryptonote_protocol_handler<t_core>::request_missing_objects(cryptonote_connection_context& context)
   {
-    if(context.m_needed_objects.size())
+    if(!context.m_unchecked_block_ids.empty() && !context.m_requested_headers_count)
+      request_block_headers(context);
+
+    NOTIFY_REQUEST_GET_OBJECTS::request req;
+    bool has_blocks;
     {
-      //we know objects that we need, request this objects
-      NOTIFY_REQUEST_GET_OBJECTS::request req;
-      size_t count = 0;
-      auto it = context.m_needed_objects.begin();
+      CRITICAL_REGION_LOCAL(m_sync_lock);
+      if(m_sync_scheduler.isRequesting(context.m_connection_id))
+        return true;
+      m_sync_scheduler.requestBlocks(context.m_connection_id, time(NULL), req.blocks);
+      has_blocks = m_sync_scheduler.hasBlocksOf(context.m_connection_id);
+    }
 
-      while(it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
-      {
-        if( !(check_having_blocks && m_core.have_block(*it)))
-        {
-          req.blocks.push_back(*it);
-          ++count;
-          context.m_requested_objects.insert(*it);
-        }
-        context.m_needed_objects.erase(it++);
-      }
+    if(req.blocks.size())
+    {
+      //we know objects that we need, request this objects
       LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size());
       post_notify<NOTIFY_REQUEST_GET_OBJECTS>(req, context);    
+    }else if(has_blocks || !context.m_unchecked_block_ids.empty())
+    {//the rest of its blocks are downloaded from other peers or still have their headers checked, wait for them
+      context.m_state = cryptonote_connection_context::state_idle;
+      LOG_PRINT_CCONTEXT_L2("Connection set to idle state.");
     }else if(context.m_last_response_height < context.m_remote_blockchain_height-1)
     {//we have to fetch more objects ids, request blockchain entry
      
@@ -403,13 +777,9 @@ namespace cryptonote
       post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
     }else
     { 
-      CHECK_AND_ASSERT_MES(context.m_last_response_height == context.m_remote_blockchain_height-1 
-                           && !context.m_needed_objects.size() 
-                           && !context.m_requested_objects.size(), false, "request_missing_blocks final condition failed!" 
+      CHECK_AND_ASSERT_MES(context.m_last_response_height == context.m_remote_blockchain_height-1, false, "request_missing_blocks final condition failed!" 
                            << "\r\nm_last_response_height=" << context.m_last_response_height
                            << "\r\nm_remote_blockchain_height=" << context.m_remote_blockchain_height
-                           << "\r\nm_needed_objects.size()=" << context.m_needed_objects.size()
-                           << "\r\nm_requested_objects.size()=" << context.m_requested_objects.size()
                            << "\r\non connection [" << epee::net_utils::print_connection_context_short(context)<< "]");
       
       context.m_state = cryptonote_connection_context::state_normal;
@@ -481,25 +851,367 @@ namespace cryptonote
       m_p2p->drop_connection(context);
     }
 
+    std::list<crypto::hash> needed_ids;
     BOOST_FOREACH(auto& bl_id, arg.m_block_ids)
     {
       if(!m_core.have_block(bl_id))
-        context.m_needed_objects.push_back(bl_id);
+        needed_ids.push_back(bl_id);
+    }
+
+    if(context.m_protocol_version >= BC_PROTOCOL_VERSION_BLOCK_HEADERS && !needed_ids.empty())
+    {//the headers of the blocks from the first needed one on are checked before the blocks are downloaded
+      auto first_needed = std::find(arg.m_block_ids.begin(), arg.m_block_ids.end(), needed_ids.front());
+      context.m_last_checked_block_id = *std::prev(first_needed);
+      context.m_unchecked_block_ids.assign(first_needed, arg.m_block_ids.end());
+      context.m_requested_headers_count = 0;
+      LOG_PRINT_CCONTEXT_L2(context.m_unchecked_block_ids.size() << " block headers to check");
+    }else
+    {
+      CRITICAL_REGION_LOCAL(m_sync_lock);
+      size_t added_count = m_sync_scheduler.addBlocks(context.m_connection_id, needed_ids);
+      LOG_PRINT_CCONTEXT_L2(added_count << " of " << needed_ids.size() << " needed blocks added to download, " << m_sync_scheduler.size() << " blocks to download");
     }
 
-    request_missing_objects(context, false);
+    request_missing_objects(context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::request_block_headers(cryptonote_connection_context& context)
+  {
+    NOTIFY_REQUEST_BLOCK_HEADERS::request req;
+    auto end = context.m_unchecked_block_ids.begin();
+    std::advance(end, std::min(context.m_unchecked_block_ids.size(), BLOCK_HEADERS_SYNCHRONIZING_DEFAULT_COUNT));
+    req.blocks.assign(context.m_unchecked_block_ids.begin(), end);
+    context.m_requested_headers_count = req.blocks.size();
+    LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_BLOCK_HEADERS: blocks.size()=" << req.blocks.size());
+    post_notify<NOTIFY_REQUEST_BLOCK_HEADERS>(req, context);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_block_headers(int command, NOTIFY_REQUEST_BLOCK_HEADERS::request& arg, cryptonote_connection_context& context)
+  {
+    LOG_PRINT_CCONTEXT_L2("NOTIFY_REQUEST_BLOCK_HEADERS: blocks.size()=" << arg.blocks.size());
+    if(arg.blocks.size() > BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT)
+    {
+      LOG_ERROR_CCONTEXT("requested too many block headers: " << arg.blocks.size() << ", dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    NOTIFY_RESPONSE_BLOCK_HEADERS::request rsp;
+    if(!m_core.handle_get_block_headers(arg, rsp))
+    {
+      LOG_ERROR_CCONTEXT("failed to handle request NOTIFY_REQUEST_BLOCK_HEADERS, dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_RESPONSE_BLOCK_HEADERS: headers.size()=" << rsp.headers.size() << ", missed_ids.size()=" << rsp.missed_ids.size());
+    post_notify<NOTIFY_RESPONSE_BLOCK_HEADERS>(rsp, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_response_block_headers(int command, NOTIFY_RESPONSE_BLOCK_HEADERS::request& arg, cryptonote_connection_context& context)
+  {
+    LOG_PRINT_CCONTEXT_L2("NOTIFY_RESPONSE_BLOCK_HEADERS: headers.size()=" << arg.headers.size() << ", missed_ids.size()=" << arg.missed_ids.size());
+    if(!context.m_requested_headers_count)
+    {
+      LOG_ERROR_CCONTEXT("sent not requested block headers, dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    //the peer announced these blocks in its chain entry, so it has to have all of them
+    if(arg.headers.size() != context.m_requested_headers_count || !arg.missed_ids.empty())
+    {
+      LOG_ERROR_CCONTEXT("sent " << arg.headers.size() << " of " << context.m_requested_headers_count << " requested block headers, dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    std::vector<BlockShortHeader> headers(arg.headers.size());
+    std::vector<crypto::hash> ids;
+    ids.reserve(headers.size());
+    size_t i = 0;
+    BOOST_FOREACH(const blobdata& header_blob, arg.headers)
+    {
+      if(!parse_and_validate_block_short_header_from_blob(header_blob, headers[i++]))
+      {
+        LOG_ERROR_CCONTEXT("sent wrong block header: failed to parse and validate block header: \r\n"
+          << epee::string_tools::buff_to_hex_nodelimer(header_blob) << "\r\n dropping connection");
+        m_p2p->drop_connection(context);
+        return 1;
+      }
+
+      ids.push_back(context.m_unchecked_block_ids.front());
+      context.m_unchecked_block_ids.pop_front();
+    }
+
+    if(!m_core.check_block_headers(context.m_last_checked_block_id, headers, ids, context.m_checked_headers_window))
+    {
+      LOG_ERROR_CCONTEXT("sent invalid block headers of its chain entry, dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    context.m_last_checked_block_id = ids.back();
+    context.m_requested_headers_count = 0;
+
+    std::list<crypto::hash> needed_ids;
+    for(const crypto::hash& id: ids)
+    {
+      if(!m_core.have_block(id))
+        needed_ids.push_back(id);
+    }
+
+    {
+      CRITICAL_REGION_LOCAL(m_sync_lock);
+      size_t added_count = m_sync_scheduler.addBlocks(context.m_connection_id, needed_ids);
+      LOG_PRINT_CCONTEXT_L2(added_count << " of " << needed_ids.size() << " needed blocks added to download, " << m_sync_scheduler.size() << " blocks to download");
+    }
+
+    if(context.m_state == cryptonote_connection_context::state_idle)
+      context.m_state = cryptonote_connection_context::state_synchronizing;
+
+    request_missing_objects(context);
     return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
   {
-    return relay_post_notify<NOTIFY_NEW_BLOCK>(arg, exclude_context);
+    struct peer_relay
+    {
+      epee::net_utils::connection_context_base context;
+      bool compact;
+      std::list<blobdata> txs; //transactions of the compact block the peer is not known to have
+    };
+
+    std::vector<crypto::hash> tx_ids;
+    for(const blobdata& tx_blob: arg.b.txs)
+      tx_ids.push_back(get_blob_hash(tx_blob));
+
+    std::list<peer_relay> relays;
+    {
+      CRITICAL_REGION_LOCAL(m_relay_lock);
+      m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id)->bool{
+        if(!peer_id || context.m_connection_id == exclude_context.m_connection_id)
+          return true;
+
+        peer_relay relay;
+        relay.context = context;
+        relay.compact = context.m_protocol_version >= BC_PROTOCOL_VERSION_COMPACT_BLOCKS;
+        KnownHashes& known_transactions = get_known_transactions(context.m_connection_id);
+        auto tx_blob_it = arg.b.txs.begin();
+        for(const crypto::hash& tx_id: tx_ids)
+        {
+          if(known_transactions.insert(tx_id) && relay.compact)
+            relay.txs.push_back(*tx_blob_it);
+          ++tx_blob_it;
+        }
+
+        relays.push_back(std::move(relay));
+        return true;
+      });
+    }
+
+    NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+    compact_arg.b.block = arg.b.block;
+    compact_arg.current_blockchain_height = arg.current_blockchain_height;
+    compact_arg.hop = arg.hop;
+    //the blobs announced to many peers are serialized once and shared by their send queues
+    epee::net_utils::shared_buffer full_blob;
+    epee::net_utils::shared_buffer compact_blob;
+    size_t compact_count = 0;
+    for(peer_relay& relay: relays)
+    {
+      if(!relay.compact)
+      {
+        if(!full_blob)
+          full_blob = store_shared_blob(arg);
+        m_p2p->invoke_notify_to_peer(NOTIFY_NEW_BLOCK::ID, full_blob, relay.context);
+        continue;
+      }
+
+      ++compact_count;
+      if(relay.txs.empty())
+      {
+        //most peers have all the transactions, they share the same announcement
+        if(!compact_blob)
+          compact_blob = store_shared_blob(compact_arg);
+        m_p2p->invoke_notify_to_peer(NOTIFY_NEW_COMPACT_BLOCK::ID, compact_blob, relay.context);
+      }else
+      {
+        compact_arg.b.txs.swap(relay.txs);
+        epee::net_utils::shared_buffer blob = store_shared_blob(compact_arg);
+        compact_arg.b.txs.clear();
+        m_p2p->invoke_notify_to_peer(NOTIFY_NEW_COMPACT_BLOCK::ID, blob, relay.context);
+      }
+    }
+
+    LOG_PRINT_L2("Relayed block to " << relays.size() << " connections, " << compact_count << " of them compact");
+    return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context)
   {
-    return relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(arg, exclude_context);
+    queue_transactions_relay(arg.txs, exclude_context.m_connection_id);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::queue_transactions_relay(const std::list<blobdata>& tx_blobs, const boost::uuids::uuid& source_connection_id)
+  {
+    CRITICAL_REGION_LOCAL(m_relay_lock);
+    for(const blobdata& tx_blob: tx_blobs)
+    {
+      queued_transaction tx;
+      tx.id = get_blob_hash(tx_blob);
+      tx.blob = tx_blob;
+      tx.source_connection_id = source_connection_id;
+      m_relay_queue.push_back(std::move(tx));
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::relay_queued_transactions()
+  {
+    struct peer_relay
+    {
+      epee::net_utils::connection_context_base context;
+      NOTIFY_NEW_TRANSACTION_HASHES::request ids;
+      NOTIFY_NEW_TRANSACTIONS::request blobs;
+    };
+
+    std::vector<queued_transaction> queue;
+    std::list<peer_relay> relays;
+    {
+      CRITICAL_REGION_LOCAL(m_relay_lock);
+      if(m_relay_queue.empty())
+        return;
+      queue.swap(m_relay_queue);
+
+      std::map<boost::uuids::uuid, KnownHashes> known_transactions;
+      m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id)->bool{
+        auto known = known_transactions.insert(std::make_pair(context.m_connection_id, std::move(get_known_transactions(context.m_connection_id)))).first;
+        if(!peer_id || context.m_state != cryptonote_connection_context::state_normal)
+          return true;
+
+        peer_relay relay;
+        relay.context = context;
+        bool announce_ids = context.m_protocol_version >= BC_PROTOCOL_VERSION_TX_HASHES;
+        for(const queued_transaction& tx: queue)
+        {
+          if(tx.source_connection_id == context.m_connection_id || !known->second.insert(tx.id))
+            continue;
+          if(announce_ids)
+            relay.ids.txs.push_back(tx.id);
+          else
+            relay.blobs.txs.push_back(tx.blob);
+        }
+
+        if(relay.ids.txs.size() || relay.blobs.txs.size())
+          relays.push_back(std::move(relay));
+        return true;
+      });
+
+      // the sets of closed connections are not carried over
+      m_known_transactions.swap(known_transactions);
+    }
+
+    LOG_PRINT_L2("Relaying " << queue.size() << " transactions to " << relays.size() << " connections");
+    for(peer_relay& relay: relays)
+    {
+      if(relay.ids.txs.size())
+        m_p2p->invoke_notify_to_peer(NOTIFY_NEW_TRANSACTION_HASHES::ID, store_shared_blob(relay.ids), relay.context);
+      else
+        m_p2p->invoke_notify_to_peer(NOTIFY_NEW_TRANSACTIONS::ID, store_shared_blob(relay.blobs), relay.context);
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::update_transaction_requests()
+  {
+    std::vector<crypto::hash> due_ids;
+    std::map<boost::uuids::uuid, epee::net_utils::connection_context_base> open;
+    {
+      CRITICAL_REGION_LOCAL(m_relay_lock);
+      m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id)->bool{
+        if(peer_id && context.m_state == cryptonote_connection_context::state_normal)
+          open.insert(std::make_pair(context.m_connection_id, context));
+        return true;
+      });
+
+      time_t now = time(NULL);
+      for(auto& requested: m_requested_transactions)
+      {
+        if(now - requested.second.request_time >= P2P_RELAY_TRANSACTION_REQUEST_TIMEOUT || open.count(requested.second.connection_id) == 0)
+        {
+          requested.second.request_time = 0;
+          due_ids.push_back(requested.first);
+        }
+      }
+    }
+
+    if(due_ids.empty())
+      return;
+
+    // have_transaction locks the pool, which is not done under m_relay_lock
+    std::unordered_set<crypto::hash> received_ids;
+    for(const crypto::hash& tx_id: due_ids)
+    {
+      if(m_core.have_transaction(tx_id))
+        received_ids.insert(tx_id);
+    }
+
+    std::map<boost::uuids::uuid, NOTIFY_REQUEST_GET_OBJECTS::request> requests;
+    {
+      CRITICAL_REGION_LOCAL(m_relay_lock);
+      time_t now = time(NULL);
+      for(const crypto::hash& tx_id: due_ids)
+      {
+        // the transaction could have been received or requested again meanwhile
+        auto requested = m_requested_transactions.find(tx_id);
+        if(requested == m_requested_transactions.end() || requested->second.request_time != 0)
+          continue;
+
+        std::list<boost::uuids::uuid>& announcers = requested->second.announcers;
+        while(!announcers.empty() && open.count(announcers.front()) == 0)
+          announcers.pop_front();
+
+        if(received_ids.count(tx_id) != 0 || announcers.empty())
+        {
+          m_requested_transactions.erase(requested);
+          continue;
+        }
+
+        requested->second.connection_id = announcers.front();
+        requested->second.request_time = now;
+        announcers.pop_front();
+        requests[requested->second.connection_id].txs.push_back(tx_id);
+      }
+    }
+
+    for(auto& request: requests)
+    {
+      const epee::net_utils::connection_context_base& context = open[request.first];
+      NOTIFY_REQUEST_GET_OBJECTS::request& req = request.second;
+      LOG_PRINT_L2("[" << epee::net_utils::print_connection_context_short(context) << "] -->>NOTIFY_REQUEST_GET_OBJECTS: txs.size()=" << req.txs.size() << ", requested again");
+      std::string blob;
+      epee::serialization::store_t_to_binary(req, blob);
+      m_p2p->invoke_notify_to_peer(NOTIFY_REQUEST_GET_OBJECTS::ID, blob, context);
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  KnownHashes& t_cryptonote_protocol_handler<t_core>::get_known_transactions(const boost::uuids::uuid& connection_id)
+  {
+    auto it = m_known_transactions.find(connection_id);
+    if(it == m_known_transactions.end())
+      it = m_known_transactions.insert(std::make_pair(connection_id, KnownHashes(P2P_RELAY_KNOWN_TRANSACTIONS_MAX_COUNT))).first;
+    return it->second;
   }
 }
@@ -49,6 +49,7 @@ public:
     m_cmd_binder.set_handler("show_hr", boost::bind(&daemon_cmmands_handler::show_hr, this, _1), "Start showing hash rate");
     m_cmd_binder.set_handler("hide_hr", boost::bind(&daemon_cmmands_handler::hide_hr, this, _1), "Stop showing hash rate");
     m_cmd_binder.set_handler("set_log", boost::bind(&daemon_cmmands_handler::set_log, this, _1), "set_log <level> - Change current log detalization level, <level> is a number 0-4");
+    m_cmd_binder.set_handler("save", boost::bind(&daemon_cmmands_handler::save, this, _1), "Save blockchain cache without stopping the daemon");
   }
 
   bool start_handling()
@@ -84,6 +85,14 @@ private:
     return true;
   }
   //--------------------------------------------------------------------------------
+  bool save(const std::vector<std::string>& args)
+  {
+    if (!m_srv.get_payload_object().get_core().get_blockchain_storage().storeCache()) {
+      std::cout << "Failed to save blockchain cache" << ENDL;
+    }
+    return true;
+  }
+  //--------------------------------------------------------------------------------
   bool print_pl(const std::vector<std::string>& args)
   {
     m_srv.log_peerlist();
@@ -104,6 +104,9 @@ namespace mining
     CHECK_AND_ASSERT_MES(r, false, "wrong buffer sent from pool server");
     r = epee::string_tools::parse_tpod_from_hex_string(job.target, native_details.target);
     CHECK_AND_ASSERT_MES(r, false, "wrong buffer sent from pool server");
+    r = cryptonote::get_longhash_blob_nonce_offset(native_details.blob, native_details.nonce_offset);
+    CHECK_AND_ASSERT_MES(r, false, "wrong block hashing blob sent from pool server");
+    memcpy(&native_details.nonce, &native_details.blob[native_details.nonce_offset], sizeof(native_details.nonce));
     native_details.job_id = job.job_id;
     return true;
   }
@@ -168,8 +171,7 @@ namespace mining
       }
       while(epee::misc_utils::get_tick_count() - last_job_ticks < 20000)
       {
-        //uint32_t c = (*((uint32_t*)&job.blob.data()[39]));
-        ++(*((uint32_t*)&job.blob.data()[39]));
+        cryptonote::set_longhash_blob_nonce(job.blob, job.nonce_offset, ++job.nonce);
         crypto::hash h = cryptonote::null_hash;
         crypto::cn_slow_hash(context, job.blob.data(), job.blob.size(), h);
         if(  ((uint32_t*)&h)[7] < job.target )
@@ -180,7 +182,7 @@ namespace mining
           COMMAND_RPC_SUBMITSHARE::response submit_response = AUTO_VAL_INIT(submit_response);
           submit_request.id     = pool_session_id;
           submit_request.job_id = job.job_id;
-          submit_request.nonce  = epee::string_tools::pod_to_hex((*((uint32_t*)&job.blob.data()[39])));
+          submit_request.nonce  = epee::string_tools::buff_to_hex_nodelimer(job.blob.substr(job.nonce_offset, sizeof(job.nonce)));
           submit_request.result = epee::string_tools::pod_to_hex(h);
           LOG_PRINT_L0("Share found: nonce=" << submit_request.nonce << " for job=" << job.job_id << ", submitting...");
           if(!epee::net_utils::invoke_http_json_rpc<mining::COMMAND_RPC_SUBMITSHARE>("/", submit_request, submit_response, m_http_client))
@@ -92,6 +92,10 @@ namespace cryptonote
     res.difficulty = m_core.get_blockchain_storage().get_difficulty_for_next_block();
     res.tx_count = m_core.get_blockchain_storage().get_total_transactions() - res.height; //without coinbase
     res.tx_pool_size = m_core.get_pool_transactions_count();
+    res.tx_pool_bytes = m_core.get_pool_transactions_size();
+    tx_memory_pool::EvictionStatistics evictionStatistics = m_core.get_pool_eviction_statistics();
+    res.tx_pool_evicted_count = evictionStatistics.evictedCount;
+    res.tx_pool_rejected_count = evictionStatistics.rejectedCount;
     res.alt_blocks_count = m_core.get_blockchain_storage().get_alternative_blocks_count();
     uint64_t total_conn = m_p2p.get_connections_count();
     res.outgoing_connections_count = m_p2p.get_outgoing_connections_count();
@@ -131,7 +135,7 @@ namespace cryptonote
 
     typedef COMMAND_RPC_QUERY_BLOCKS::response_item ResponseItem;
 
-    LockedBlockchainStorage lbs(m_core.get_blockchain_storage());
+    SharedLockedBlockchainStorage lbs(m_core.get_blockchain_storage());
 
     uint64_t currentHeight = lbs->get_current_blockchain_height();
     uint64_t startOffset = 0;
@@ -236,6 +236,9 @@ namespace cryptonote
       uint64_t difficulty;
       uint64_t tx_count;
       uint64_t tx_pool_size;
+      uint64_t tx_pool_bytes;
+      uint64_t tx_pool_evicted_count;
+      uint64_t tx_pool_rejected_count;
       uint64_t alt_blocks_count;
       uint64_t outgoing_connections_count;
       uint64_t incoming_connections_count;
@@ -248,6 +251,9 @@ namespace cryptonote
         KV_SERIALIZE(difficulty)
         KV_SERIALIZE(tx_count)
         KV_SERIALIZE(tx_pool_size)
+        KV_SERIALIZE(tx_pool_bytes)
+        KV_SERIALIZE(tx_pool_evicted_count)
+        KV_SERIALIZE(tx_pool_rejected_count)
         KV_SERIALIZE(alt_blocks_count)
         KV_SERIALIZE(outgoing_connections_count)
         KV_SERIALIZE(incoming_connections_count)
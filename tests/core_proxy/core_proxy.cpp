@@ -173,6 +173,28 @@ bool tests::proxy_core::handle_incoming_tx(const cryptonote::blobdata& tx_blob,
     return true;
 }
 
+bool tests::proxy_core::handle_incoming_txs(const std::list<cryptonote::blobdata>& tx_blobs, std::vector<cryptonote::tx_verification_context>& tvcs, bool keeped_by_block) {
+  tvcs.resize(tx_blobs.size());
+  auto tvc_it = tvcs.begin();
+  for (const cryptonote::blobdata& tx_blob : tx_blobs) {
+    handle_incoming_tx(tx_blob, *tvc_it++, keeped_by_block);
+  }
+
+  return true;
+}
+
+bool tests::proxy_core::handle_incoming_blocks(const std::list<cryptonote::block_complete_entry>& blocks, const std::vector<cryptonote::Block>& parsedBlocks, cryptonote::tx_verification_context& tvc, cryptonote::block_verification_context& bvc) {
+  for (const block_complete_entry& block_entry : blocks) {
+    for (const cryptonote::blobdata& tx_blob : block_entry.txs) {
+      handle_incoming_tx(tx_blob, tvc, true);
+    }
+
+    handle_incoming_block_blob(block_entry.block, bvc, false, false);
+  }
+
+  return true;
+}
+
 bool tests::proxy_core::handle_incoming_block_blob(const cryptonote::blobdata& block_blob, cryptonote::block_verification_context& bvc, bool control_miner, bool relay_block) {
   Block b = AUTO_VAL_INIT(b);
 
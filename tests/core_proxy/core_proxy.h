@@ -25,6 +25,11 @@
 #include "cryptonote_core/Currency.h"
 #include "cryptonote_core/verification_context.h"
 
+namespace cryptonote
+{
+  struct block_complete_entry;
+}
+
 namespace tests
 {
   struct block_index {
@@ -68,13 +73,19 @@ namespace tests
     bool get_short_chain_history(std::list<crypto::hash>& ids);
     bool get_stat_info(cryptonote::core_stat_info& st_inf){return true;}
     bool have_block(const crypto::hash& id);
+    bool have_transaction(const crypto::hash& id){return false;}
+    void get_transactions(const std::vector<crypto::hash>& txs_ids, std::list<cryptonote::Transaction>& txs, std::list<crypto::hash>& missed_txs){}
     bool get_blockchain_top(uint64_t& height, crypto::hash& top_id);
     bool handle_incoming_tx(const cryptonote::blobdata& tx_blob, cryptonote::tx_verification_context& tvc, bool keeped_by_block);
     bool handle_incoming_block_blob(const cryptonote::blobdata& block_blob, cryptonote::block_verification_context& bvc, bool control_miner, bool relay_block);
+    bool handle_incoming_txs(const std::list<cryptonote::blobdata>& tx_blobs, std::vector<cryptonote::tx_verification_context>& tvcs, bool keeped_by_block);
+    bool handle_incoming_blocks(const std::list<cryptonote::block_complete_entry>& blocks, const std::vector<cryptonote::Block>& parsedBlocks, cryptonote::tx_verification_context& tvc, cryptonote::block_verification_context& bvc);
     void pause_mining(){}
     void update_block_template_and_resume_mining(){}
     bool on_idle(){return true;}
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp){return true;}
     bool handle_get_objects(cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote::cryptonote_connection_context& context){return true;}
+    bool handle_get_block_headers(const cryptonote::NOTIFY_REQUEST_BLOCK_HEADERS::request& arg, cryptonote::NOTIFY_RESPONSE_BLOCK_HEADERS::request& rsp){return true;}
+    bool check_block_headers(const crypto::hash& prevId, const std::vector<cryptonote::BlockShortHeader>& headers, const std::vector<crypto::hash>& ids, cryptonote::DifficultyWindow& window){return true;}
   };
 }
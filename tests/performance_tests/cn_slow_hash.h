@@ -20,10 +20,13 @@
 #include "crypto/crypto.h"
 #include "cryptonote_core/cryptonote_basic.h"
 
+#include "performance_tests.h"
+
+template<size_t ways>
 class test_cn_slow_hash
 {
 public:
-  static const size_t loop_count = 10;
+  static const size_t loop_count = 20 / ways;
 
 #pragma pack(push, 1)
   struct data_t
@@ -42,18 +45,42 @@ public:
     if (!epee::string_tools::hex_to_pod("bbec2cacf69866a8e740380fe7b818fc78f8571221742d729d9d02d7f8989b87", m_expected_hash))
       return false;
 
+    for (size_t i = 0; i < ways; ++i)
+    {
+      m_blobs[i] = &m_data;
+      m_lengths[i] = sizeof(m_data);
+    }
+
     return true;
   }
 
   bool test()
   {
-    crypto::hash hash;
-    crypto::cn_slow_hash(m_context, &m_data, sizeof(m_data), hash);
-    return hash == m_expected_hash;
+    crypto::hash hashes[ways];
+    if (ways == 1)
+      crypto::cn_slow_hash(m_contexts[0], &m_data, sizeof(m_data), hashes[0]);
+    else
+      crypto::cn_slow_hash_batch(m_contexts, ways, m_blobs, m_lengths, hashes);
+
+    for (size_t i = 0; i < ways; ++i)
+    {
+      if (hashes[i] != m_expected_hash)
+        return false;
+    }
+
+    return true;
   }
 
 private:
   data_t m_data;
+  const void* m_blobs[ways];
+  size_t m_lengths[ways];
   crypto::hash m_expected_hash;
-  crypto::cn_context m_context;
+  crypto::cn_context m_contexts[ways];
+};
+
+template<size_t ways>
+struct hashes_per_call<test_cn_slow_hash<ways> >
+{
+  static const size_t value = ways;
 };
@@ -0,0 +1,154 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstring>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "google/sparse_hash_set"
+
+#include "common/FlatHashTable.h"
+#include "crypto/crypto.h"
+
+typedef tools::FlatHashSet<crypto::key_image> flat_key_image_set;
+typedef google::sparse_hash_set<crypto::key_image> sparse_key_image_set;
+typedef std::unordered_set<crypto::key_image> std_key_image_set;
+typedef tools::FlatHashMap<crypto::hash, uint64_t> flat_transaction_map;
+typedef std::unordered_map<crypto::hash, uint64_t> std_transaction_map;
+
+namespace hash_containers_detail
+{
+  template <typename T>
+  std::vector<T> random_keys(std::mt19937_64& generator, size_t count)
+  {
+    std::vector<T> keys(count);
+    for (T& key : keys)
+    {
+      for (size_t i = 0; i < sizeof(T); i += sizeof(uint64_t))
+      {
+        uint64_t value = generator();
+        memcpy(reinterpret_cast<char*>(&key) + i, &value, sizeof(value));
+      }
+    }
+
+    return keys;
+  }
+
+  template <typename Set, typename Key>
+  void insert(Set& set, const Key& key)
+  {
+    set.insert(key);
+  }
+
+  inline void insert(flat_transaction_map& map, const crypto::hash& key) { map.insert(std::make_pair(key, 0)); }
+  inline void insert(std_transaction_map& map, const crypto::hash& key) { map.insert(std::make_pair(key, 0)); }
+
+  inline void prepare(sparse_key_image_set& set)
+  {
+    crypto::key_image null_image;
+    memset(&null_image, 0, sizeof(null_image));
+    set.set_deleted_key(null_image);
+  }
+
+  template <typename Container>
+  void prepare(Container&)
+  {
+  }
+}
+
+// Looks up a batch of keys in a container filled like the blockchain indexes are, half of them present, as
+// check_tx_inputs and have_tx do.
+template <typename Container>
+class test_hash_container_lookup
+{
+public:
+  static const size_t loop_count = 100;
+  static const size_t container_size = 1000000;
+  static const size_t lookup_count = 100000;
+
+  typedef typename Container::key_type key_type;
+
+  bool init()
+  {
+    std::mt19937_64 generator(0);
+    hash_containers_detail::prepare(m_container);
+    std::vector<key_type> keys = hash_containers_detail::random_keys<key_type>(generator, container_size);
+    for (const key_type& key : keys)
+      hash_containers_detail::insert(m_container, key);
+
+    m_lookups = hash_containers_detail::random_keys<key_type>(generator, lookup_count);
+    for (size_t i = 0; i < lookup_count; i += 2)
+      m_lookups[i] = keys[generator() % keys.size()];
+
+    return true;
+  }
+
+  bool test()
+  {
+    size_t found = 0;
+    for (const key_type& key : m_lookups)
+      found += m_container.count(key);
+
+    return found == lookup_count / 2;
+  }
+
+private:
+  Container m_container;
+  std::vector<key_type> m_lookups;
+};
+
+// Inserts and erases a block worth of keys on top of a filled container, as pushing and popping blocks does.
+template <typename Container>
+class test_hash_container_insert_erase
+{
+public:
+  static const size_t loop_count = 100;
+  static const size_t container_size = 1000000;
+  static const size_t batch_size = 100000;
+
+  typedef typename Container::key_type key_type;
+
+  bool init()
+  {
+    std::mt19937_64 generator(1);
+    hash_containers_detail::prepare(m_container);
+    for (const key_type& key : hash_containers_detail::random_keys<key_type>(generator, container_size))
+      hash_containers_detail::insert(m_container, key);
+
+    m_batch = hash_containers_detail::random_keys<key_type>(generator, batch_size);
+    return true;
+  }
+
+  bool test()
+  {
+    for (const key_type& key : m_batch)
+      hash_containers_detail::insert(m_container, key);
+
+    for (const key_type& key : m_batch)
+      m_container.erase(key);
+
+    return m_container.size() == container_size;
+  }
+
+private:
+  Container m_container;
+  std::vector<key_type> m_batch;
+};
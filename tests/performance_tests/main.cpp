@@ -28,7 +28,9 @@
 #include "generate_key_derivation.h"
 #include "generate_key_image.h"
 #include "generate_key_image_helper.h"
+#include "hash_containers.h"
 #include "is_out_to_acc.h"
+#include "tx_pool.h"
 
 int main(int argc, char** argv)
 {
@@ -71,7 +73,28 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE0(test_derive_public_key);
   TEST_PERFORMANCE0(test_derive_secret_key);
 
-  TEST_PERFORMANCE0(test_cn_slow_hash);
+  TEST_PERFORMANCE1(test_cn_slow_hash, 1);
+  TEST_PERFORMANCE1(test_cn_slow_hash, 2);
+  TEST_PERFORMANCE1(test_cn_slow_hash, 4);
+
+  TEST_PERFORMANCE1(test_hash_container_lookup, flat_key_image_set);
+  TEST_PERFORMANCE1(test_hash_container_lookup, sparse_key_image_set);
+  TEST_PERFORMANCE1(test_hash_container_lookup, std_key_image_set);
+  TEST_PERFORMANCE1(test_hash_container_lookup, flat_transaction_map);
+  TEST_PERFORMANCE1(test_hash_container_lookup, std_transaction_map);
+
+  TEST_PERFORMANCE1(test_hash_container_insert_erase, flat_key_image_set);
+  TEST_PERFORMANCE1(test_hash_container_insert_erase, sparse_key_image_set);
+  TEST_PERFORMANCE1(test_hash_container_insert_erase, std_key_image_set);
+  TEST_PERFORMANCE1(test_hash_container_insert_erase, flat_transaction_map);
+  TEST_PERFORMANCE1(test_hash_container_insert_erase, std_transaction_map);
+
+  TEST_PERFORMANCE1(test_tx_pool_add_take, 10000);
+  TEST_PERFORMANCE1(test_tx_pool_add_take, 100000);
+  TEST_PERFORMANCE1(test_tx_pool_remove_expired, 10000);
+  TEST_PERFORMANCE1(test_tx_pool_remove_expired, 100000);
+  TEST_PERFORMANCE1(test_tx_pool_fill_block_template, 10000);
+  TEST_PERFORMANCE1(test_tx_pool_fill_block_template, 100000);
 
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
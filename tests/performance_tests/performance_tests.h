@@ -108,6 +108,15 @@ private:
   int m_elapsed;
 };
 
+/**
+ * Number of hashes computed by one call of a proof of work test, the hash rate is reported if it isn't 0
+ */
+template <typename T>
+struct hashes_per_call
+{
+  static const size_t value = 0;
+};
+
 template <typename T>
 void run_test(const char* test_name)
 {
@@ -117,7 +126,10 @@ void run_test(const char* test_name)
     std::cout << test_name << " - OK:\n";
     std::cout << "  loop count:    " << T::loop_count << '\n';
     std::cout << "  elapsed:       " << runner.elapsed_time() << " ms\n";
-    std::cout << "  time per call: " << runner.time_per_call() << " ms/call\n" << std::endl;
+    std::cout << "  time per call: " << runner.time_per_call() << " ms/call\n";
+    if (hashes_per_call<T>::value != 0 && runner.elapsed_time() > 0)
+      std::cout << "  hash rate:     " << T::loop_count * hashes_per_call<T>::value * 1000 / runner.elapsed_time() << " H/s\n";
+    std::cout << std::endl;
   }
   else
   {
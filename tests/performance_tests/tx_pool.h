@@ -0,0 +1,190 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "cryptonote_core/cryptonote_basic.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/Currency.h"
+#include "cryptonote_core/tx_pool.h"
+
+namespace tx_pool_detail
+{
+  class transaction_validator : public CryptoNote::ITransactionValidator
+  {
+  public:
+    virtual bool checkTransactionInputs(const cryptonote::Transaction& tx, CryptoNote::BlockInfo& maxUsedBlock) { return true; }
+    virtual bool checkTransactionInputs(const cryptonote::Transaction& tx, CryptoNote::BlockInfo& maxUsedBlock, CryptoNote::BlockInfo& lastFailed) { return true; }
+    virtual bool haveSpentKeyImages(const cryptonote::Transaction& tx) { return false; }
+  };
+
+  class time_provider : public CryptoNote::ITimeProvider
+  {
+  public:
+    time_provider() : m_now(time(nullptr)) {}
+    virtual time_t now() { return m_now; }
+    void advance(time_t seconds) { m_now += seconds; }
+
+  private:
+    time_t m_now;
+  };
+
+  // transactions with random key images and fees, their inputs are accepted by the validator above as they are
+  inline std::vector<cryptonote::Transaction> random_transactions(std::mt19937_64& generator, const cryptonote::Currency& currency, size_t count)
+  {
+    std::vector<cryptonote::Transaction> txs(count);
+    for (cryptonote::Transaction& tx : txs)
+    {
+      uint64_t fee = currency.minimumFee() * (1 + generator() % 100);
+
+      cryptonote::TransactionInputToKey input;
+      input.amount = fee * 1000;
+      input.keyOffsets.push_back(generator() % 1000000);
+      for (size_t i = 0; i < sizeof(input.keyImage); i += sizeof(uint64_t))
+      {
+        uint64_t value = generator();
+        memcpy(reinterpret_cast<char*>(&input.keyImage) + i, &value, sizeof(value));
+      }
+
+      cryptonote::TransactionOutput output;
+      output.amount = input.amount - fee;
+      output.target = cryptonote::TransactionOutputToKey(reinterpret_cast<const crypto::public_key&>(input.keyImage));
+
+      tx.version = cryptonote::CURRENT_TRANSACTION_VERSION;
+      tx.unlockTime = 0;
+      tx.vin.push_back(input);
+      tx.vout.push_back(output);
+    }
+
+    return txs;
+  }
+
+  // a pool filled with the given number of transactions, plus a batch of other ones to add and take
+  template <size_t pool_size>
+  class tx_pool_test_base
+  {
+  public:
+    static const size_t batch_size = 100;
+
+    tx_pool_test_base()
+      : m_currency(cryptonote::CurrencyBuilder().currency())
+      , m_pool(m_currency, m_validator, m_time)
+    {
+    }
+
+    bool init()
+    {
+      std::mt19937_64 generator(0);
+      for (const cryptonote::Transaction& tx : random_transactions(generator, m_currency, pool_size))
+      {
+        cryptonote::tx_verification_context tvc = boost::value_initialized<cryptonote::tx_verification_context>();
+        if (!m_pool.add_tx(tx, tvc, false))
+          return false;
+      }
+
+      m_batch = random_transactions(generator, m_currency, batch_size);
+      for (const cryptonote::Transaction& tx : m_batch)
+        m_batch_ids.push_back(cryptonote::get_transaction_hash(tx));
+
+      return m_pool.get_transactions_count() == pool_size;
+    }
+
+  protected:
+    cryptonote::Currency m_currency;
+    transaction_validator m_validator;
+    time_provider m_time;
+    cryptonote::tx_memory_pool m_pool;
+    std::vector<cryptonote::Transaction> m_batch;
+    std::vector<crypto::hash> m_batch_ids;
+  };
+}
+
+// Adds a batch of transactions to a filled pool and takes them back, as relaying and mining them does.
+template <size_t pool_size>
+class test_tx_pool_add_take : public tx_pool_detail::tx_pool_test_base<pool_size>
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool test()
+  {
+    for (const cryptonote::Transaction& tx : this->m_batch)
+    {
+      cryptonote::tx_verification_context tvc = boost::value_initialized<cryptonote::tx_verification_context>();
+      if (!this->m_pool.add_tx(tx, tvc, false))
+        return false;
+    }
+
+    for (const crypto::hash& id : this->m_batch_ids)
+    {
+      cryptonote::Transaction tx;
+      size_t blob_size;
+      uint64_t fee;
+      if (!this->m_pool.take_tx(id, tx, blob_size, fee))
+        return false;
+    }
+
+    return this->m_pool.get_transactions_count() == pool_size;
+  }
+};
+
+// Runs the periodic removal of expired transactions on a filled pool which has none of them yet.
+template <size_t pool_size>
+class test_tx_pool_remove_expired : public tx_pool_detail::tx_pool_test_base<pool_size>
+{
+public:
+  static const size_t loop_count = 1000;
+
+  bool test()
+  {
+    // the removal runs at most once a minute
+    this->m_time.advance(61);
+    this->m_pool.on_idle();
+    return this->m_pool.get_transactions_count() == pool_size;
+  }
+};
+
+// Builds a block template after a transaction is added to a filled pool, as the miner does after each relay.
+template <size_t pool_size>
+class test_tx_pool_fill_block_template : public tx_pool_detail::tx_pool_test_base<pool_size>
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool test()
+  {
+    const cryptonote::Transaction& tx = this->m_batch.front();
+    cryptonote::tx_verification_context tvc = boost::value_initialized<cryptonote::tx_verification_context>();
+    if (!this->m_pool.add_tx(tx, tvc, false))
+      return false;
+
+    cryptonote::Block block;
+    size_t total_size;
+    uint64_t fee;
+    if (!this->m_pool.fill_block_template(block, 100000, std::numeric_limits<size_t>::max(), 0, total_size, fee) || block.txHashes.empty())
+      return false;
+
+    cryptonote::Transaction taken;
+    size_t blob_size;
+    return this->m_pool.take_tx(this->m_batch_ids.front(), taken, blob_size, fee);
+  }
+};
@@ -0,0 +1,108 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_core/BlockCacheJournal.h"
+
+#include "unit_tests_utils.h"
+
+using cryptonote::BlockCacheJournal;
+using unit_test::makeHash;
+
+namespace {
+  BlockCacheJournal::Record makeRecord(BlockCacheJournal::RecordType type, uint64_t height, const std::string& blob) {
+    BlockCacheJournal::Record record = { type, height, makeHash(height), blob };
+    return record;
+  }
+
+  class BlockCacheJournalTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() override {
+      m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+      boost::filesystem::create_directories(m_dir);
+      m_fileName = (m_dir / "journal").string();
+    }
+
+    virtual void TearDown() override {
+      boost::filesystem::remove_all(m_dir);
+    }
+
+    boost::filesystem::path m_dir;
+    std::string m_fileName;
+  };
+}
+
+TEST_F(BlockCacheJournalTest, appendedRecordsAreLoaded) {
+  BlockCacheJournal journal;
+  ASSERT_TRUE(journal.reset(m_fileName, makeHash(7)));
+  ASSERT_TRUE(journal.append(makeRecord(BlockCacheJournal::BLOCK_PUSHED, 10, std::string())));
+  ASSERT_TRUE(journal.append(makeRecord(BlockCacheJournal::BLOCK_POPPED, 10, "block blob")));
+  ASSERT_EQ(2, journal.recordCount());
+  journal.close();
+
+  crypto::hash tailId;
+  std::vector<BlockCacheJournal::Record> records;
+  ASSERT_TRUE(BlockCacheJournal::load(m_fileName, tailId, records));
+  ASSERT_EQ(makeHash(7), tailId);
+  ASSERT_EQ(2, records.size());
+  ASSERT_EQ(BlockCacheJournal::BLOCK_PUSHED, records[0].type);
+  ASSERT_EQ(10, records[0].height);
+  ASSERT_EQ(makeHash(10), records[0].blockHash);
+  ASSERT_TRUE(records[0].blockBlob.empty());
+  ASSERT_EQ(BlockCacheJournal::BLOCK_POPPED, records[1].type);
+  ASSERT_EQ("block blob", records[1].blockBlob);
+}
+
+TEST_F(BlockCacheJournalTest, tornRecordIsIgnored) {
+  BlockCacheJournal journal;
+  ASSERT_TRUE(journal.reset(m_fileName, makeHash(1)));
+  ASSERT_TRUE(journal.append(makeRecord(BlockCacheJournal::BLOCK_PUSHED, 1, std::string())));
+  ASSERT_TRUE(journal.append(makeRecord(BlockCacheJournal::BLOCK_POPPED, 1, std::string(100, 'x'))));
+  journal.close();
+
+  boost::filesystem::resize_file(m_fileName, boost::filesystem::file_size(m_fileName) - 10);
+
+  crypto::hash tailId;
+  std::vector<BlockCacheJournal::Record> records;
+  ASSERT_TRUE(BlockCacheJournal::load(m_fileName, tailId, records));
+  ASSERT_EQ(1, records.size());
+  ASSERT_EQ(BlockCacheJournal::BLOCK_PUSHED, records[0].type);
+}
+
+TEST_F(BlockCacheJournalTest, resetDiscardsRecords) {
+  BlockCacheJournal journal;
+  ASSERT_TRUE(journal.reset(m_fileName, makeHash(1)));
+  ASSERT_TRUE(journal.append(makeRecord(BlockCacheJournal::BLOCK_PUSHED, 1, std::string())));
+  ASSERT_TRUE(journal.reset(m_fileName, makeHash(2)));
+  ASSERT_EQ(0, journal.recordCount());
+  journal.close();
+
+  crypto::hash tailId;
+  std::vector<BlockCacheJournal::Record> records;
+  ASSERT_TRUE(BlockCacheJournal::load(m_fileName, tailId, records));
+  ASSERT_EQ(makeHash(2), tailId);
+  ASSERT_TRUE(records.empty());
+}
+
+TEST_F(BlockCacheJournalTest, missingJournalIsNotLoaded) {
+  crypto::hash tailId;
+  std::vector<BlockCacheJournal::Record> records;
+  ASSERT_FALSE(BlockCacheJournal::load(m_fileName, tailId, records));
+}
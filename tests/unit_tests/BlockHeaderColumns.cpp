@@ -0,0 +1,96 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include "cryptonote_core/BlockHeaderColumns.h"
+
+using cryptonote::BlockHeaderColumns;
+
+namespace {
+  void fill(BlockHeaderColumns& headers, uint64_t count) {
+    for (uint64_t i = 0; i < count; ++i) {
+      headers.push(1000 + 10 * i, 100 * (i + 1), 500 * i, 7 * i, i < count / 2 ? 1 : 2);
+    }
+  }
+}
+
+TEST(BlockHeaderColumns, pushAndPopKeepColumnsAligned) {
+  BlockHeaderColumns headers;
+  ASSERT_TRUE(headers.empty());
+
+  fill(headers, 10);
+  ASSERT_EQ(10, headers.size());
+  ASSERT_EQ(1090, headers.timestamp(9));
+  ASSERT_EQ(1000, headers.cumulativeDifficulty(9));
+  ASSERT_EQ(4500, headers.cumulativeSize(9));
+  ASSERT_EQ(63, headers.generatedCoins(9));
+  ASSERT_EQ(2, headers.majorVersion(9));
+
+  headers.pop();
+  headers.push(2000, 2000, 2000, 2000, 3);
+  ASSERT_EQ(10, headers.size());
+  ASSERT_EQ(1080, headers.timestamp(8));
+  ASSERT_EQ(2000, headers.timestamp(9));
+  ASSERT_EQ(3, headers.majorVersion(9));
+
+  headers.clear();
+  ASSERT_TRUE(headers.empty());
+}
+
+TEST(BlockHeaderColumns, timestampLowerBound) {
+  BlockHeaderColumns headers;
+  fill(headers, 10);
+
+  ASSERT_EQ(0, headers.timestampLowerBound(0, 0));
+  ASSERT_EQ(3, headers.timestampLowerBound(0, 1025));
+  ASSERT_EQ(3, headers.timestampLowerBound(0, 1030));
+  ASSERT_EQ(5, headers.timestampLowerBound(5, 1030));
+  ASSERT_EQ(10, headers.timestampLowerBound(0, 5000));
+  ASSERT_EQ(10, headers.timestampLowerBound(20, 0));
+}
+
+TEST(BlockHeaderColumns, serializationRoundTrip) {
+  BlockHeaderColumns headers;
+  fill(headers, 100);
+
+  std::stringstream stream;
+  {
+    boost::archive::binary_oarchive archive(stream);
+    archive << headers;
+  }
+
+  BlockHeaderColumns loaded;
+  {
+    boost::archive::binary_iarchive archive(stream);
+    archive >> loaded;
+  }
+
+  ASSERT_EQ(headers.size(), loaded.size());
+  for (uint64_t i = 0; i < headers.size(); ++i) {
+    ASSERT_EQ(headers.timestamp(i), loaded.timestamp(i));
+    ASSERT_EQ(headers.cumulativeDifficulty(i), loaded.cumulativeDifficulty(i));
+    ASSERT_EQ(headers.cumulativeSize(i), loaded.cumulativeSize(i));
+    ASSERT_EQ(headers.generatedCoins(i), loaded.generatedCoins(i));
+    ASSERT_EQ(headers.majorVersion(i), loaded.majorVersion(i));
+  }
+}
@@ -0,0 +1,148 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <memory>
+
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_core/blockchain_storage.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/Currency.h"
+#include "cryptonote_core/ITimeProvider.h"
+#include "cryptonote_core/tx_pool.h"
+
+using namespace cryptonote;
+
+namespace {
+  class TransactionValidator : public CryptoNote::ITransactionValidator {
+    virtual bool checkTransactionInputs(const Transaction& tx, BlockInfo& maxUsedBlock) { return true; }
+    virtual bool checkTransactionInputs(const Transaction& tx, BlockInfo& maxUsedBlock, BlockInfo& lastFailed) { return true; }
+    virtual bool haveSpentKeyImages(const Transaction& tx) { return false; }
+  };
+
+  class BlockHeadersCheckTest : public ::testing::Test {
+  protected:
+    BlockHeadersCheckTest() :
+      // a short target with blocks found every second makes the difficulty grow above 1 within a few blocks
+      m_currency(CurrencyBuilder().difficultyTarget(2).currency()),
+      m_pool(m_currency, m_validator, m_timeProvider) {
+    }
+
+    virtual void SetUp() override {
+      m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+      m_storage.reset(new blockchain_storage(m_currency, m_pool));
+      ASSERT_TRUE(m_storage->init(m_dir.string(), false));
+      m_genesisId = m_storage->get_tail_id();
+    }
+
+    virtual void TearDown() override {
+      // the block files are closed when the storage is destroyed
+      m_storage->deinit();
+      m_storage.reset();
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+
+    // headers of a chain following the genesis block, each with a nonce meeting the difficulty of its height or,
+    // for the bad one, failing it
+    void makeChain(size_t count, size_t badHeader, std::vector<BlockShortHeader>& headers, std::vector<crypto::hash>& ids) {
+      std::vector<uint64_t> timestamps;
+      std::vector<difficulty_type> cumulativeDifficulties;
+      difficulty_type cumulativeDifficulty = 1;
+      crypto::hash prevId = m_genesisId;
+      crypto::cn_context context;
+      for (size_t i = 0; i < count; ++i) {
+        Block block = boost::value_initialized<Block>();
+        block.majorVersion = BLOCK_MAJOR_VERSION_1;
+        block.prevId = prevId;
+        block.timestamp = m_currency.genesisBlock().timestamp + 1 + i;
+        BlockShortHeader header = get_block_short_header(block);
+
+        difficulty_type difficulty = m_currency.nextDifficulty(timestamps, cumulativeDifficulties);
+        for (;; ++header.nonce) {
+          blobdata blob;
+          size_t nonceOffset;
+          ASSERT_TRUE(get_block_longhash_blob(header, blob, nonceOffset));
+          crypto::hash longHash;
+          crypto::cn_slow_hash(context, blob.data(), blob.size(), longHash);
+          if (m_currency.checkProofOfWork(header, difficulty, longHash) != (i == badHeader)) {
+            break;
+          }
+        }
+
+        cumulativeDifficulty += difficulty;
+        timestamps.push_back(header.timestamp);
+        cumulativeDifficulties.push_back(cumulativeDifficulty);
+        headers.push_back(header);
+        ids.push_back(null_hash);
+        ASSERT_TRUE(get_block_hash(header, ids.back()));
+        prevId = ids.back();
+      }
+    }
+
+    boost::filesystem::path m_dir;
+    Currency m_currency;
+    TransactionValidator m_validator;
+    CryptoNote::RealTimeProvider m_timeProvider;
+    tx_memory_pool m_pool;
+    std::unique_ptr<blockchain_storage> m_storage;
+    crypto::hash m_genesisId;
+  };
+
+  template<typename T>
+  std::vector<T> part(const std::vector<T>& items, size_t begin, size_t end) {
+    return std::vector<T>(items.begin() + begin, items.begin() + end);
+  }
+}
+
+TEST_F(BlockHeadersCheckTest, checksChainInParts) {
+  std::vector<BlockShortHeader> headers;
+  std::vector<crypto::hash> ids;
+  makeChain(8, 8, headers, ids);
+
+  DifficultyWindow window = DifficultyWindow();
+  ASSERT_TRUE(m_storage->checkBlockHeaders(m_genesisId, part(headers, 0, 4), part(ids, 0, 4), window));
+  ASSERT_EQ(ids[3], window.lastBlockId);
+  ASSERT_EQ(4, window.lastBlockHeight);
+  ASSERT_TRUE(m_storage->checkBlockHeaders(ids[3], part(headers, 4, 8), part(ids, 4, 8), window));
+  ASSERT_EQ(ids[7], window.lastBlockId);
+}
+
+TEST_F(BlockHeadersCheckTest, rejectsWeakProofOfWorkInLaterPart) {
+  std::vector<BlockShortHeader> headers;
+  std::vector<crypto::hash> ids;
+  makeChain(8, 6, headers, ids);
+
+  // the blocks of the first part are not in the blockchain yet, the second part continues from their window
+  DifficultyWindow window = DifficultyWindow();
+  ASSERT_TRUE(m_storage->checkBlockHeaders(m_genesisId, part(headers, 0, 4), part(ids, 0, 4), window));
+  ASSERT_FALSE(m_storage->checkBlockHeaders(ids[3], part(headers, 4, 8), part(ids, 4, 8), window));
+  ASSERT_EQ(ids[3], window.lastBlockId);
+}
+
+TEST_F(BlockHeadersCheckTest, rejectsBrokenLinksAndUnknownParents) {
+  std::vector<BlockShortHeader> headers;
+  std::vector<crypto::hash> ids;
+  makeChain(4, 4, headers, ids);
+
+  DifficultyWindow window = DifficultyWindow();
+  ASSERT_FALSE(m_storage->checkBlockHeaders(m_genesisId, part(headers, 1, 4), part(ids, 1, 4), window));
+  ASSERT_FALSE(m_storage->checkBlockHeaders(ids[0], part(headers, 1, 4), part(ids, 1, 4), window));
+  ASSERT_TRUE(m_storage->checkBlockHeaders(m_genesisId, headers, ids, window));
+}
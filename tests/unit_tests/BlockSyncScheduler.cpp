@@ -0,0 +1,255 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_protocol/BlockSyncScheduler.h"
+
+#include "unit_tests_utils.h"
+
+using cryptonote::BlockSyncScheduler;
+using unit_test::makeHash;
+
+namespace {
+  const time_t TIMEOUT = 60;
+
+  BlockSyncScheduler::PeerId makePeer(uint8_t value) {
+    BlockSyncScheduler::PeerId peer = BlockSyncScheduler::PeerId();
+    peer.data[0] = value;
+    return peer;
+  }
+
+  std::list<crypto::hash> makeIds(uint64_t first, uint64_t count) {
+    std::list<crypto::hash> ids;
+    for (uint64_t i = first; i < first + count; ++i) {
+      ids.push_back(makeHash(i));
+    }
+
+    return ids;
+  }
+
+  cryptonote::block_complete_entry makeBlock(const crypto::hash& id) {
+    cryptonote::block_complete_entry block;
+    block.block.assign(reinterpret_cast<const char*>(&id), sizeof(id));
+    return block;
+  }
+
+  cryptonote::Block makeParsedBlock(const crypto::hash& id) {
+    cryptonote::Block block = cryptonote::Block();
+    block.prevId = id;
+    return block;
+  }
+
+  void deliverAll(BlockSyncScheduler& scheduler, const BlockSyncScheduler::PeerId& peer, const std::list<crypto::hash>& ids, time_t now) {
+    for (const crypto::hash& id : ids) {
+      ASSERT_TRUE(scheduler.deliverBlock(peer, id, makeBlock(id), makeParsedBlock(id)));
+    }
+
+    ASSERT_EQ(0, scheduler.completeRequest(peer, std::list<crypto::hash>(), ids.size() * 100, now));
+  }
+}
+
+TEST(BlockSyncScheduler, splitsBlocksBetweenPeersAndReleasesThemInOrder) {
+  BlockSyncScheduler scheduler(4, 100, TIMEOUT);
+  BlockSyncScheduler::PeerId peer1 = makePeer(1);
+  BlockSyncScheduler::PeerId peer2 = makePeer(2);
+  ASSERT_EQ(8, scheduler.addBlocks(peer1, makeIds(0, 8)));
+  ASSERT_EQ(2, scheduler.addBlocks(peer2, makeIds(6, 4)));
+
+  std::list<crypto::hash> ids1;
+  std::list<crypto::hash> ids2;
+  ASSERT_TRUE(scheduler.requestBlocks(peer1, 0, ids1));
+  ASSERT_TRUE(scheduler.requestBlocks(peer2, 0, ids2));
+  ASSERT_EQ(makeIds(0, 4), ids1);
+  ASSERT_EQ(makeIds(6, 4), ids2);
+
+  // a peer gets a single request at a time
+  std::list<crypto::hash> more;
+  ASSERT_FALSE(scheduler.requestBlocks(peer1, 0, more));
+
+  // blocks after a gap are held back
+  deliverAll(scheduler, peer2, ids2, 1);
+  std::list<cryptonote::block_complete_entry> blocks;
+  std::vector<cryptonote::Block> parsedBlocks;
+  std::vector<crypto::hash> ids;
+  std::vector<BlockSyncScheduler::PeerId> suppliers;
+  ASSERT_EQ(0, scheduler.takeReadyBlocks(blocks, parsedBlocks, ids, suppliers));
+
+  deliverAll(scheduler, peer1, ids1, 1);
+  ASSERT_EQ(4, scheduler.takeReadyBlocks(blocks, parsedBlocks, ids, suppliers));
+  scheduler.finishImport(ids.size());
+
+  ids1.clear();
+  ASSERT_TRUE(scheduler.requestBlocks(peer1, 1, ids1));
+  ASSERT_EQ(makeIds(4, 2), ids1);
+  deliverAll(scheduler, peer1, ids1, 2);
+
+  blocks.clear();
+  parsedBlocks.clear();
+  ids.clear();
+  suppliers.clear();
+  ASSERT_EQ(6, scheduler.takeReadyBlocks(blocks, parsedBlocks, ids, suppliers));
+  ASSERT_EQ(makeHash(4), ids.front());
+  ASSERT_EQ(makeHash(9), ids.back());
+  ASSERT_EQ(6, blocks.size());
+  ASSERT_EQ(makeHash(4), parsedBlocks.front().prevId);
+  ASSERT_EQ(makeHash(9), parsedBlocks.back().prevId);
+  ASSERT_EQ(peer1, suppliers.front());
+  ASSERT_EQ(peer2, suppliers.back());
+
+  scheduler.finishImport(ids.size());
+  ASSERT_EQ(0, scheduler.size());
+  ASSERT_FALSE(scheduler.hasBlocksOf(peer1));
+  ASSERT_FALSE(scheduler.hasBlocksOf(peer2));
+}
+
+TEST(BlockSyncScheduler, givesExpiredRequestsToOtherPeers) {
+  BlockSyncScheduler scheduler(10, 100, TIMEOUT);
+  BlockSyncScheduler::PeerId slow = makePeer(1);
+  BlockSyncScheduler::PeerId fast = makePeer(2);
+  scheduler.addBlocks(slow, makeIds(0, 10));
+  scheduler.addBlocks(fast, makeIds(0, 10));
+
+  std::list<crypto::hash> slowIds;
+  std::list<crypto::hash> fastIds;
+  ASSERT_TRUE(scheduler.requestBlocks(slow, 0, slowIds));
+  ASSERT_FALSE(scheduler.requestBlocks(fast, 0, fastIds));
+
+  ASSERT_TRUE(scheduler.expireRequests(TIMEOUT - 1).empty());
+  std::vector<BlockSyncScheduler::PeerId> expired = scheduler.expireRequests(TIMEOUT);
+  ASSERT_EQ(1, expired.size());
+  ASSERT_EQ(slow, expired.front());
+  ASSERT_EQ(5, scheduler.getPeerStatistics(slow).batchSize);
+  ASSERT_TRUE(scheduler.isRequesting(slow));
+
+  ASSERT_TRUE(scheduler.requestBlocks(fast, TIMEOUT, fastIds));
+  ASSERT_EQ(slowIds, fastIds);
+  deliverAll(scheduler, fast, fastIds, TIMEOUT + 1);
+
+  // the late answer of the slow peer is still accepted, its blocks are already delivered
+  deliverAll(scheduler, slow, slowIds, TIMEOUT + 2);
+  ASSERT_FALSE(scheduler.isRequesting(slow));
+
+  std::list<cryptonote::block_complete_entry> blocks;
+  std::vector<cryptonote::Block> parsedBlocks;
+  std::vector<crypto::hash> ids;
+  std::vector<BlockSyncScheduler::PeerId> suppliers;
+  ASSERT_EQ(10, scheduler.takeReadyBlocks(blocks, parsedBlocks, ids, suppliers));
+  ASSERT_EQ(fast, suppliers.front());
+}
+
+TEST(BlockSyncScheduler, sizesBatchesByDeliveryRate) {
+  BlockSyncScheduler scheduler(100, 1000, TIMEOUT);
+  BlockSyncScheduler::PeerId peer = makePeer(1);
+  scheduler.addBlocks(peer, makeIds(0, 500));
+
+  std::list<crypto::hash> ids;
+  ASSERT_TRUE(scheduler.requestBlocks(peer, 0, ids));
+  ASSERT_EQ(100, ids.size());
+
+  // 100 blocks in 60 seconds, so 50 blocks are expected in half of the timeout
+  deliverAll(scheduler, peer, ids, 60);
+  ASSERT_EQ(50, scheduler.getPeerStatistics(peer).batchSize);
+  ASSERT_EQ(100 * 100 / 60, scheduler.getPeerStatistics(peer).throughput);
+
+  ids.clear();
+  ASSERT_TRUE(scheduler.requestBlocks(peer, 60, ids));
+  ASSERT_EQ(50, ids.size());
+  deliverAll(scheduler, peer, ids, 61);
+  ASSERT_EQ(100, scheduler.getPeerStatistics(peer).batchSize);
+}
+
+TEST(BlockSyncScheduler, rejectsBlocksNotRequested) {
+  BlockSyncScheduler scheduler(10, 100, TIMEOUT);
+  BlockSyncScheduler::PeerId peer1 = makePeer(1);
+  BlockSyncScheduler::PeerId peer2 = makePeer(2);
+  scheduler.addBlocks(peer1, makeIds(0, 2));
+  scheduler.addBlocks(peer2, makeIds(0, 2));
+
+  std::list<crypto::hash> ids;
+  ASSERT_TRUE(scheduler.requestBlocks(peer1, 0, ids));
+  ASSERT_FALSE(scheduler.deliverBlock(peer2, makeHash(0), makeBlock(makeHash(0)), makeParsedBlock(makeHash(0))));
+  ASSERT_FALSE(scheduler.deliverBlock(peer1, makeHash(5), makeBlock(makeHash(5)), makeParsedBlock(makeHash(5))));
+
+  // blocks neither delivered nor reported missing are counted
+  ASSERT_TRUE(scheduler.deliverBlock(peer1, makeHash(0), makeBlock(makeHash(0)), makeParsedBlock(makeHash(0))));
+  ASSERT_EQ(1, scheduler.completeRequest(peer1, std::list<crypto::hash>(), 0, 1));
+}
+
+TEST(BlockSyncScheduler, dropsBlocksNoPeerHas) {
+  BlockSyncScheduler scheduler(10, 100, TIMEOUT);
+  BlockSyncScheduler::PeerId peer1 = makePeer(1);
+  BlockSyncScheduler::PeerId peer2 = makePeer(2);
+  scheduler.addBlocks(peer1, makeIds(0, 6));
+  scheduler.addBlocks(peer2, makeIds(0, 3));
+
+  // a missed block is requested from the other peers which have it
+  std::list<crypto::hash> ids;
+  ASSERT_TRUE(scheduler.requestBlocks(peer2, 0, ids));
+  ASSERT_EQ(0, scheduler.completeRequest(peer2, makeIds(0, 3), 0, 1));
+  ASSERT_FALSE(scheduler.hasBlocksOf(peer2));
+  ASSERT_EQ(6, scheduler.size());
+
+  ids.clear();
+  ASSERT_TRUE(scheduler.requestBlocks(peer1, 1, ids));
+  ASSERT_EQ(6, ids.size());
+
+  // the blocks of a closed connection no other peer announced are dropped
+  scheduler.removePeer(peer1);
+  ASSERT_EQ(0, scheduler.size());
+  ASSERT_EQ(1, scheduler.getPeers().size());
+}
+
+TEST(BlockSyncScheduler, downloadsBlocksAgainAfterFailedImport) {
+  BlockSyncScheduler scheduler(10, 100, TIMEOUT);
+  BlockSyncScheduler::PeerId peer1 = makePeer(1);
+  BlockSyncScheduler::PeerId peer2 = makePeer(2);
+  scheduler.addBlocks(peer1, makeIds(0, 4));
+  scheduler.addBlocks(peer2, makeIds(0, 4));
+
+  std::list<crypto::hash> ids;
+  ASSERT_TRUE(scheduler.requestBlocks(peer1, 0, ids));
+  deliverAll(scheduler, peer1, ids, 1);
+
+  std::list<cryptonote::block_complete_entry> blocks;
+  std::vector<cryptonote::Block> parsedBlocks;
+  std::vector<crypto::hash> blockIds;
+  std::vector<BlockSyncScheduler::PeerId> suppliers;
+  ASSERT_EQ(4, scheduler.takeReadyBlocks(blocks, parsedBlocks, blockIds, suppliers));
+  scheduler.finishImport(1);
+  scheduler.removePeer(peer1);
+  ASSERT_EQ(3, scheduler.size());
+
+  ids.clear();
+  ASSERT_TRUE(scheduler.requestBlocks(peer2, 2, ids));
+  ASSERT_EQ(makeIds(1, 3), ids);
+}
+
+TEST(BlockSyncScheduler, requestsOnlyWithinWindow) {
+  BlockSyncScheduler scheduler(10, 5, TIMEOUT);
+  BlockSyncScheduler::PeerId peer1 = makePeer(1);
+  BlockSyncScheduler::PeerId peer2 = makePeer(2);
+  scheduler.addBlocks(peer1, makeIds(0, 20));
+  scheduler.addBlocks(peer2, makeIds(0, 20));
+
+  std::list<crypto::hash> ids;
+  ASSERT_TRUE(scheduler.requestBlocks(peer1, 0, ids));
+  ASSERT_EQ(5, ids.size());
+
+  std::list<crypto::hash> otherIds;
+  ASSERT_FALSE(scheduler.requestBlocks(peer2, 0, otherIds));
+}
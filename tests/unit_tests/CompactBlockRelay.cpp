@@ -0,0 +1,253 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <unordered_set>
+
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/Currency.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler.h"
+#include "p2p/net_node_common.h"
+
+using namespace cryptonote;
+
+namespace {
+  // a pool of transaction ids which fails blocks with transactions it has not, as the blockchain does
+  class TestCore {
+  public:
+    TestCore(const Currency& currency) : m_currency(currency), m_addedBlocks(0) {
+    }
+
+    const Currency& currency() const { return m_currency; }
+    void on_synchronized() {}
+    bool on_idle() { return true; }
+    void pause_mining() {}
+    void update_block_template_and_resume_mining() {}
+    bool get_stat_info(core_stat_info& st_inf) { return true; }
+    uint64_t get_current_blockchain_height() { return 1; }
+    bool get_blockchain_top(uint64_t& height, crypto::hash& top_id) { height = 0; top_id = null_hash; return true; }
+    bool get_short_chain_history(std::list<crypto::hash>& ids) { return true; }
+    bool have_block(const crypto::hash& id) { return false; }
+    bool have_transaction(const crypto::hash& id) { return m_transactions.count(id) != 0; }
+    bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) { return true; }
+    bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote_connection_context& context) { return true; }
+    bool handle_get_block_headers(const NOTIFY_REQUEST_BLOCK_HEADERS::request& arg, NOTIFY_RESPONSE_BLOCK_HEADERS::request& rsp) { return true; }
+    bool check_block_headers(const crypto::hash& prevId, const std::vector<BlockShortHeader>& headers, const std::vector<crypto::hash>& ids, DifficultyWindow& window) { return true; }
+    bool handle_incoming_blocks(const std::list<block_complete_entry>& blocks, const std::vector<Block>& parsedBlocks, tx_verification_context& tvc, block_verification_context& bvc) { return true; }
+
+    bool handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block) {
+      m_transactions.insert(get_blob_hash(tx_blob));
+      return true;
+    }
+
+    bool handle_incoming_txs(const std::list<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvcs, bool keeped_by_block) {
+      for (const blobdata& tx_blob : tx_blobs) {
+        tvcs.push_back(boost::value_initialized<tx_verification_context>());
+        handle_incoming_tx(tx_blob, tvcs.back(), keeped_by_block);
+      }
+
+      return true;
+    }
+
+    bool handle_incoming_block_blob(const blobdata& block_blob, block_verification_context& bvc, bool control_miner, bool relay_block) {
+      Block b;
+      if (!parse_and_validate_block_from_blob(block_blob, b)) {
+        bvc.m_verifivation_failed = true;
+        return false;
+      }
+
+      for (const crypto::hash& tx_id : b.txHashes) {
+        if (!have_transaction(tx_id)) {
+          bvc.m_verifivation_failed = true;
+          return false;
+        }
+      }
+
+      ++m_addedBlocks;
+      bvc.m_added_to_main_chain = true;
+      return true;
+    }
+
+    void get_transactions(const std::vector<crypto::hash>& txs_ids, std::list<Transaction>& txs, std::list<crypto::hash>& missed_txs) {
+      txs.resize(txs_ids.size());
+    }
+
+    std::unordered_set<crypto::hash> m_transactions;
+    size_t m_addedBlocks;
+
+  private:
+    const Currency& m_currency;
+  };
+
+  class TestP2p : public nodetool::p2p_endpoint_stub<cryptonote_connection_context> {
+  public:
+    TestP2p() : m_droppedCount(0) {
+    }
+
+    virtual bool invoke_notify_to_peer(int command, const std::string& req_buff, const epee::net_utils::connection_context_base& context) {
+      m_notifications.push_back(std::make_pair(command, req_buff));
+      return true;
+    }
+
+    virtual bool invoke_notify_to_peer(int command, const epee::net_utils::shared_buffer& req_buff, const epee::net_utils::connection_context_base& context) {
+      m_notifications.push_back(std::make_pair(command, *req_buff));
+      m_sharedNotifications.push_back(std::make_pair(command, req_buff));
+      return true;
+    }
+
+    virtual void for_each_connection(std::function<bool(cryptonote_connection_context&, nodetool::peerid_type)> f) {
+      for (cryptonote_connection_context& context : m_connections) {
+        f(context, 1);
+      }
+    }
+
+    virtual bool drop_connection(const epee::net_utils::connection_context_base& context) {
+      ++m_droppedCount;
+      return true;
+    }
+
+    std::vector<std::pair<int, std::string>> m_notifications;
+    std::vector<std::pair<int, epee::net_utils::shared_buffer>> m_sharedNotifications;
+    std::vector<cryptonote_connection_context> m_connections;
+    size_t m_droppedCount;
+  };
+
+  class CompactBlockRelayTest : public ::testing::Test {
+  protected:
+    CompactBlockRelayTest() :
+      m_currency(CurrencyBuilder().currency()),
+      m_core(m_currency),
+      m_handler(m_core, &m_p2p),
+      m_context(boost::value_initialized<cryptonote_connection_context>()),
+      m_block(boost::value_initialized<Block>()) {
+      m_context.m_state = cryptonote_connection_context::state_normal;
+      m_context.m_protocol_version = BC_CURRENT_PROTOCOL_VERSION;
+      m_block.majorVersion = BLOCK_MAJOR_VERSION_1;
+      m_block.txHashes.push_back(get_blob_hash(std::string("pool transaction")));
+      m_block.txHashes.push_back(get_blob_hash(std::string("missing transaction")));
+    }
+
+    template<class t_notify>
+    void notify(typename t_notify::request& arg) {
+      std::string blob;
+      ASSERT_TRUE(epee::serialization::store_t_to_binary(arg, blob));
+      std::string response;
+      bool handled = false;
+      m_handler.handle_invoke_map(true, t_notify::ID, blob, response, m_context, handled);
+      ASSERT_TRUE(handled);
+    }
+
+    void receiveCompactBlock() {
+      NOTIFY_NEW_COMPACT_BLOCK::request arg = boost::value_initialized<NOTIFY_NEW_COMPACT_BLOCK::request>();
+      arg.b.block = block_to_blob(m_block);
+      notify<NOTIFY_NEW_COMPACT_BLOCK>(arg);
+    }
+
+    void receiveTransaction(const std::string& tx_blob) {
+      NOTIFY_RESPONSE_GET_OBJECTS::request arg = boost::value_initialized<NOTIFY_RESPONSE_GET_OBJECTS::request>();
+      arg.txs.push_back(tx_blob);
+      notify<NOTIFY_RESPONSE_GET_OBJECTS>(arg);
+    }
+
+    // the transactions of the last notification sent, which must be a request for them
+    std::list<crypto::hash> requestedTransactions() {
+      NOTIFY_REQUEST_GET_OBJECTS::request req;
+      EXPECT_FALSE(m_p2p.m_notifications.empty());
+      EXPECT_EQ(static_cast<int>(NOTIFY_REQUEST_GET_OBJECTS::ID), m_p2p.m_notifications.back().first);
+      EXPECT_TRUE(epee::serialization::load_t_from_binary(req, m_p2p.m_notifications.back().second));
+      return req.txs;
+    }
+
+    Currency m_currency;
+    TestCore m_core;
+    TestP2p m_p2p;
+    t_cryptonote_protocol_handler<TestCore> m_handler;
+    cryptonote_connection_context m_context;
+    Block m_block;
+  };
+}
+
+TEST_F(CompactBlockRelayTest, addsBlockOnceMissingTransactionsArrive) {
+  m_core.m_transactions.insert(m_block.txHashes[0]);
+  receiveCompactBlock();
+  ASSERT_EQ(std::list<crypto::hash>(1, m_block.txHashes[1]), requestedTransactions());
+  ASSERT_EQ(0, m_core.m_addedBlocks);
+
+  receiveTransaction("missing transaction");
+  ASSERT_EQ(1, m_core.m_addedBlocks);
+  ASSERT_EQ(0, m_p2p.m_droppedCount);
+}
+
+TEST_F(CompactBlockRelayTest, requestsPoolTransactionsRemovedDuringWait) {
+  m_core.m_transactions.insert(m_block.txHashes[0]);
+  receiveCompactBlock();
+
+  // evicted from the pool while the other transaction was requested
+  m_core.m_transactions.erase(m_block.txHashes[0]);
+  receiveTransaction("missing transaction");
+  ASSERT_EQ(std::list<crypto::hash>(1, m_block.txHashes[0]), requestedTransactions());
+  ASSERT_EQ(0, m_core.m_addedBlocks);
+  ASSERT_EQ(0, m_p2p.m_droppedCount);
+
+  receiveTransaction("pool transaction");
+  ASSERT_EQ(1, m_core.m_addedBlocks);
+  ASSERT_EQ(0, m_p2p.m_droppedCount);
+}
+
+TEST_F(CompactBlockRelayTest, requestsChainIfTransactionsKeepMissing) {
+  m_core.m_transactions.insert(m_block.txHashes[0]);
+  receiveCompactBlock();
+  m_core.m_transactions.erase(m_block.txHashes[0]);
+  receiveTransaction("missing transaction");
+  m_core.m_transactions.erase(m_block.txHashes[1]);
+  receiveTransaction("pool transaction");
+
+  ASSERT_EQ(0, m_core.m_addedBlocks);
+  ASSERT_EQ(0, m_p2p.m_droppedCount);
+  ASSERT_EQ(static_cast<int>(NOTIFY_REQUEST_CHAIN::ID), m_p2p.m_notifications.back().first);
+  ASSERT_EQ(cryptonote_connection_context::state_synchronizing, m_context.m_state);
+}
+
+TEST_F(CompactBlockRelayTest, relaysOneSharedBlobPerAnnouncement) {
+  for (uint8_t i = 1; i <= 4; ++i) {
+    boost::uuids::uuid connectionId = boost::uuids::uuid();
+    connectionId.data[0] = i;
+    cryptonote_connection_context context = boost::value_initialized<cryptonote_connection_context>();
+    static_cast<epee::net_utils::connection_context_base&>(context) = epee::net_utils::connection_context_base(connectionId, 0, 0, false);
+    context.m_protocol_version = i <= 2 ? BC_CURRENT_PROTOCOL_VERSION : 0;
+    m_p2p.m_connections.push_back(context);
+  }
+
+  NOTIFY_NEW_BLOCK::request arg = boost::value_initialized<NOTIFY_NEW_BLOCK::request>();
+  arg.b.block = block_to_blob(m_block);
+  i_cryptonote_protocol& protocol = m_handler;
+  ASSERT_TRUE(protocol.relay_block(arg, m_context));
+
+  const auto& sent = m_p2p.m_sharedNotifications;
+  ASSERT_EQ(4, sent.size());
+  ASSERT_EQ(static_cast<int>(NOTIFY_NEW_COMPACT_BLOCK::ID), sent[0].first);
+  ASSERT_EQ(static_cast<int>(NOTIFY_NEW_COMPACT_BLOCK::ID), sent[1].first);
+  ASSERT_EQ(static_cast<int>(NOTIFY_NEW_BLOCK::ID), sent[2].first);
+  ASSERT_EQ(static_cast<int>(NOTIFY_NEW_BLOCK::ID), sent[3].first);
+  ASSERT_EQ(sent[0].second.get(), sent[1].second.get());
+  ASSERT_EQ(sent[2].second.get(), sent[3].second.get());
+
+  NOTIFY_NEW_COMPACT_BLOCK::request compactArg;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(compactArg, *sent[0].second));
+  ASSERT_EQ(arg.b.block, compactArg.b.block);
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "cryptonote_core/DecoySampler.h"
+
+using cryptonote::DecoySampler;
+
+TEST(DecoySampler, drawsEveryIndexExactlyOnce) {
+  const size_t populationSize = 1000;
+  DecoySampler sampler(populationSize);
+  std::set<size_t> drawn;
+  while (!sampler.empty()) {
+    size_t index = sampler.next();
+    ASSERT_LT(index, populationSize);
+    ASSERT_TRUE(drawn.insert(index).second);
+  }
+
+  ASSERT_EQ(populationSize, drawn.size());
+  ASSERT_EQ(populationSize, sampler.drawn());
+}
+
+TEST(DecoySampler, emptyPopulation) {
+  DecoySampler sampler(0);
+  ASSERT_TRUE(sampler.empty());
+}
+
+TEST(DecoySampler, firstDrawIsRoughlyUniform) {
+  const size_t populationSize = 10;
+  const size_t rounds = 20000;
+  std::vector<size_t> counts(populationSize);
+  for (size_t i = 0; i < rounds; ++i) {
+    DecoySampler sampler(populationSize);
+    ++counts[sampler.next()];
+  }
+
+  for (size_t count : counts) {
+    ASSERT_GT(count, rounds / populationSize * 8 / 10);
+    ASSERT_LT(count, rounds / populationSize * 12 / 10);
+  }
+}
+
+TEST(DecoySampler, threadsUseOwnGenerators) {
+  DecoySampler::RandomGenerator* otherGenerator = nullptr;
+  std::thread thread([&otherGenerator] { otherGenerator = &DecoySampler::generator(); });
+  thread.join();
+
+  ASSERT_NE(otherGenerator, &DecoySampler::generator());
+  ASSERT_EQ(&DecoySampler::generator(), &DecoySampler::generator());
+}
+
+TEST(DecoySampler, generatorDoesNotRepeatBlocks) {
+  DecoySampler::RandomGenerator& generator = DecoySampler::generator();
+  std::set<uint64_t> values;
+  for (size_t i = 0; i < 1000; ++i) {
+    values.insert(generator());
+  }
+
+  ASSERT_EQ(1000, values.size());
+}
@@ -0,0 +1,148 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include "common/FlatHashTable.h"
+#include "crypto/hash.h"
+
+namespace {
+  crypto::hash randomHash(std::mt19937_64& generator) {
+    crypto::hash hash;
+    for (size_t i = 0; i < sizeof(hash); i += sizeof(uint64_t)) {
+      uint64_t value = generator();
+      memcpy(reinterpret_cast<char*>(&hash) + i, &value, sizeof(value));
+    }
+
+    return hash;
+  }
+
+  // keys which only differ in their last byte, like ground ids sharing a long prefix
+  crypto::hash prefixedHash(uint8_t tail) {
+    crypto::hash hash;
+    memset(&hash, 0, sizeof(hash));
+    reinterpret_cast<uint8_t*>(&hash)[31] = tail;
+    return hash;
+  }
+}
+
+TEST(FlatHashTable, behavesLikeUnorderedMap) {
+  std::mt19937_64 generator(1);
+  tools::FlatHashMap<crypto::hash, uint64_t> table;
+  std::unordered_map<crypto::hash, uint64_t> reference;
+  std::vector<crypto::hash> keys;
+
+  for (uint64_t i = 0; i < 20000; ++i) {
+    if (keys.empty() || generator() % 3 != 0) {
+      crypto::hash key = randomHash(generator);
+      keys.push_back(key);
+      ASSERT_TRUE(table.insert(std::make_pair(key, i)).second);
+      reference.insert(std::make_pair(key, i));
+    } else {
+      size_t index = generator() % keys.size();
+      ASSERT_EQ(reference.erase(keys[index]), table.erase(keys[index]));
+      keys[index] = keys.back();
+      keys.pop_back();
+    }
+  }
+
+  ASSERT_EQ(reference.size(), table.size());
+  for (const auto& item : reference) {
+    auto it = table.find(item.first);
+    ASSERT_TRUE(it != table.end());
+    ASSERT_EQ(item.second, it->second);
+    ASSERT_EQ(item.second, table.at(item.first));
+  }
+
+  size_t iterated = 0;
+  for (const auto& item : table) {
+    ASSERT_EQ(1, reference.count(item.first));
+    ++iterated;
+  }
+
+  ASSERT_EQ(reference.size(), iterated);
+  ASSERT_FALSE(table.insert(std::make_pair(keys.front(), 0)).second);
+  ASSERT_THROW(table.at(randomHash(generator)), std::out_of_range);
+}
+
+TEST(FlatHashTable, eraseKeepsClusteredKeysReachable) {
+  // 14 keys fill the smallest table up to its load limit, so probing and erasing go through long clusters
+  for (uint8_t round = 0; round < 16; ++round) {
+    tools::FlatHashSet<crypto::hash> table;
+    for (uint8_t i = 0; i < 14; ++i) {
+      ASSERT_TRUE(table.insert(prefixedHash(round * 16 + i)).second);
+    }
+
+    ASSERT_EQ(16, table.capacity());
+    ASSERT_EQ(1, table.erase(prefixedHash(round * 16 + 3)));
+    ASSERT_EQ(1, table.erase(prefixedHash(round * 16)));
+    ASSERT_EQ(0, table.erase(prefixedHash(round * 16)));
+    for (uint8_t i = 0; i < 14; ++i) {
+      ASSERT_EQ(i == 0 || i == 3 ? 0 : 1, table.count(prefixedHash(round * 16 + i)));
+    }
+  }
+}
+
+TEST(FlatHashTable, keysSharingPrefixAreSpread) {
+  tools::FlatHashSet<crypto::hash> table;
+  for (unsigned i = 0; i < 256; ++i) {
+    ASSERT_TRUE(table.insert(prefixedHash(static_cast<uint8_t>(i))).second);
+  }
+
+  // a hash of the first bytes only would put all of them into one cluster, in the order they were inserted
+  std::vector<crypto::hash> order(table.begin(), table.end());
+  size_t inPlace = 0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (order[i] == prefixedHash(static_cast<uint8_t>(i))) {
+      ++inPlace;
+    }
+  }
+
+  ASSERT_LT(inPlace, order.size() / 2);
+}
+
+TEST(FlatHashTable, serializationRoundTrip) {
+  std::mt19937_64 generator(2);
+  tools::FlatHashSet<crypto::hash> table;
+  for (size_t i = 0; i < 1000; ++i) {
+    table.insert(randomHash(generator));
+  }
+
+  std::stringstream stream;
+  {
+    boost::archive::binary_oarchive archive(stream);
+    archive << table;
+  }
+
+  tools::FlatHashSet<crypto::hash> loaded;
+  {
+    boost::archive::binary_iarchive archive(stream);
+    archive >> loaded;
+  }
+
+  ASSERT_EQ(table.size(), loaded.size());
+  for (const crypto::hash& key : table) {
+    ASSERT_EQ(1, loaded.count(key));
+  }
+}
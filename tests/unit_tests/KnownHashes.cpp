@@ -0,0 +1,54 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_protocol/KnownHashes.h"
+
+#include "unit_tests_utils.h"
+
+using cryptonote::KnownHashes;
+using unit_test::makeHash;
+
+TEST(KnownHashes, insertReportsNewHashesOnly) {
+  KnownHashes known(10);
+  ASSERT_TRUE(known.insert(makeHash(1)));
+  ASSERT_TRUE(known.insert(makeHash(2)));
+  ASSERT_FALSE(known.insert(makeHash(1)));
+  ASSERT_EQ(2, known.size());
+  ASSERT_TRUE(known.contains(makeHash(2)));
+  ASSERT_FALSE(known.contains(makeHash(3)));
+}
+
+TEST(KnownHashes, forgetsOldestHashesAboveLimit) {
+  KnownHashes known(3);
+  for (uint64_t i = 0; i < 5; ++i) {
+    ASSERT_TRUE(known.insert(makeHash(i)));
+  }
+
+  ASSERT_EQ(3, known.size());
+  ASSERT_FALSE(known.contains(makeHash(0)));
+  ASSERT_FALSE(known.contains(makeHash(1)));
+  ASSERT_TRUE(known.contains(makeHash(2)));
+  ASSERT_TRUE(known.contains(makeHash(4)));
+
+  // a repeated insertion does not refresh the position of a hash
+  ASSERT_FALSE(known.insert(makeHash(2)));
+  ASSERT_TRUE(known.insert(makeHash(5)));
+  ASSERT_FALSE(known.contains(makeHash(2)));
+  ASSERT_TRUE(known.contains(makeHash(3)));
+}
@@ -0,0 +1,180 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_core/MappedVector.h"
+#include "serialization/serialization.h"
+#include "serialization/string.h"
+#include "serialization/vector.h"
+#include "serialization/binary_utils.h"
+
+namespace {
+  struct TestItem {
+    uint64_t id;
+    std::string payload;
+
+    BEGIN_SERIALIZE_OBJECT()
+      VARINT_FIELD(id)
+      FIELD(payload)
+    END_SERIALIZE()
+  };
+
+  TestItem makeItem(uint64_t id) {
+    TestItem item;
+    item.id = id;
+    item.payload = std::string(static_cast<size_t>(id % 97), static_cast<char>('a' + id % 26));
+    return item;
+  }
+
+  size_t blobSize(TestItem item) {
+    std::string blob;
+    serialization::dump_binary(item, blob);
+    return blob.size();
+  }
+
+  class MappedVectorTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() override {
+      m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+      boost::filesystem::create_directories(m_dir);
+      m_itemsFile = (m_dir / "items.dat").string();
+      m_indexesFile = (m_dir / "indexes.dat").string();
+    }
+
+    virtual void TearDown() override {
+      boost::filesystem::remove_all(m_dir);
+    }
+
+    boost::filesystem::path m_dir;
+    std::string m_itemsFile;
+    std::string m_indexesFile;
+  };
+}
+
+TEST_F(MappedVectorTest, pushedItemsAreReadBackAfterEviction) {
+  MappedVector<TestItem> items;
+  ASSERT_TRUE(items.open(m_itemsFile, m_indexesFile, 4, 16));
+  ASSERT_TRUE(items.empty());
+
+  for (uint64_t i = 0; i < 1000; ++i) {
+    items.push_back(makeItem(i));
+  }
+
+  ASSERT_EQ(1000, items.size());
+  for (uint64_t i = 0; i < 1000; i += 7) {
+    ASSERT_EQ(i, items[i].id);
+    ASSERT_EQ(makeItem(i).payload, items[i].payload);
+  }
+
+  ASSERT_EQ(999, items.back().id);
+  ASSERT_EQ(0, items.front().id);
+}
+
+TEST_F(MappedVectorTest, reopenKeepsItemsAndTruncatesFiles) {
+  uint64_t expectedItemsFileSize = 0;
+  {
+    MappedVector<TestItem> items;
+    ASSERT_TRUE(items.open(m_itemsFile, m_indexesFile, 4, 16));
+    for (uint64_t i = 0; i < 100; ++i) {
+      TestItem item = makeItem(i);
+      items.push_back(item);
+      expectedItemsFileSize += blobSize(item);
+    }
+
+    items.pop_back();
+    expectedItemsFileSize -= blobSize(makeItem(99));
+  }
+
+  ASSERT_EQ(expectedItemsFileSize, boost::filesystem::file_size(m_itemsFile));
+  ASSERT_EQ(sizeof(uint64_t) + 99 * sizeof(uint32_t), boost::filesystem::file_size(m_indexesFile));
+
+  MappedVector<TestItem> items;
+  ASSERT_TRUE(items.open(m_itemsFile, m_indexesFile, 4, 16));
+  ASSERT_EQ(99, items.size());
+  for (uint64_t i = 0; i < 99; ++i) {
+    ASSERT_EQ(i, items[i].id);
+    ASSERT_EQ(makeItem(i).payload, items[i].payload);
+  }
+}
+
+TEST_F(MappedVectorTest, popBackInvalidatesCachedItem) {
+  MappedVector<TestItem> items;
+  ASSERT_TRUE(items.open(m_itemsFile, m_indexesFile, 8, 16));
+  items.push_back(makeItem(1));
+  items.push_back(makeItem(2));
+  ASSERT_EQ(2, items.back().id);
+
+  items.pop_back();
+  items.push_back(makeItem(3));
+  ASSERT_EQ(2, items.size());
+  ASSERT_EQ(3, items.back().id);
+  ASSERT_EQ(1, items[0].id);
+}
+
+TEST_F(MappedVectorTest, clearRemovesAllItems) {
+  {
+    MappedVector<TestItem> items;
+    ASSERT_TRUE(items.open(m_itemsFile, m_indexesFile, 8, 16));
+    for (uint64_t i = 0; i < 10; ++i) {
+      items.push_back(makeItem(i));
+    }
+
+    items.clear();
+    ASSERT_TRUE(items.empty());
+    items.push_back(makeItem(42));
+  }
+
+  MappedVector<TestItem> items;
+  ASSERT_TRUE(items.open(m_itemsFile, m_indexesFile, 8, 16));
+  ASSERT_EQ(1, items.size());
+  ASSERT_EQ(42, items[0].id);
+}
+
+TEST_F(MappedVectorTest, concurrentReadersGetSameItems) {
+  MappedVector<TestItem> items;
+  ASSERT_TRUE(items.open(m_itemsFile, m_indexesFile, 8, 16));
+  for (uint64_t i = 0; i < 200; ++i) {
+    items.push_back(makeItem(i));
+  }
+
+  std::atomic<size_t> failures(0);
+  std::vector<std::thread> readers;
+  for (size_t t = 0; t < 4; ++t) {
+    readers.emplace_back([&items, &failures, t] {
+      for (uint64_t i = t; i < 200 * 8; i += 3) {
+        std::shared_ptr<const TestItem> item = items.get(i % 200);
+        if (item->id != i % 200 || item->payload != makeItem(i % 200).payload) {
+          ++failures;
+        }
+      }
+    });
+  }
+
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  ASSERT_EQ(0, failures);
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "common/RecursiveSharedMutex.h"
+
+TEST(RecursiveSharedMutex, ownerCanReenterExclusivelyAndShared) {
+  tools::RecursiveSharedMutex mutex;
+  mutex.lock();
+  mutex.lock();
+  mutex.lock_shared();
+  mutex.unlock_shared();
+  mutex.unlock();
+  mutex.unlock();
+
+  std::atomic<bool> locked(false);
+  std::thread other([&] {
+    mutex.lock();
+    locked = true;
+    mutex.unlock();
+  });
+
+  other.join();
+  ASSERT_TRUE(locked);
+}
+
+TEST(RecursiveSharedMutex, readersShareTheLock) {
+  tools::RecursiveSharedMutex mutex;
+  mutex.lock_shared();
+
+  std::atomic<bool> entered(false);
+  std::thread other([&] {
+    mutex.lock_shared();
+    mutex.lock_shared();
+    entered = true;
+    mutex.unlock_shared();
+    mutex.unlock_shared();
+  });
+
+  other.join();
+  mutex.unlock_shared();
+  ASSERT_TRUE(entered);
+}
+
+TEST(RecursiveSharedMutex, writerWaitsForReaders) {
+  tools::RecursiveSharedMutex mutex;
+  mutex.lock_shared();
+
+  std::atomic<bool> locked(false);
+  std::thread writer([&] {
+    mutex.lock();
+    locked = true;
+    mutex.unlock();
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_FALSE(locked);
+
+  mutex.unlock_shared();
+  writer.join();
+  ASSERT_TRUE(locked);
+}
+
+TEST(RecursiveSharedMutex, upgradeThrows) {
+  tools::RecursiveSharedMutex mutex;
+  mutex.lock_shared();
+  ASSERT_THROW(mutex.lock(), std::logic_error);
+  mutex.unlock_shared();
+
+  mutex.lock();
+  mutex.unlock();
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/TransactionValidationCache.h"
+
+#include "unit_tests_utils.h"
+
+using cryptonote::TransactionValidationCache;
+using unit_test::makeHash;
+
+TEST(TransactionValidationCache, keyIncludesMaxUsedBlock) {
+  TransactionValidationCache cache(10);
+  cache.add(makeHash(1), makeHash(100));
+
+  ASSERT_TRUE(cache.contains(makeHash(1), makeHash(100)));
+  ASSERT_FALSE(cache.contains(makeHash(1), makeHash(101)));
+  ASSERT_FALSE(cache.contains(makeHash(2), makeHash(100)));
+}
+
+TEST(TransactionValidationCache, evictsOldestEntries) {
+  TransactionValidationCache cache(3);
+  for (uint64_t i = 1; i <= 5; ++i) {
+    cache.add(makeHash(i), makeHash(100));
+  }
+
+  ASSERT_EQ(3, cache.size());
+  ASSERT_FALSE(cache.contains(makeHash(1), makeHash(100)));
+  ASSERT_FALSE(cache.contains(makeHash(2), makeHash(100)));
+  for (uint64_t i = 3; i <= 5; ++i) {
+    ASSERT_TRUE(cache.contains(makeHash(i), makeHash(100)));
+  }
+}
+
+TEST(TransactionValidationCache, addingExistingEntryDoesNotEvict) {
+  TransactionValidationCache cache(2);
+  cache.add(makeHash(1), makeHash(100));
+  cache.add(makeHash(2), makeHash(100));
+  cache.add(makeHash(1), makeHash(100));
+
+  ASSERT_EQ(2, cache.size());
+  ASSERT_TRUE(cache.contains(makeHash(1), makeHash(100)));
+  ASSERT_TRUE(cache.contains(makeHash(2), makeHash(100)));
+
+  cache.clear();
+  ASSERT_EQ(0, cache.size());
+  ASSERT_FALSE(cache.contains(makeHash(1), makeHash(100)));
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "common/WorkerPool.h"
+
+using tools::WorkerPool;
+
+TEST(WorkerPool, runCallsTaskOncePerIndex) {
+  WorkerPool pool(4);
+  std::vector<std::atomic<int>> calls(100);
+  for (auto& count : calls) {
+    count = 0;
+  }
+
+  pool.run(calls.size(), [&](size_t index) { ++calls[index]; });
+  for (auto& count : calls) {
+    ASSERT_EQ(1, count);
+  }
+}
+
+TEST(WorkerPool, runUsesWorkersAndCallingThread) {
+  WorkerPool pool(3);
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  std::atomic<size_t> started(0);
+  pool.run(4, [&](size_t index) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      threads.insert(std::this_thread::get_id());
+    }
+
+    // every index waits for the others, so each of them is taken by another thread
+    ++started;
+    while (started != 4) {
+      std::this_thread::yield();
+    }
+  });
+
+  ASSERT_EQ(4, threads.size());
+  ASSERT_EQ(1, threads.count(std::this_thread::get_id()));
+}
+
+TEST(WorkerPool, runCompletesWhenWorkersAreBusy) {
+  WorkerPool pool(2);
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  for (size_t i = 0; i < pool.threadCount(); ++i) {
+    pool.submit([released] { released.wait(); });
+  }
+
+  std::atomic<size_t> sum(0);
+  pool.run(10, [&](size_t index) { sum += index; });
+  ASSERT_EQ(45, sum);
+  release.set_value();
+}
+
+TEST(WorkerPool, nestedRunsComplete) {
+  WorkerPool pool(2);
+  std::atomic<size_t> count(0);
+  pool.run(8, [&](size_t) {
+    pool.run(8, [&](size_t) { ++count; });
+  });
+
+  ASSERT_EQ(64, count);
+}
+
+TEST(WorkerPool, runRethrowsAfterAllIndexesAreDone) {
+  WorkerPool pool(2);
+  std::atomic<size_t> count(0);
+  ASSERT_THROW(pool.run(10, [&](size_t index) {
+    ++count;
+    if (index == 3) {
+      throw std::runtime_error("task failed");
+    }
+  }), std::runtime_error);
+
+  ASSERT_EQ(10, count);
+}
+
+TEST(WorkerPool, destructorRunsQueuedTasks) {
+  std::atomic<size_t> count(0);
+  {
+    WorkerPool pool(1);
+    for (size_t i = 0; i < 10; ++i) {
+      pool.submit([&] { ++count; });
+    }
+  }
+
+  ASSERT_EQ(10, count);
+}
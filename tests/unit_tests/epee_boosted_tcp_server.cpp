@@ -18,7 +18,9 @@
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -68,6 +70,50 @@ namespace
   };
 
   typedef epee::net_utils::boosted_tcp_server<test_protocol_handler> test_tcp_server;
+
+  struct send_protocol_handler_config
+  {
+    std::vector<std::vector<epee::net_utils::shared_buffer>> messages;
+  };
+
+  // sends the messages of the config to every accepted connection
+  struct send_protocol_handler
+  {
+    typedef test_connection_context connection_context;
+    typedef send_protocol_handler_config config_type;
+
+    send_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& /*conn_context*/) :
+      m_psnd_hndlr(psnd_hndlr), m_config(config)
+    {
+    }
+
+    void after_init_connection()
+    {
+      for (const auto& message : m_config.messages)
+      {
+        m_psnd_hndlr->do_send_buffers(message);
+      }
+    }
+
+    void handle_qued_callback()
+    {
+    }
+
+    bool release_protocol()
+    {
+      return true;
+    }
+
+    bool handle_recv(const void* /*data*/, size_t /*size*/)
+    {
+      return true;
+    }
+
+    epee::net_utils::i_service_endpoint* m_psnd_hndlr;
+    config_type& m_config;
+  };
+
+  typedef epee::net_utils::boosted_tcp_server<send_protocol_handler> send_tcp_server;
 }
 
 TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
@@ -120,3 +166,37 @@ TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
   ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
   ASSERT_TRUE(srv.deinit_server());
 }
+
+TEST(boosted_tcp_server, messages_sent_in_split_buffers_arrive_whole_and_in_order)
+{
+  send_tcp_server srv;
+  std::string expected;
+  for (size_t i = 0; i < 3; ++i)
+  {
+    // a header and a body, the body shared by all the messages as a relayed payload is
+    std::vector<epee::net_utils::shared_buffer> message;
+    message.push_back(boost::make_shared<const std::string>("header " + std::to_string(i) + ";"));
+    message.push_back(boost::make_shared<const std::string>(100000, 'b'));
+    srv.get_config_object().messages.push_back(message);
+    expected += *message[0] + *message[1];
+  }
+
+  ASSERT_TRUE(srv.init_server(test_server_port + 1, test_server_host));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  boost::asio::io_service io_service;
+  boost::asio::ip::tcp::socket socket(io_service);
+  boost::system::error_code ec;
+  socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(test_server_host), test_server_port + 1), ec);
+  ASSERT_FALSE(ec);
+
+  std::string received(expected.size(), '\0');
+  boost::asio::read(socket, boost::asio::buffer(&received[0], received.size()), ec);
+  ASSERT_FALSE(ec);
+  ASSERT_EQ(expected, received);
+  socket.close();
+
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
@@ -510,6 +510,27 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_two_re
   ASSERT_EQ(2, m_commands_handler.invoke_counter());
 }
 
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_pipelined_requests_split_at_any_offset)
+{
+  prepare_buf();
+  std::string stream;
+  for (size_t i = 0; i < 10; ++i)
+  {
+    stream.append(m_buf);
+  }
+
+  size_t offset = 0;
+  for (size_t chunk_size = 1; offset < stream.size(); chunk_size = chunk_size * 3 % 301 + 1)
+  {
+    size_t size = std::min(chunk_size, stream.size() - offset);
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(stream.data() + offset, size));
+    offset += size;
+  }
+
+  ASSERT_EQ(10, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpected_response)
 {
   m_req_head.m_flags = LEVIN_PACKET_RESPONSE;
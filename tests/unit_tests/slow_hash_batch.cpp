@@ -0,0 +1,84 @@
+// Copyright (c) 2012-2014, The CryptoNote developers, The Bytecoin developers
+//
+// This file is part of Bytecoin.
+//
+// Bytecoin is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Bytecoin is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "string_tools.h"
+
+namespace {
+  void checkBatchMatchesSingleHashes(size_t count) {
+    std::vector<std::string> blobs;
+    std::vector<const void*> data;
+    std::vector<size_t> lengths;
+    for (size_t i = 0; i < count; ++i) {
+      blobs.push_back(std::string(i * 7 + 1, static_cast<char>('a' + i)));
+    }
+
+    for (const std::string& blob : blobs) {
+      data.push_back(blob.data());
+      lengths.push_back(blob.size());
+    }
+
+    std::unique_ptr<crypto::cn_context[]> contexts(new crypto::cn_context[count]);
+    std::vector<crypto::hash> hashes(count);
+    crypto::cn_slow_hash_batch(contexts.get(), count, data.data(), lengths.data(), hashes.data());
+
+    crypto::cn_context context;
+    for (size_t i = 0; i < count; ++i) {
+      crypto::hash expected;
+      crypto::cn_slow_hash(context, blobs[i].data(), blobs[i].size(), expected);
+      ASSERT_EQ(expected, hashes[i]) << "blob " << i << " of " << count;
+    }
+  }
+}
+
+TEST(cn_slow_hash_batch, matchesSingleHashesForEveryWayCount) {
+  for (size_t count = 1; count <= 7; ++count) {
+    checkBatchMatchesSingleHashes(count);
+  }
+}
+
+TEST(cn_slow_hash_batch, matchesKnownHashes) {
+  const std::string blobs[] = {"de omnibus dubitandum", "abundans cautela non nocet", "caveat emptor", "ex nihilo nihil fit"};
+  const char* expectedHashes[] = {
+    "2f8e3df40bd11f9ac90c743ca8e32bb391da4fb98612aa3b6cdc639ee00b31f5",
+    "722fa8ccd594d40e4a41f3822734304c8d5eff7e1b528408e2229da38ba553c4",
+    "bbec2cacf69866a8e740380fe7b818fc78f8571221742d729d9d02d7f8989b87",
+    "b1257de4efc5ce28c6b40ceb1c6c8f812a64634eb3e81c5220bee9b2b76a6f05"
+  };
+
+  const void* data[4];
+  size_t lengths[4];
+  for (size_t i = 0; i < 4; ++i) {
+    data[i] = blobs[i].data();
+    lengths[i] = blobs[i].size();
+  }
+
+  crypto::cn_context contexts[4];
+  crypto::hash hashes[4];
+  crypto::cn_slow_hash_batch(contexts, 4, data, lengths, hashes);
+  for (size_t i = 0; i < 4; ++i) {
+    crypto::hash expected;
+    ASSERT_TRUE(epee::string_tools::hex_to_pod(expectedHashes[i], expected));
+    ASSERT_EQ(expected, hashes[i]) << blobs[i];
+  }
+}
@@ -194,3 +194,114 @@ TEST(validate_parse_amount_case, validate_parse_amount)
   r = currency.parseAmount("1 00.00 00", res);
   ASSERT_FALSE(r);
 }
+
+namespace
+{
+  void check_longhash_blob_nonce_patching(cryptonote::Block& b)
+  {
+    cryptonote::blobdata blob;
+    size_t nonce_offset;
+    ASSERT_TRUE(cryptonote::get_block_longhash_blob(b, blob, nonce_offset));
+
+    for (uint32_t nonce : {0u, 1u, 0x12345678u, 0xffffffffu})
+    {
+      cryptonote::set_longhash_blob_nonce(blob, nonce_offset, nonce);
+
+      b.nonce = nonce;
+      cryptonote::blobdata expected_blob;
+      size_t expected_nonce_offset;
+      ASSERT_TRUE(cryptonote::get_block_longhash_blob(b, expected_blob, expected_nonce_offset));
+      ASSERT_EQ(nonce_offset, expected_nonce_offset);
+      ASSERT_EQ(expected_blob, blob);
+    }
+  }
+}
+
+TEST(get_block_longhash_blob, patched_nonce_matches_serialized_v1_block)
+{
+  cryptonote::Block b = AUTO_VAL_INIT(b);
+  b.majorVersion = cryptonote::BLOCK_MAJOR_VERSION_1;
+  b.timestamp = 1400000000;
+  b.prevId = crypto::cn_fast_hash("prev", 4);
+  check_longhash_blob_nonce_patching(b);
+}
+
+TEST(get_block_longhash_blob, patched_nonce_matches_serialized_v2_block)
+{
+  cryptonote::Block b = AUTO_VAL_INIT(b);
+  b.majorVersion = cryptonote::BLOCK_MAJOR_VERSION_2;
+  b.timestamp = 1400000000;
+  b.prevId = crypto::cn_fast_hash("prev", 4);
+  b.parentBlock.majorVersion = cryptonote::BLOCK_MAJOR_VERSION_1;
+  b.parentBlock.prevId = crypto::cn_fast_hash("parent", 6);
+  b.parentBlock.numberOfTransactions = 1;
+  check_longhash_blob_nonce_patching(b);
+}
+
+TEST(get_longhash_blob_nonce_offset, fails_on_truncated_blob)
+{
+  size_t nonce_offset;
+  ASSERT_FALSE(cryptonote::get_longhash_blob_nonce_offset(cryptonote::blobdata(), nonce_offset));
+  ASSERT_FALSE(cryptonote::get_longhash_blob_nonce_offset(cryptonote::blobdata(10, '\x01'), nonce_offset));
+}
+
+namespace
+{
+  void check_block_short_header(const cryptonote::Block& b)
+  {
+    cryptonote::BlockShortHeader header;
+    ASSERT_TRUE(cryptonote::parse_and_validate_block_short_header_from_blob(
+      cryptonote::t_serializable_object_to_blob(cryptonote::get_block_short_header(b)), header));
+
+    crypto::hash block_hash;
+    crypto::hash header_hash;
+    ASSERT_TRUE(cryptonote::get_block_hash(b, block_hash));
+    ASSERT_TRUE(cryptonote::get_block_hash(header, header_hash));
+    ASSERT_EQ(block_hash, header_hash);
+
+    ASSERT_TRUE(cryptonote::get_aux_block_header_hash(b, block_hash));
+    ASSERT_TRUE(cryptonote::get_aux_block_header_hash(header, header_hash));
+    ASSERT_EQ(block_hash, header_hash);
+
+    cryptonote::blobdata block_blob;
+    cryptonote::blobdata header_blob;
+    size_t block_nonce_offset;
+    size_t header_nonce_offset;
+    ASSERT_TRUE(cryptonote::get_block_longhash_blob(b, block_blob, block_nonce_offset));
+    ASSERT_TRUE(cryptonote::get_block_longhash_blob(header, header_blob, header_nonce_offset));
+    ASSERT_EQ(block_blob, header_blob);
+    ASSERT_EQ(block_nonce_offset, header_nonce_offset);
+  }
+}
+
+TEST(get_block_short_header, hashes_as_v1_block)
+{
+  cryptonote::Block b = AUTO_VAL_INIT(b);
+  b.majorVersion = cryptonote::BLOCK_MAJOR_VERSION_1;
+  b.timestamp = 1400000000;
+  b.nonce = 0x12345678;
+  b.prevId = crypto::cn_fast_hash("prev", 4);
+  b.txHashes.push_back(crypto::cn_fast_hash("tx1", 3));
+  b.txHashes.push_back(crypto::cn_fast_hash("tx2", 3));
+  check_block_short_header(b);
+}
+
+TEST(get_block_short_header, hashes_as_v2_block)
+{
+  cryptonote::Block b = AUTO_VAL_INIT(b);
+  b.majorVersion = cryptonote::BLOCK_MAJOR_VERSION_2;
+  b.timestamp = 1400000000;
+  b.nonce = 0x12345678;
+  b.prevId = crypto::cn_fast_hash("prev", 4);
+  b.txHashes.push_back(crypto::cn_fast_hash("tx1", 3));
+  b.parentBlock.majorVersion = cryptonote::BLOCK_MAJOR_VERSION_1;
+  b.parentBlock.prevId = crypto::cn_fast_hash("parent", 6);
+  b.parentBlock.numberOfTransactions = 2;
+  b.parentBlock.minerTxBranch.push_back(crypto::cn_fast_hash("branch", 6));
+  b.parentBlock.blockchainBranch.push_back(crypto::cn_fast_hash("aux", 3));
+  cryptonote::tx_extra_merge_mining_tag mm_tag;
+  mm_tag.depth = 1;
+  mm_tag.merkle_root = crypto::cn_fast_hash("root", 4);
+  ASSERT_TRUE(cryptonote::append_mm_tag_to_extra(b.parentBlock.minerTx.extra, mm_tag));
+  check_block_short_header(b);
+}
@@ -18,6 +18,10 @@
 #include "gtest/gtest.h"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <boost/filesystem.hpp>
 
 #include "cryptonote_core/account.h"
 #include "cryptonote_core/cryptonote_format_utils.h"
@@ -41,6 +45,35 @@ class TransactionValidator : public CryptoNote::ITransactionValidator {
   }
 };
 
+class CountingTransactionValidator : public TransactionValidator {
+public:
+  CountingTransactionValidator() : checkCount(0) {}
+
+  virtual bool checkTransactionInputs(const cryptonote::Transaction& tx, BlockInfo& maxUsedBlock, BlockInfo& lastFailed) {
+    ++checkCount;
+    return true;
+  }
+
+  size_t checkCount;
+};
+
+// a block spending the key images of the checked transaction is added right after its inputs were checked
+class RacingBlockTransactionValidator : public TransactionValidator {
+public:
+  RacingBlockTransactionValidator() : spentInBlockchain(false) {}
+
+  virtual bool checkTransactionInputs(const cryptonote::Transaction& tx, BlockInfo& maxUsedBlock) {
+    spentInBlockchain = true;
+    return true;
+  }
+
+  virtual bool haveSpentKeyImages(const cryptonote::Transaction& tx) {
+    return spentInBlockchain;
+  }
+
+  bool spentInBlockchain;
+};
+
 class FakeTimeProvider : public ITimeProvider {
 public:
   FakeTimeProvider(time_t currentTime = time(nullptr))
@@ -237,6 +270,54 @@ TEST(tx_pool, double_spend_tx)
 }
 
 
+TEST(tx_pool, concurrent_double_spend_tx)
+{
+  TxTestBase test(1);
+  const size_t threadCount = 8;
+
+  std::vector<Transaction> txs(threadCount);
+  for (auto& tx : txs) {
+    test.txGenerator.rv_acc.generate(); // spend the same sources to another receiver
+    test.construct(test.m_currency.minimumFee(), 1, tx);
+  }
+
+  std::atomic<size_t> addedCount(0);
+  std::vector<std::thread> threads;
+  for (const auto& tx : txs) {
+    threads.emplace_back([&test, &tx, &addedCount] {
+      tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+      if (test.pool.add_tx(tx, tvc, false)) {
+        ASSERT_TRUE(tvc.m_added_to_pool);
+        ++addedCount;
+      } else {
+        ASSERT_TRUE(tvc.m_verifivation_failed);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(1, addedCount);
+  ASSERT_EQ(1, test.pool.get_transactions_count());
+}
+
+TEST(tx_pool, double_spend_of_block_added_during_check)
+{
+  cryptonote::Currency currency = cryptonote::CurrencyBuilder().currency();
+  TestPool<RacingBlockTransactionValidator, RealTimeProvider> pool(currency);
+  Transaction tx;
+  GenerateTransaction(currency, tx, currency.minimumFee(), 1);
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_FALSE(pool.add_tx(tx, tvc, false));
+  ASSERT_TRUE(tvc.m_verifivation_failed);
+  ASSERT_FALSE(tvc.m_added_to_pool);
+  ASSERT_FALSE(tvc.m_should_be_relayed);
+  ASSERT_EQ(0, pool.get_transactions_count());
+}
+
 TEST(tx_pool, fillblock_same_fee)
 {
   cryptonote::Currency currency = cryptonote::CurrencyBuilder().currency();
@@ -395,3 +476,145 @@ TEST(tx_pool, cleanup_stale_tx)
 
   ASSERT_EQ(3, pool.get_transactions_count());
 }
+
+TEST(tx_pool, fillblock_reuses_template)
+{
+  cryptonote::Currency currency = cryptonote::CurrencyBuilder().currency();
+  TestPool<CountingTransactionValidator, RealTimeProvider> pool(currency);
+  const uint64_t fee = currency.minimumFee();
+  const size_t median = 100000;
+
+  std::vector<crypto::hash> ids;
+  for (int i = 0; i < 10; ++i) {
+    Transaction tx;
+    GenerateTransaction(currency, tx, fee * (20 - i), 1);
+
+    tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+    ASSERT_TRUE(pool.add_tx(tx, tvc, false));
+    ids.push_back(get_transaction_hash(tx));
+  }
+
+  Block bl;
+  InitBlock(bl);
+  size_t totalSize = 0;
+  uint64_t txFee = 0;
+
+  ASSERT_TRUE(pool.fill_block_template(bl, median, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(ids, bl.txHashes);
+  ASSERT_EQ(10, pool.validator.checkCount);
+
+  // nothing changed, the same template is returned without checking transactions again
+  Block sameBl;
+  InitBlock(sameBl);
+  size_t sameTotalSize = 0;
+  uint64_t sameTxFee = 0;
+  ASSERT_TRUE(pool.fill_block_template(sameBl, median, textMaxCumulativeSize, 0, sameTotalSize, sameTxFee));
+  ASSERT_EQ(bl.txHashes, sameBl.txHashes);
+  ASSERT_EQ(totalSize, sameTotalSize);
+  ASSERT_EQ(txFee, sameTxFee);
+  ASSERT_EQ(10, pool.validator.checkCount);
+
+  // a cheaper transaction is appended, a more profitable one makes the template to be rebuilt from cached checks
+  Transaction cheapTx;
+  GenerateTransaction(currency, cheapTx, fee, 1);
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(cheapTx, tvc, false));
+  ids.push_back(get_transaction_hash(cheapTx));
+
+  Transaction expensiveTx;
+  GenerateTransaction(currency, expensiveTx, fee * 100, 1);
+  tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(expensiveTx, tvc, false));
+  ids.insert(ids.begin(), get_transaction_hash(expensiveTx));
+
+  ASSERT_TRUE(pool.fill_block_template(bl, median, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(ids, bl.txHashes);
+  ASSERT_EQ(12, pool.validator.checkCount);
+
+  Transaction takenTx;
+  size_t blobSize;
+  uint64_t takenFee;
+  ASSERT_TRUE(pool.take_tx(ids[3], takenTx, blobSize, takenFee));
+  ids.erase(ids.begin() + 3);
+
+  // transactions ready at the old chain tail stay ready on a longer chain
+  ASSERT_TRUE(pool.on_blockchain_inc(1, null_hash));
+  ASSERT_TRUE(pool.fill_block_template(bl, median, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(ids, bl.txHashes);
+  ASSERT_EQ(12, pool.validator.checkCount);
+
+  // all of them used the genesis block, so popping it requires to check them again
+  ASSERT_TRUE(pool.on_blockchain_dec(0, null_hash));
+  ASSERT_TRUE(pool.fill_block_template(bl, median, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_EQ(ids, bl.txHashes);
+  ASSERT_EQ(23, pool.validator.checkCount);
+}
+
+TEST(tx_pool, evict_lowest_fee_tx_when_full)
+{
+  std::vector<Transaction> txs(5);
+  std::vector<TestTransactionGenerator> generators;
+  generators.reserve(txs.size());
+  cryptonote::Currency defaultCurrency = cryptonote::CurrencyBuilder().currency();
+  for (size_t i = 0; i < txs.size(); ++i) {
+    generators.emplace_back(defaultCurrency, 1);
+    generators.back().createSources();
+    generators.back().construct(generators.back().m_source_amount, defaultCurrency.minimumFee() * (i + 1), 1, txs[i]);
+  }
+
+  // room for the three most profitable transactions
+  size_t maxSize = 0;
+  for (size_t i = 2; i < txs.size(); ++i) {
+    maxSize += get_object_blobsize(txs[i]);
+  }
+
+  cryptonote::Currency currency = cryptonote::CurrencyBuilder().currency();
+  TestPool<TransactionValidator, RealTimeProvider> pool(currency);
+  // there is no saved pool in a new directory
+  ASSERT_TRUE(pool.init((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string(), maxSize));
+
+  for (const auto& tx : txs) {
+    tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+    ASSERT_TRUE(pool.add_tx(tx, tvc, false));
+    ASSERT_TRUE(tvc.m_added_to_pool);
+  }
+
+  ASSERT_EQ(3, pool.get_transactions_count());
+  ASSERT_EQ(maxSize, pool.get_transactions_size());
+  for (size_t i = 0; i < txs.size(); ++i) {
+    ASSERT_EQ(i >= 2, pool.have_tx(get_transaction_hash(txs[i])));
+  }
+
+  tx_memory_pool::EvictionStatistics statistics = pool.get_eviction_statistics();
+  ASSERT_EQ(2, statistics.evictedCount);
+  ASSERT_EQ(get_object_blobsize(txs[0]) + get_object_blobsize(txs[1]), statistics.evictedSize);
+  ASSERT_EQ(0, statistics.rejectedCount);
+
+  // the key images of evicted transactions are released, but a cheap transaction can't get to the full pool
+  Transaction cheapTx;
+  generators[0].rv_acc.generate();
+  generators[0].construct(generators[0].m_source_amount, currency.minimumFee(), 1, cheapTx);
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_FALSE(pool.add_tx(cheapTx, tvc, false));
+  ASSERT_FALSE(tvc.m_verifivation_failed);
+  ASSERT_FALSE(tvc.m_added_to_pool);
+  ASSERT_EQ(1, pool.get_eviction_statistics().rejectedCount);
+
+  // transactions kept by blocks are neither rejected nor evicted
+  tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(cheapTx, tvc, true));
+  ASSERT_TRUE(tvc.m_added_to_pool);
+
+  Transaction expensiveTx;
+  generators[1].rv_acc.generate();
+  generators[1].construct(generators[1].m_source_amount, currency.minimumFee() * 10, 1, expensiveTx);
+  tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(expensiveTx, tvc, false));
+  ASSERT_TRUE(tvc.m_added_to_pool);
+
+  ASSERT_TRUE(pool.have_tx(get_transaction_hash(cheapTx)));
+  ASSERT_TRUE(pool.have_tx(get_transaction_hash(expensiveTx)));
+  ASSERT_FALSE(pool.have_tx(get_transaction_hash(txs[2])));
+  ASSERT_FALSE(pool.have_tx(get_transaction_hash(txs[3])));
+  ASSERT_TRUE(pool.have_tx(get_transaction_hash(txs[4])));
+}
@@ -18,6 +18,9 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+
+#include "crypto/hash.h"
 
 namespace unit_test
 {
@@ -48,4 +51,10 @@ namespace unit_test
   private:
     std::atomic<size_t> m_counter;
   };
+
+  // distinct, well spread hashes for tests which only need some ids
+  inline crypto::hash makeHash(uint64_t value)
+  {
+    return crypto::cn_fast_hash(&value, sizeof(value));
+  }
 }